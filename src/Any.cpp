@@ -230,6 +230,13 @@ bool Any::isString() const
     return (type == Dynamic) && vtable->getType() == typeid(std::u16string);
 }
 
+const std::u16string* Any::getString() const
+{
+    if (isString())
+        return reinterpret_cast<const std::u16string*>(&heap);
+    return 0;
+}
+
 std::u16string Any::toString() const
 {
     switch (type) {
@@ -301,6 +301,9 @@ public:
 
     bool isString() const;
     std::u16string toString() const;
+    // Returns the string held by this Any without copying it, or 0 if this
+    // Any does not hold a string. The pointer is valid while this Any holds it.
+    const std::u16string* getString() const;
 
     bool isUndefined() const {
         return type == Undefined;
@@ -18,6 +18,8 @@
 
 #include <Object.h>
 
+#include "ElementImp.h"
+
 #include <new>
 
 namespace org { namespace w3c { namespace dom { namespace bootstrap {
@@ -47,15 +49,21 @@ std::u16string AttrImp::getName()
 
 std::u16string AttrImp::getValue()
 {
+    if (ownerElement)
+        return ownerElement->getAttrValue(this);
     return value;
 }
 
 void AttrImp::setValue(const std::u16string& value)
 {
-    this->value = value;
+    if (ownerElement)
+        ownerElement->setAttrValue(this, value);
+    else
+        this->value = value;
 }
 
 AttrImp::AttrImp(Nullable<std::u16string> namespaceURI, Nullable<std::u16string> prefix, const std::u16string& localName, const std::u16string& value) :
+    ownerElement(0),
     namespaceURI(namespaceURI),
     prefix(prefix),
     localName(localName),
@@ -63,4 +71,12 @@ AttrImp::AttrImp(Nullable<std::u16string> namespaceURI, Nullable<std::u16string>
 {
 }
 
+AttrImp::AttrImp(ElementImp* ownerElement, Nullable<std::u16string> namespaceURI, Nullable<std::u16string> prefix, const std::u16string& localName) :
+    ownerElement(ownerElement),
+    namespaceURI(namespaceURI),
+    prefix(prefix),
+    localName(localName)
+{
+}
+
 }}}}  // org::w3c::dom::bootstrap
@@ -22,9 +22,12 @@
 
 namespace org { namespace w3c { namespace dom { namespace bootstrap {
 
+class ElementImp;
+
 class AttrImp : public ObjectMixin<AttrImp>
 {
 private:
+    ElementImp* ownerElement;   // the element that keeps the value of this attribute, or 0
     Nullable<std::u16string> namespaceURI;
     Nullable<std::u16string> prefix;
     std::u16string localName;
@@ -32,6 +35,16 @@ private:
 
 public:
     AttrImp(Nullable<std::u16string> namespaceURI, Nullable<std::u16string> prefix, const std::u16string& localName, const std::u16string& value);
+    AttrImp(ElementImp* ownerElement, Nullable<std::u16string> namespaceURI, Nullable<std::u16string> prefix, const std::u16string& localName);
+
+    ElementImp* getOwnerElementImp() const {
+        return ownerElement;
+    }
+    // Called when the attribute is removed from the owner element.
+    void detach(const std::u16string& value) {
+        ownerElement = 0;
+        this->value = value;
+    }
 
     // Attr
     virtual Nullable<std::u16string> getNamespaceURI();
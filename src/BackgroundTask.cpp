@@ -16,6 +16,7 @@
 
 #include "WindowImp.h"
 
+#include <functional>
 #include <new>
 #include <iostream>
 #include <boost/version.hpp>
@@ -25,10 +26,12 @@
 
 #include "DOMImplementationImp.h"
 #include "DocumentImp.h"
+#include "WorkerPool.h"
 #include "css/ViewCSSImp.h"
 #include "html/HTMLParser.h"
 
 #include "Test.util.h"
+#include "Trace.h"
 
 namespace org { namespace w3c { namespace dom { namespace bootstrap {
 
@@ -37,7 +40,12 @@ WindowImp::BackgroundTask::BackgroundTask(WindowImp* window) :
     state(Init),
     flags(0),
     view(0),
-    xfered(false)
+    xfered(false),
+    scheduled(false),
+    jobId(0),
+    cancelRequest(false),
+    cancelCount(0),
+    wastedTicks(0)
 {
 }
 
@@ -56,106 +64,190 @@ void WindowImp::BackgroundTask::deleteView()
 
 void WindowImp::BackgroundTask::operator()()
 {
-    if (!window)
+    unsigned command;
+    while ((command = takeCommand()))
+        run(command);
+}
+
+void WindowImp::BackgroundTask::run(unsigned command)
+{
+    if (!window->getDocumentWindow()) {
+        state = Init;
         return;
+    }
 
-    unsigned command;
-    while (!((command = sleep()) & Abort)) {
-        if (!window->getDocumentWindow()) {
-            state = Init;
-            continue;
-        }
+    //
+    // Restart
+    //
+    if (command & Restart) {
+        deleteView();
+        state = Init;
+    }
 
-        //
-        // Restart
-        //
-        if (command & Restart) {
-            deleteView();
+    // A binding document does not need a view.
+    if (window->isBindingDocumentWindow()) {
+        state = Done;
+        return;
+    }
+
+    //
+    // Cascade
+    //
+    if (!view || (command & Cascade)) {
+        state = Cascading;
+        TraceScope scope("selector matching");
+        recordTime("%*sselector matching begin", window->windowDepth * 2, "");
+        if (!view)
+            view = new(std::nothrow) ViewCSSImp(window->getDocumentWindow());
+        if (view)
+            view->setCancelRequest(&cancelRequest);
+        SlabAllocator::Statistics ruleStatistics = SlabAllocator::getRuleAllocator().getStatistics();
+        unsigned begin = getTick();
+        if (view) {
+            view->constructComputedStyles();
+            if (view->isCancelled()) {
+                recordCancel("selector matching", begin, Init, Cascade);
+                return;
+            }
+            state = Cascaded;
+        } else
             state = Init;
-        }
+        SlabAllocator::Statistics matched = SlabAllocator::getRuleAllocator().getStatistics() - ruleStatistics;
+        recordTime("%*sselector matching end: %lu rule lists allocated (%lu bytes)", window->windowDepth * 2, "", matched.count, matched.bytes);
+        return;
+    }
 
-        // A binding document does not need a view.
-        if (window->isBindingDocumentWindow()) {
+    //
+    // Layout
+    //
+    if (command & (Layout | Restyle)) {
+        state = Layouting;
+        // Note the statistics are kept per thread, and the jobs of this task
+        // can run on any thread of the worker pool.
+        SlabAllocator::Statistics boxStatistics = SlabAllocator::getBoxAllocator().getStatistics();
+        unsigned begin = getTick();
+        view->setCancelRequest(&cancelRequest);
+        view->setSize(window->width, window->height);   // TODO: sync with mainloop
+        recordTime("%*sstyle recalculation begin", window->windowDepth * 2, "");
+        Trace::begin("style recalculation");
+        view->calculateComputedStyles();
+        Trace::end("style recalculation");
+        recordTime("%*sstyle recalculation end", window->windowDepth * 2, "");
+        // A paint-only change can still revert or reflow the boxes, e.g., by
+        // changing 'visibility' from or to 'collapse'.
+        if (!(command & Layout) && !(view->gatherFlags() & ~Box::NEED_REPAINT)) {
+            if (view->isCancelled()) {
+                recordCancel("style recalculation", begin, Cascaded, command & (Layout | Restyle));
+                return;
+            }
+            view->setFlags(Box::NEED_REPAINT);
             state = Done;
-            continue;
-        }
-
-        //
-        // Cascade
-        //
-        if (!view || (command & Cascade)) {
-            state = Cascading;
-            recordTime("%*sselector matching begin", window->windowDepth * 2, "");
-            if (!view)
-                view = new(std::nothrow) ViewCSSImp(window->getDocumentWindow());
-            if (view) {
-                view->constructComputedStyles();
-                state = Cascaded;
-            } else
-                state = Init;
-            recordTime("%*sselector matching end", window->windowDepth * 2, "");
-            continue;
+            return;
         }
-
-        //
-        // Layout
-        //
-        if (command & Layout) {
-            state = Layouting;
-            view->setSize(window->width, window->height);   // TODO: sync with mainloop
-            recordTime("%*sstyle recalculation begin", window->windowDepth * 2, "");
-            view->calculateComputedStyles();
-            recordTime("%*sstyle recalculation end", window->windowDepth * 2, "");
-            recordTime("%*sreflow begin", window->windowDepth * 2, "");
-            view->layOut();
-            recordTime("%*sreflow end", window->windowDepth * 2, "");
-            view->setFlags(Box::NEED_REPAINT);
+        TraceScope scope("reflow");
+        recordTime("%*sreflow begin", window->windowDepth * 2, "");
+        view->layOut();
+        if (view->isCancelled()) {
+            recordCancel("layout", begin, Cascaded, command & (Layout | Restyle));
+            return;
         }
-
-        state = Done;
+        SlabAllocator::Statistics allocated = SlabAllocator::getBoxAllocator().getStatistics() - boxStatistics;
+        recordTime("%*sreflow end: %lu boxes allocated (%lu bytes)", window->windowDepth * 2, "", allocated.count, allocated.bytes);
+        view->setFlags(Box::NEED_REPAINT);
     }
-}
 
+    state = Done;
+}
 
-unsigned WindowImp::BackgroundTask::sleep()
+// Resets the state after a cancelled cascade or layout, and requests the
+// cancelled command again so that the next run redoes it unless the task is
+// aborted or restarted. The view has been flagged to be redone from scratch;
+// cf. ViewCSSImp::setCancelRequest().
+void WindowImp::BackgroundTask::recordCancel(const char* what, unsigned begin, int resetState, unsigned command)
 {
-    std::unique_lock<std::mutex> lock(mutex);
+    ++cancelCount;
+    wastedTicks += getTick() - begin;
+    recordTime("%*s%s cancelled: %u cancelled so far, %u.%02u sec wasted", window->windowDepth * 2, "",
+               what, cancelCount, wastedTicks / 100, wastedTicks % 100);
+    std::lock_guard<std::mutex> lock(mutex);
+    state = resetState;
+    flags |= command;
     cond.notify_all();
-    while (!flags)
-        cond.wait(lock);
+}
+
+// Returns the pending command, or 0 if there is nothing to do or the task has
+// been aborted, in which case the job is over and the task is unscheduled.
+unsigned WindowImp::BackgroundTask::takeCommand()
+{
+    std::lock_guard<std::mutex> lock(mutex);
     unsigned result = flags;
-    flags = 0;
+    if (!result || (result & Abort)) {
+        scheduled = false;
+        result = 0;
+    } else {
+        flags = 0;
+        cancelRequest = false;
+    }
+    cond.notify_all();
     return result;
 }
 
+// Posts a job for this task to the worker pool unless one is already queued
+// or running; the job keeps taking commands until none is left, so the
+// commands that arrive meanwhile are merged into the pending flags. Called
+// with mutex locked.
+void WindowImp::BackgroundTask::schedule()
+{
+    if (scheduled || (flags & Abort))
+        return;
+    scheduled = true;
+    WorkerPool::Priority priority = WorkerPool::Normal;
+    if (window->windowDepth || window->isBindingDocumentWindow())
+        priority = WorkerPool::Low;
+    jobId = WorkerPool::getInstance().post(std::bind(&BackgroundTask::operator(), this), priority);
+}
+
 void WindowImp::BackgroundTask::wakeUp(unsigned flags)
 {
     std::lock_guard<std::mutex> lock(mutex);
     xfered = false;
     this->flags |= flags;
-    cond.notify_one();
+    schedule();
 }
 
+// Removes the job of this task from the worker pool if it has not been
+// started yet. Otherwise waits for the running job, which stops at the next
+// check of the cancel request.
 void WindowImp::BackgroundTask::abort()
 {
-    // TODO: Cancel ongoing tasks.
-    wakeUp(Abort);
+    std::unique_lock<std::mutex> lock(mutex);
+    flags |= Abort;
+    cancelRequest = true;
+    if (scheduled && WorkerPool::getInstance().cancel(jobId))
+        scheduled = false;
+    cond.notify_all();
+    while (scheduled)
+        cond.wait(lock);
 }
 
+// Cancels the ongoing cascade or layout, if any, as its view is going to be
+// deleted by the restart anyway.
 void WindowImp::BackgroundTask::restart(unsigned flags)
 {
-    // TODO: Cancel ongoing tasks.
     std::lock_guard<std::mutex> lock(mutex);
     this->flags &= ~Abort;
     this->flags |= Restart | flags;
-    cond.notify_one();
+    cancelRequest = true;
+    schedule();
 }
 
 ViewCSSImp* WindowImp::BackgroundTask::getView()
 {
-    if (state == Done || state == Init) {
+    // Keep the view while a command is pending, e.g., after a cancel.
+    if ((state == Done || state == Init) && !flags) {
         if (!xfered && view) {
             xfered = true;
+            view->setCancelRequest(0);  // the main thread owns the view from now on
             return view;
         }
     }
@@ -0,0 +1,80 @@
+/*
+ * Copyright 2013 Esrille Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Box.bench lays out a page having 10k boxes and measures Box::boxFromPoint()
+// against the hit test without the hit bounds.
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <org/w3c/dom/Document.h>
+#include <org/w3c/dom/Element.h>
+
+#include "DOMImplementationImp.h"
+#include "css/Box.h"
+#include "css/ViewCSSImp.h"
+
+#include "Test.util.h"
+
+using namespace org::w3c::dom::bootstrap;
+using namespace org::w3c::dom;
+
+int main(int argc, char** argv)
+{
+    // Load the default CSS file
+    if (1 < argc) {
+        std::ifstream stream(argv[1]);
+        if (!stream) {
+            std::cerr << "error: cannot open " << argv[1] << ".\n";
+            return EXIT_FAILURE;
+        }
+        getDOMImplementation()->setDefaultStyleSheet(loadStyleSheet(stream));
+    }
+
+    Document document = loadDocument(createHitTestPage().c_str());
+    DocumentWindowPtr window = new(std::nothrow) DocumentWindow;
+    window->setDocument(document);
+    ViewCSSImp* view = new ViewCSSImp(window);
+    view->setSize(1000, 1000);
+    view->constructComputedStyles();
+    view->calculateComputedStyles();
+    Box* boxTree = view->layOut();
+    if (!boxTree)
+        return EXIT_FAILURE;
+
+    const int count = 100000;
+    std::srand(1);
+    std::vector<std::pair<int, int>> points;
+    for (int i = 0; i < count; ++i)
+        points.push_back(std::make_pair(std::rand() % 1000, std::rand() % 800));
+
+    auto start = std::chrono::steady_clock::now();
+    for (auto i = points.begin(); i != points.end(); ++i)
+        boxTree->boxFromPoint(i->first, i->second);
+    std::chrono::duration<double, std::micro> indexed = std::chrono::steady_clock::now() - start;
+    start = std::chrono::steady_clock::now();
+    for (auto i = points.begin(); i != points.end(); ++i)
+        linearBoxFromPoint(boxTree, i->first, i->second);
+    std::chrono::duration<double, std::micro> linear = std::chrono::steady_clock::now() - start;
+    std::cout << "hit test: " << indexed.count() / count << " us/point (linear: " << linear.count() / count << " us/point)\n";
+
+    delete view;
+    return EXIT_SUCCESS;
+}
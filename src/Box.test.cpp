@@ -19,6 +19,7 @@
 
 #include <assert.h>
 
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
 #include <set>
@@ -74,6 +75,35 @@ const char* htmlDocument =
     "</body>"
     "</html>";
 
+// Lays out a page having 10k boxes and verifies boxFromPoint(); cf. Box.bench
+int testHitTest()
+{
+    Document document = loadDocument(createHitTestPage().c_str());
+    DocumentWindowPtr window = new(std::nothrow) DocumentWindow;
+    window->setDocument(document);
+    ViewCSSImp* view = new ViewCSSImp(window);
+    view->setSize(1000, 1000);
+    view->constructComputedStyles();
+    view->calculateComputedStyles();
+    Box* boxTree = view->layOut();
+    if (!boxTree)
+        return EXIT_FAILURE;
+
+    int rc = EXIT_SUCCESS;
+    std::srand(1);
+    for (int i = 0; i < 1000; ++i) {
+        int x = std::rand() % 1000;
+        int y = std::rand() % 800;
+        if (boxTree->boxFromPoint(x, y) != linearBoxFromPoint(boxTree, x, y)) {
+            std::cout << "FAIL: boxFromPoint(" << x << ", " << y << ")\n";
+            rc = EXIT_FAILURE;
+        }
+    }
+
+    delete view;
+    return rc;
+}
+
 int main(int argc, char** argv)
 {
     css::CSSStyleSheet defaultStyleSheet(0);
@@ -109,6 +139,9 @@ int main(int argc, char** argv)
 
     boxTree->dump();
 
+    if (testHitTest() != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+
     std::cout << "done.\n";
     return 0;
 }
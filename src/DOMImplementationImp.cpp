@@ -14,19 +14,24 @@
  * limitations under the License.
  */
 
+#include <exception>
 #include <new>
 
 #include "DOMImplementationImp.h"
 #include "DocumentTypeImp.h"
 #include "XMLDocumentImp.h"
+#include "css/CSSRuleIndex.h"
 #include "css/CSSStyleSheetImp.h"
 
+#include "Test.util.h"
+
 namespace org { namespace w3c { namespace dom { namespace bootstrap {
 
 DOMImplementationImp::DOMImplementationImp() :
     defaultStyleSheet(0),
     presHintsStyleSheet(0),
-    userStyleSheet(0)
+    userStyleSheet(0),
+    pendingStartupTasks(0)
 {
 }
 
@@ -60,6 +65,69 @@ void DOMImplementationImp::setUserStyleSheet(css::CSSStyleSheet sheet)
     userStyleSheet = sheet;
 }
 
+std::shared_ptr<const CSSRuleIndex> DOMImplementationImp::getRuleIndex()
+{
+    CSSRuleIndex::StyleSheetList list;
+    if (defaultStyleSheet)
+        list.push_back({ defaultStyleSheet, CSSRuleListImp::UserAgent });
+    if (userStyleSheet)
+        list.push_back({ userStyleSheet, CSSRuleListImp::User });
+    if (presHintsStyleSheet)
+        list.push_back({ presHintsStyleSheet, CSSRuleListImp::Presentational });
+    std::lock_guard<std::mutex> lock(ruleIndexMutex);
+    ruleIndex = CSSRuleIndex::update(ruleIndex, list);
+    return ruleIndex;
+}
+
+void DOMImplementationImp::addStartupTask(std::function<std::string()> task)
+{
+    std::lock_guard<std::mutex> lock(startupMutex);
+    ++pendingStartupTasks;
+    startupTasks.push_back(std::async(std::launch::async, [this, task] {
+        std::string error;
+        try {
+            error = task();
+        } catch (std::exception& e) {
+            error = e.what();
+        } catch (...) {
+            error = "unknown exception";
+        }
+        std::lock_guard<std::mutex> lock(startupMutex);
+        if (!error.empty() && startupError.empty())
+            startupError = error;
+        if (--pendingStartupTasks == 0)
+            startupCondition.notify_all();
+    }));
+}
+
+bool DOMImplementationImp::waitForStartup()
+{
+    std::unique_lock<std::mutex> lock(startupMutex);
+    if (0 < pendingStartupTasks) {
+        startupCondition.wait(lock, [this] { return pendingStartupTasks == 0; });
+        recordTime("startup tasks joined");
+    }
+    return startupError.empty();
+}
+
+bool DOMImplementationImp::isStartingUp()
+{
+    std::lock_guard<std::mutex> lock(startupMutex);
+    return 0 < pendingStartupTasks;
+}
+
+bool DOMImplementationImp::hasStartupFailed()
+{
+    std::lock_guard<std::mutex> lock(startupMutex);
+    return !startupError.empty();
+}
+
+std::string DOMImplementationImp::getStartupError()
+{
+    std::lock_guard<std::mutex> lock(startupMutex);
+    return startupError;
+}
+
 DocumentType DOMImplementationImp::createDocumentType(const std::u16string& qualifiedName, const std::u16string& publicId, const std::u16string& systemId)
 {
     return new(std::nothrow) DocumentTypeImp(qualifiedName, publicId, systemId); // TODO: set node document
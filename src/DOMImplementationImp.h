@@ -17,6 +17,14 @@
 #ifndef DOMIMPLEMENTATION_IMP_H
 #define DOMIMPLEMENTATION_IMP_H
 
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
 #include <Object.h>
 #include <org/w3c/dom/DOMImplementation.h>
 #include <org/w3c/dom/css/CSSStyleSheet.h>
@@ -27,6 +35,7 @@
 
 namespace org { namespace w3c { namespace dom { namespace bootstrap {
 
+class CSSRuleIndex;
 class CSSStyleSheetImp;
 
 class DOMImplementationImp : public ObjectMixin<DOMImplementationImp>
@@ -35,6 +44,15 @@ class DOMImplementationImp : public ObjectMixin<DOMImplementationImp>
     css::CSSStyleSheet presHintsStyleSheet;
     css::CSSStyleSheet userStyleSheet;
 
+    std::mutex startupMutex;
+    std::condition_variable startupCondition;
+    std::vector<std::future<void>> startupTasks;
+    unsigned pendingStartupTasks;
+    std::string startupError;
+
+    std::mutex ruleIndexMutex;
+    std::shared_ptr<const CSSRuleIndex> ruleIndex;
+
 public:
     DOMImplementationImp();
 
@@ -45,6 +63,20 @@ public:
     CSSStyleSheetImp* getUserStyleSheet() const;
     void setUserStyleSheet(css::CSSStyleSheet sheet);
 
+    // Returns the rule index of the user agent, user and presentational hints
+    // style sheets, which is shared by every window.
+    std::shared_ptr<const CSSRuleIndex> getRuleIndex();
+
+    // Startup tasks such as loading fonts and the built-in style sheets run
+    // concurrently with the first page load; waitForStartup() waits for them
+    // before the first cascade. A task returns an error message upon failure,
+    // or an empty string, and the main thread checks getStartupError().
+    void addStartupTask(std::function<std::string()> task);
+    bool waitForStartup();
+    bool isStartingUp();
+    bool hasStartupFailed();
+    std::string getStartupError();
+
     // DOMImplementation
     DocumentType createDocumentType(const std::u16string& qualifiedName, const std::u16string& publicId, const std::u16string& systemId);
     XMLDocument createDocument(const Nullable<std::u16string>& _namespace, const std::u16string& qualifiedName, DocumentType doctype);
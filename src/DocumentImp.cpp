@@ -20,6 +20,8 @@
 
 #include <algorithm>
 #include <new>
+#include <set>
+#include <unordered_map>
 #include <vector>
 #include <boost/bind.hpp>
 #include <boost/format.hpp>
@@ -37,7 +39,10 @@
 #include "TextImp.h"
 #include "WindowImp.h"
 #include "XMLDocumentImp.h"
+#include "css/CSSParser.h"
+#include "css/CSSSelector.h"
 #include "css/CSSSerialize.h"
+#include "css/ViewCSSImp.h"
 #include "html/HTMLAnchorElementImp.h"
 #include "html/HTMLAppletElementImp.h"
 #include "html/HTMLAreaElementImp.h"
@@ -124,13 +129,15 @@ DocumentImp::DocumentImp(const std::u16string& url) :
     pendingParsingBlockingScript(0),
     defaultView(0),
     activeElement(0),
-    error(0)
+    error(0),
+    indexed(false)
 {
     nodeName = u"#document";
 }
 
 DocumentImp::~DocumentImp()
 {
+    clearSelectorsCache();
 }
 
 void DocumentImp::setEventHandler(const std::u16string& type, Object handler)
@@ -150,6 +157,286 @@ void DocumentImp::setEventHandler(const std::u16string& type, Object handler)
     }
 }
 
+void DocumentImp::clearSelectorsCache()
+{
+    for (auto i = selectorsList.begin(); i != selectorsList.end(); ++i)
+        delete i->second;
+    selectorsList.clear();
+    selectorsCache.clear();
+}
+
+CSSSelectorsGroup* DocumentImp::getSelectorsGroup(const std::u16string& selectors)
+{
+    // Scripts tend to use a small number of selectors repeatedly.
+    static const size_t MaxCachedSelectors = 256;
+
+    auto found = selectorsCache.find(selectors);
+    if (found != selectorsCache.end()) {
+        selectorsList.splice(selectorsList.begin(), selectorsList, found->second);
+        return found->second->second;
+    }
+    if (MaxCachedSelectors <= selectorsList.size()) {
+        delete selectorsList.back().second;
+        selectorsCache.erase(selectorsList.back().first);
+        selectorsList.pop_back();
+    }
+    CSSParser parser;
+    CSSSelectorsGroup* selectorsGroup = parser.parseSelectorsGroup(selectors);
+    if (selectorsGroup)
+        selectorsGroup->compile();
+    selectorsList.push_front(std::make_pair(selectors, selectorsGroup));  // cache null, too.
+    selectorsCache[selectors] = selectorsList.begin();
+    return selectorsGroup;
+}
+
+namespace {
+
+template <class F>
+void forEachClass(const std::u16string& classes, F f)
+{
+    for (size_t pos = 0; pos < classes.length();) {
+        if (isSpace(classes[pos])) {
+            ++pos;
+            continue;
+        }
+        size_t start = pos++;
+        while (pos < classes.length() && !isSpace(classes[pos]))
+            ++pos;
+        f(classes.substr(start, pos - start));
+    }
+}
+
+}
+
+bool DocumentImp::isLast(NodeImp* node)
+{
+    for (; node; node = node->parentNode) {
+        if (node->nextSibling)
+            return false;
+    }
+    return true;
+}
+
+void DocumentImp::addElement(ElementIndex& index, const std::u16string& key, ElementImp* element, bool atEnd)
+{
+    ElementList& list(index[key]);
+    if (!list.elements.insert(element).second)
+        return;
+    if (list.dirty)
+        return;
+    if (atEnd)
+        list.sorted.push_back(element);
+    else
+        list.dirty = true;
+}
+
+void DocumentImp::removeElement(ElementIndex& index, const std::u16string& key, ElementImp* element)
+{
+    auto found = index.find(key);
+    if (found == index.end())
+        return;
+    ElementList& list(found->second);
+    if (!list.elements.erase(element))
+        return;
+    if (list.elements.empty())
+        index.erase(found);
+    else if (!list.dirty) {
+        if (list.sorted.back() == element)
+            list.sorted.pop_back();
+        else
+            list.dirty = true;
+    }
+}
+
+void DocumentImp::indexElement(ElementImp* element, bool add, bool atEnd)
+{
+    if (add)
+        addElement(typeIndex, element->getLocalName(), element, atEnd);
+    else
+        removeElement(typeIndex, element->getLocalName(), element);
+    const std::u16string* id = element->findAttribute(u"id");
+    if (id && !id->empty()) {
+        if (add)
+            addElement(idIndex, *id, element, atEnd);
+        else
+            removeElement(idIndex, *id, element);
+    }
+    if (const std::u16string* classes = element->findAttribute(u"class")) {
+        forEachClass(*classes, [=](const std::u16string& name) {
+            if (add)
+                addElement(classIndex, name, element, atEnd);
+            else
+                removeElement(classIndex, name, element);
+        });
+    }
+}
+
+bool DocumentImp::isConnected(NodeImp* node)
+{
+    while (node->parentNode)
+        node = node->parentNode;
+    return node == this;
+}
+
+void DocumentImp::indexSubtree(NodeImp* parent, NodeImp* node, bool add)
+{
+    if (!isConnected(parent))
+        return;
+    std::vector<ElementImp*> elements;
+    for (NodeImp* i = node; i;) {
+        if (ElementImp* e = dynamic_cast<ElementImp*>(i))
+            elements.push_back(e);
+        if (i->firstChild) {
+            i = i->firstChild;
+            continue;
+        }
+        while (i != node && !i->nextSibling)
+            i = i->parentNode;
+        i = (i == node) ? 0 : i->nextSibling;
+    }
+    if (add) {
+        bool atEnd = isLast(node);
+        for (auto i = elements.begin(); i != elements.end(); ++i)
+            indexElement(*i, true, atEnd);
+    } else {
+        // Remove in reverse tree order so that the sorted lists stay sorted
+        // if node is the last one in the document.
+        for (auto i = elements.rbegin(); i != elements.rend(); ++i)
+            indexElement(*i, false, false);
+    }
+}
+
+void DocumentImp::buildElementIndexes()
+{
+    indexed = true;
+    for (NodeImp* child = firstChild; child; child = child->nextSibling)
+        indexSubtree(this, child, true);
+}
+
+void DocumentImp::attributeChanged(ElementImp* element, const std::u16string& name, const std::u16string& prevValue, const std::u16string& value)
+{
+    if (!indexed || !isConnected(element))
+        return;
+    bool atEnd = !element->firstChild && isLast(element);
+    if (name == u"id") {
+        if (!prevValue.empty())
+            removeElement(idIndex, prevValue, element);
+        if (!value.empty())
+            addElement(idIndex, value, element, atEnd);
+    } else if (name == u"class") {
+        std::set<std::u16string> prevClasses;
+        forEachClass(prevValue, [&](const std::u16string& name) { prevClasses.insert(name); });
+        std::set<std::u16string> classes;
+        forEachClass(value, [&](const std::u16string& name) { classes.insert(name); });
+        for (auto i = prevClasses.begin(); i != prevClasses.end(); ++i) {
+            if (classes.find(*i) == classes.end())
+                removeElement(classIndex, *i, element);
+        }
+        for (auto i = classes.begin(); i != classes.end(); ++i) {
+            if (prevClasses.find(*i) == prevClasses.end())
+                addElement(classIndex, *i, element, atEnd);
+        }
+    }
+}
+
+const std::vector<ElementImp*>* DocumentImp::findElements(int keyType, const std::u16string& key)
+{
+    ElementIndex* index;
+    switch (keyType) {
+    case CSSSelector::IDKey:
+        index = &idIndex;
+        break;
+    case CSSSelector::ClassKey:
+        index = &classIndex;
+        break;
+    case CSSSelector::TypeKey:
+        index = &typeIndex;
+        break;
+    default:
+        return 0;
+    }
+    if (!indexed)
+        buildElementIndexes();
+    auto found = index->find(key);
+    if (found == index->end())
+        return 0;
+    ElementList& list(found->second);
+    if (list.dirty) {
+        list.sorted.assign(list.elements.begin(), list.elements.end());
+        sortInTreeOrder(list.sorted);
+        list.dirty = false;
+    }
+    return &list.sorted;
+}
+
+bool DocumentImp::precedes(NodeImp* a, NodeImp* b)
+{
+    if (a == b)
+        return false;
+    std::vector<NodeImp*> pathA;
+    for (NodeImp* i = a; i; i = i->parentNode)
+        pathA.push_back(i);
+    std::vector<NodeImp*> pathB;
+    for (NodeImp* i = b; i; i = i->parentNode)
+        pathB.push_back(i);
+    auto i = pathA.rbegin();
+    auto j = pathB.rbegin();
+    while (i != pathA.rend() && j != pathB.rend() && *i == *j) {
+        ++i;
+        ++j;
+    }
+    if (i == pathA.rend())
+        return true;    // a is an ancestor of b.
+    if (j == pathB.rend())
+        return false;   // b is an ancestor of a.
+    // Walk the siblings from both sides so that the cost is bounded by the
+    // distance between them.
+    for (NodeImp* x = *i, * y = *j;;) {
+        x = x->nextSibling;
+        if (!x)
+            return false;
+        if (x == *j)
+            return true;
+        y = y->nextSibling;
+        if (!y)
+            return true;
+        if (y == *i)
+            return false;
+    }
+}
+
+void DocumentImp::sortInTreeOrder(std::vector<ElementImp*>& elements)
+{
+    if (elements.size() < 2)
+        return;
+    // Compare the paths of the child indexes from the root; the indexes of the
+    // children of each parent are counted only once.
+    std::unordered_map<NodeImp*, unsigned> indexes;
+    std::vector<std::pair<std::vector<unsigned>, ElementImp*>> paths;
+    paths.reserve(elements.size());
+    for (auto i = elements.begin(); i != elements.end(); ++i) {
+        std::vector<unsigned> path;
+        for (NodeImp* node = *i; node->parentNode; node = node->parentNode) {
+            auto found = indexes.find(node);
+            if (found == indexes.end()) {
+                unsigned index = 0;
+                for (NodeImp* child = node->parentNode->firstChild; child; child = child->nextSibling)
+                    indexes[child] = index++;
+                found = indexes.find(node);
+            }
+            path.push_back(found->second);
+        }
+        std::reverse(path.begin(), path.end());
+        paths.push_back(std::make_pair(std::move(path), *i));
+    }
+    std::sort(paths.begin(), paths.end());
+    elements.clear();
+    for (auto i = paths.begin(); i != paths.end(); ++i) {
+        if (elements.empty() || elements.back() != i->second)
+            elements.push_back(i->second);
+    }
+}
+
 bool DocumentImp::processScripts(std::list<html::HTMLScriptElement>& scripts)
 {
     while (!scripts.empty()) {
@@ -236,6 +523,10 @@ void DocumentImp::setFocus(ElementImp* element)
         event.initEvent(u"blur", false, false);
         activeElement->dispatchEvent(event);
     }
+    if (defaultView) {
+        defaultView->invalidateDynamicState(activeElement, 1u << CSSPseudoClassSelector::Focus);
+        defaultView->invalidateDynamicState(element, 1u << CSSPseudoClassSelector::Focus);
+    }
     activeElement = element;
     if (activeElement) {
         events::Event event = new(std::nothrow) EventImp;
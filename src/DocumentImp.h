@@ -48,11 +48,16 @@
 #include <org/w3c/dom/html/HTMLAllCollection.h>
 #include <org/w3c/dom/html/HTMLElement.h>
 #include <org/w3c/dom/html/HTMLHeadElement.h>
+#include <org/w3c/dom/html/HTMLTemplateElement.h>
 #include <org/w3c/dom/html/Window.h>
 #include <org/w3c/dom/html/Location.h>
 
 #include <deque>
 #include <list>
+#include <map>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
 
 #include "NodeImp.h"
 #include "DocumentWindow.h"
@@ -64,6 +69,16 @@ class HTMLTokenizer;
 
 namespace org { namespace w3c { namespace dom { namespace bootstrap {
 
+class CSSSelectorsGroup;
+
+// The shadow tree template and the implementation prototype of a binding
+// resolved from a binding URL; cf. HTMLElementImp::generateShadowContent()
+struct BindingPrototype
+{
+    html::HTMLTemplateElement shadowTree;
+    Object implementation;
+};
+
 class DocumentImp : public ObjectMixin<DocumentImp, NodeImp>
 {
     std::u16string url;
@@ -92,6 +107,40 @@ class DocumentImp : public ObjectMixin<DocumentImp, NodeImp>
 
     // XBL 2.0
     std::map<const std::u16string, html::Window> bindingDocuments;
+    std::mutex bindingMutex;
+    std::map<std::u16string, BindingPrototype> bindingPrototypes;  // keyed by binding URL
+    std::deque<html::HTMLElement> boundElements;  // waiting for HTMLElementImp::xblEnteredDocument()
+
+    // Selectors API
+    typedef std::list<std::pair<std::u16string, CSSSelectorsGroup*>> SelectorsList;
+    SelectorsList selectorsList;    // the most recently used first
+    std::map<std::u16string, SelectorsList::iterator> selectorsCache;
+
+    // The elements in the document tree that have a key. The index is built
+    // when it is used for the first time, and then it is updated as elements
+    // are inserted, removed, or their attributes are changed.
+    struct ElementList
+    {
+        std::unordered_set<ElementImp*> elements;
+        std::vector<ElementImp*> sorted;    // in tree order unless dirty
+        bool dirty;
+        ElementList() : dirty(false) {}
+    };
+    typedef std::map<std::u16string, ElementList> ElementIndex;
+    bool indexed;
+    ElementIndex idIndex;
+    ElementIndex classIndex;
+    ElementIndex typeIndex;
+
+    void clearSelectorsCache();
+    void buildElementIndexes();
+    bool isConnected(NodeImp* node);
+    // Returns true if no node follows node in tree order.
+    static bool isLast(NodeImp* node);
+    void indexSubtree(NodeImp* parent, NodeImp* node, bool add);
+    void indexElement(ElementImp* element, bool add, bool atEnd);
+    static void addElement(ElementIndex& index, const std::u16string& key, ElementImp* element, bool atEnd);
+    static void removeElement(ElementIndex& index, const std::u16string& key, ElementImp* element);
 
     bool processScripts(std::list<html::HTMLScriptElement>& scripts);
     void write(const Variadic<std::u16string>& text, bool linefeed);
@@ -240,6 +289,55 @@ public:
 
     bool isBindingDocumentWindow(const WindowImp* window) const;
 
+    // The bindings are resolved and the elements are bound by the background
+    // threads, while the implementations are created by the main thread.
+    // Note a prototype is never replaced once it has been added.
+    const BindingPrototype* findBindingPrototype(const std::u16string& url) {
+        std::lock_guard<std::mutex> lock(bindingMutex);
+        auto found = bindingPrototypes.find(url);
+        return (found != bindingPrototypes.end()) ? &found->second : 0;
+    }
+    const BindingPrototype* addBindingPrototype(const std::u16string& url, const BindingPrototype& prototype) {
+        std::lock_guard<std::mutex> lock(bindingMutex);
+        return &bindingPrototypes.insert(std::make_pair(url, prototype)).first->second;
+    }
+    void addBoundElement(html::HTMLElement element) {
+        std::lock_guard<std::mutex> lock(bindingMutex);
+        boundElements.push_back(element);
+    }
+    std::deque<html::HTMLElement> takeBoundElements() {
+        std::lock_guard<std::mutex> lock(bindingMutex);
+        std::deque<html::HTMLElement> elements;
+        elements.swap(boundElements);
+        return elements;
+    }
+
+    // elementInserted() must be called after node is inserted to parent,
+    // elementRemoved() before node is removed from parent, and
+    // attributeChanged() after an attribute of element is changed so that the
+    // element indexes are kept up to date.
+    void elementInserted(NodeImp* parent, NodeImp* node) {
+        if (indexed)
+            indexSubtree(parent, node, true);
+    }
+    void elementRemoved(NodeImp* parent, NodeImp* node) {
+        if (indexed)
+            indexSubtree(parent, node, false);
+    }
+    void attributeChanged(ElementImp* element, const std::u16string& name, const std::u16string& prevValue, const std::u16string& value);
+
+    // Returns the parsed and compiled selectors group for the specified
+    // selectors string; the result is owned by this document.
+    CSSSelectorsGroup* getSelectorsGroup(const std::u16string& selectors);
+    // Returns the elements in tree order that have the specified key of the
+    // CSSSelector::KeyType, or 0 if none.
+    const std::vector<ElementImp*>* findElements(int keyType, const std::u16string& key);
+
+    // Returns true if a precedes b in tree order.
+    static bool precedes(NodeImp* a, NodeImp* b);
+    // Sorts elements in tree order, and removes duplicates.
+    static void sortInTreeOrder(std::vector<ElementImp*>& elements);
+
     // Node - override
     virtual unsigned short getNodeType();
     virtual Node appendChild(Node newChild) throw(DOMException);
@@ -20,6 +20,7 @@
 #include "WindowImp.h"
 
 #include "Test.util.h"
+#include "Trace.h"
 
 void ECMAScriptContext::dispatchEvent(org::w3c::dom::bootstrap::EventListenerImp* listener, org::w3c::dom::events::Event event)
 {
@@ -31,6 +32,7 @@ void ECMAScriptContext::dispatchEvent(org::w3c::dom::bootstrap::EventListenerImp
     if (!functionObject)
         return;
     Any arg(event);
+    TraceScope scope("event handler");
     Any result = callFunction(event.getCurrentTarget(), functionObject, 1, &arg);
     if (event.getType() == u"mouseover") {
         if (result.toBoolean())
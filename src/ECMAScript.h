@@ -50,7 +50,8 @@ public:
     void enter(ObjectImp* windowProxy);
     void exit(ObjectImp* windowProxy);
 
-    Any evaluate(const std::u16string& script);
+    // url identifies script in the script cache; cf. ScriptCache.
+    Any evaluate(const std::u16string& script, const std::u16string& url = u"");
     Object* compileFunction(const std::u16string& body);
     Any callFunction(Object thisObject, Object functionObject, int argc, Any* argv);
 
@@ -31,6 +31,7 @@
 #include "MutationEventImp.h"
 #include "NodeListImp.h"
 #include "XMLDocumentImp.h"
+#include "css/CSSSelector.h"
 #include "css/CSSSerialize.h"
 #include "html/HTMLCollectionImp.h"
 #include "html/HTMLTokenizer.h"
@@ -49,7 +50,7 @@ public:
     virtual Attr getElement(unsigned int index) {
         if (element->attributes.size() <= index)
             return 0;
-        return element->attributes[index];
+        return element->getAttr(element->attributes[index]);
     }
     virtual void setElement(unsigned int index, Attr value) {
     }
@@ -63,12 +64,79 @@ public:
     }
 };
 
-void ElementImp::setAttributes(const std::deque<Attr>& attributes)
+void ElementImp::setAttributes(const std::deque<Attribute>& attributes)
+{
+    this->attributes.reserve(this->attributes.size() + attributes.size());
+    for (auto i = attributes.begin(); i != attributes.end(); ++i)
+        setAttributeNS(Nullable<std::u16string>(), i->getName(), i->getValue());
+}
+
+Attr ElementImp::getAttr(AttrData& data)
+{
+    if (!data.attr) {
+        Nullable<std::u16string> namespaceURI;
+        if (!data.namespaceURI.empty())
+            namespaceURI = data.namespaceURI;
+        Nullable<std::u16string> prefix;
+        if (!data.prefix.empty())
+            prefix = data.prefix;
+        data.attr = new(std::nothrow) AttrImp(this, namespaceURI, prefix, data.localName);
+    }
+    return data.attr;
+}
+
+void ElementImp::detachAttr(AttrData& data)
+{
+    if (AttrImp* attr = dynamic_cast<AttrImp*>(data.attr.self()))
+        attr->detach(data.value);
+    data.attr = 0;
+}
+
+Attr ElementImp::getAttributeNodeImp(const std::u16string& namespaceURI, const std::u16string& localName)
+{
+    for (auto i = attributes.begin(); i != attributes.end(); ++i) {
+        if (i->namespaceURI == namespaceURI && i->localName == localName)
+            return getAttr(*i);
+    }
+    return 0;
+}
+
+std::u16string ElementImp::getAttrValue(AttrImp* attr)
 {
     for (auto i = attributes.begin(); i != attributes.end(); ++i) {
-        Attr attr = *i;
-        setAttributeNS(attr.getNamespaceURI(), attr.getName(), attr.getValue());
+        if (i->attr.self() == attr)
+            return i->value;
     }
+    return u"";
+}
+
+void ElementImp::setAttrValue(AttrImp* attr, const std::u16string& value)
+{
+    for (auto i = attributes.begin(); i != attributes.end(); ++i) {
+        if (i->attr.self() == attr) {
+            if (i->value == value)
+                return;
+            std::u16string prevValue = i->value;
+            i->value = value;
+            if (DocumentImp* document = getOwnerDocumentImp())
+                document->attributeChanged(this, i->getName(), prevValue, value);
+            dispatchAttrModified(*i, prevValue, i->localName, events::MutationEvent::MODIFICATION);
+            return;
+        }
+    }
+}
+
+void ElementImp::dispatchAttrModified(const AttrData& data, const std::u16string& prevValue, const std::u16string& attrName, unsigned short attrChange)
+{
+    MutationEventImp* imp = new(std::nothrow) MutationEventImp;
+    if (!imp)
+        return;
+    events::MutationEvent event(imp);
+    if (attrChange == events::MutationEvent::REMOVAL)
+        event.initMutationEvent(u"DOMAttrModified", true, false, data.attr, prevValue, u"", attrName, attrChange);
+    else
+        imp->initAttrModifiedEvent(this, data.namespaceURI, data.localName, prevValue, data.value, attrName, attrChange);
+    dispatchEvent(event);
 }
 
 ElementImp* ElementImp::getNextElement(ElementImp* root)
@@ -143,10 +211,10 @@ bool ElementImp::isEqualNode(Node arg)
     for (auto i = attributes.begin(); i != attributes.end(); ++i) {
         bool found = false;
         for (auto j = element->attributes.begin(); j != element->attributes.end(); ++j) {
-            if (i->getLocalName() == j->getLocalName()) {
-                if (i->getNamespaceURI() != j->getNamespaceURI())
+            if (i->localName == j->localName) {
+                if (i->namespaceURI != j->namespaceURI)
                     break;
-                if (i->getValue() != j->getValue())
+                if (i->value != j->value)
                     break;
                 found = true;
                 break;
@@ -214,20 +282,17 @@ Nullable<std::u16string> ElementImp::getAttribute(const std::u16string& name)
     // TODO: If the context node is in the HTML namespace and its ownerDocument is an HTML document
     std::u16string n(name);
         toLower(n);
-    for (auto i = attributes.begin(); i != attributes.end(); ++i) {
-        Attr attr = *i;
-        if (attr.getName() == n)
-            return attr.getValue();
-    }
+    if (const std::u16string* value = findAttribute(n))
+        return *value;
     return Nullable<std::u16string>();
 }
 
 Nullable<std::u16string> ElementImp::getAttributeNS(const Nullable<std::u16string>& namespaceURI, const std::u16string& localName)
 {
+    std::u16string ns = static_cast<std::u16string>(namespaceURI);
     for (auto i = attributes.begin(); i != attributes.end(); ++i) {
-        Attr attr = *i;
-        if (static_cast<std::u16string>(attr.getNamespaceURI()) == static_cast<std::u16string>(namespaceURI) && attr.getLocalName() == localName)
-            return attr.getValue();
+        if (i->namespaceURI == ns && i->localName == localName)
+            return i->value;
     }
     return Nullable<std::u16string>();
 }
@@ -240,26 +305,21 @@ void ElementImp::setAttribute(const std::u16string& name, const std::u16string&
         toLower(n);
     // TODO: If qualifiedName starts with "xmlns", raise a NAMESPACE_ERR and terminate these steps.
     for (auto i = attributes.begin(); i != attributes.end(); ++i) {
-        Attr attr = *i;
-        if (attr.getName() == n) {
-            std::u16string prevValue = attr.getValue();
-            if (prevValue != value) {
-                attr.setValue(value);
-                events::MutationEvent event = new(std::nothrow) MutationEventImp;
-                event.initMutationEvent(u"DOMAttrModified",
-                                        true, false, attr, prevValue, value, n, events::MutationEvent::MODIFICATION);
-                this->dispatchEvent(event);
+        if (i->hasName(n)) {
+            if (i->value != value) {
+                std::u16string prevValue = i->value;
+                i->value = value;
+                if (DocumentImp* document = getOwnerDocumentImp())
+                    document->attributeChanged(this, i->getName(), prevValue, value);
+                dispatchAttrModified(*i, prevValue, n, events::MutationEvent::MODIFICATION);
             }
             return;
         }
     }
-    if (Attr attr = new(std::nothrow) AttrImp(Nullable<std::u16string>(), Nullable<std::u16string>(), n, value)) {
-        attributes.push_back(attr);
-        events::MutationEvent event = new(std::nothrow) MutationEventImp;
-        event.initMutationEvent(u"DOMAttrModified",
-                                true, false, attr, u"", value, n, events::MutationEvent::ADDITION);
-        this->dispatchEvent(event);
-    }
+    attributes.push_back(AttrData(u"", u"", n, value));
+    if (DocumentImp* document = getOwnerDocumentImp())
+        document->attributeChanged(this, n, u"", value);
+    dispatchAttrModified(attributes.back(), u"", n, events::MutationEvent::ADDITION);
 }
 
 void ElementImp::setAttributeNS(const Nullable<std::u16string>& namespaceURI, const std::u16string& name, const std::u16string& value)
@@ -285,29 +345,25 @@ void ElementImp::setAttributeNS(const Nullable<std::u16string>& namespaceURI, co
     if ((name == u"xmlns" || prefix.hasValue() && prefix.value() == u"xmlns") && namespaceURI != u"http://www.w3.org/2000/xmlns")
         throw DOMException{DOMException::NAMESPACE_ERR};
  */
+    std::u16string ns = static_cast<std::u16string>(namespaceURI);
     for (auto i = attributes.begin(); i != attributes.end(); ++i) {
-        Attr attr = *i;
-        if (static_cast<std::u16string>(attr.getNamespaceURI()) == static_cast<std::u16string>(namespaceURI) && attr.getLocalName() == localName) {
-            std::u16string prevValue = attr.getValue();
-            if (prevValue != value) {
-                attr.setValue(value);
+        if (i->namespaceURI == ns && i->localName == localName) {
+            if (i->value != value) {
+                std::u16string prevValue = i->value;
+                i->value = value;
+                if (DocumentImp* document = getOwnerDocumentImp())
+                    document->attributeChanged(this, i->getName(), prevValue, value);
                 // TODO: set prefix, too.
 
-                events::MutationEvent event = new(std::nothrow) MutationEventImp;
-                event.initMutationEvent(u"DOMAttrModified",
-                                        true, false, attr, prevValue, value, localName, events::MutationEvent::MODIFICATION);
-                dispatchEvent(event);
+                dispatchAttrModified(*i, prevValue, localName, events::MutationEvent::MODIFICATION);
             }
             return;
         }
     }
-    if (Attr attr = new(std::nothrow) AttrImp(namespaceURI, prefix, localName, value)) {
-        attributes.push_back(attr);
-        events::MutationEvent event = new(std::nothrow) MutationEventImp;
-        event.initMutationEvent(u"DOMAttrModified",
-                                true, false, attr, u"", value, localName, events::MutationEvent::ADDITION);
-        dispatchEvent(event);
-    }
+    attributes.push_back(AttrData(ns, static_cast<std::u16string>(prefix), localName, value));
+    if (DocumentImp* document = getOwnerDocumentImp())
+        document->attributeChanged(this, attributes.back().getName(), u"", value);
+    dispatchAttrModified(attributes.back(), u"", localName, events::MutationEvent::ADDITION);
 }
 
 void ElementImp::removeAttribute(const std::u16string& name)
@@ -316,13 +372,20 @@ void ElementImp::removeAttribute(const std::u16string& name)
     std::u16string n(name);
         toLower(n);
     for (auto i = attributes.begin(); i != attributes.end();) {
-        Attr attr = *i;
-        if (attr.getName() == n) {
-            events::MutationEvent event = new(std::nothrow) MutationEventImp;
-            event.initMutationEvent(u"DOMAttrModified",
-                                    true, false, attr, attr.getValue(), u"", n, events::MutationEvent::REMOVAL);
-            this->dispatchEvent(event);
+        if (i->hasName(n)) {
+            getAttr(*i);    // the removed Attr node is passed as relatedNode
+            dispatchAttrModified(*i, i->value, n, events::MutationEvent::REMOVAL);
+            // The event listeners may have modified the attributes.
+            for (i = attributes.begin(); i != attributes.end() && !i->hasName(n); ++i)
+                ;
+            if (i == attributes.end())
+                return;
+            detachAttr(*i);
+            std::u16string attrName = i->getName();
+            std::u16string prevValue = i->value;
             i = attributes.erase(i);
+            if (DocumentImp* document = getOwnerDocumentImp())
+                document->attributeChanged(this, attrName, prevValue, u"");
         } else
             ++i;
     }
@@ -330,14 +393,22 @@ void ElementImp::removeAttribute(const std::u16string& name)
 
 void ElementImp::removeAttributeNS(const Nullable<std::u16string>& namespaceURI, const std::u16string& localName)
 {
+    std::u16string ns = static_cast<std::u16string>(namespaceURI);
     for (auto i = attributes.begin(); i != attributes.end();) {
-        Attr attr = *i;
-        if (static_cast<std::u16string>(attr.getNamespaceURI()) == static_cast<std::u16string>(namespaceURI) && attr.getLocalName() == localName) {
-            events::MutationEvent event = new(std::nothrow) MutationEventImp;
-            event.initMutationEvent(u"DOMAttrModified",
-                                    true, false, attr, attr.getValue(), u"", localName, events::MutationEvent::REMOVAL);
-            this->dispatchEvent(event);
+        if (i->namespaceURI == ns && i->localName == localName) {
+            getAttr(*i);    // the removed Attr node is passed as relatedNode
+            dispatchAttrModified(*i, i->value, localName, events::MutationEvent::REMOVAL);
+            // The event listeners may have modified the attributes.
+            for (i = attributes.begin(); i != attributes.end() && !(i->namespaceURI == ns && i->localName == localName); ++i)
+                ;
+            if (i == attributes.end())
+                return;
+            detachAttr(*i);
+            std::u16string attrName = i->getName();
+            std::u16string prevValue = i->value;
             i = attributes.erase(i);
+            if (DocumentImp* document = getOwnerDocumentImp())
+                document->attributeChanged(this, attrName, prevValue, u"");
         } else
             ++i;
     }
@@ -348,19 +419,14 @@ bool ElementImp::hasAttribute(const std::u16string& name)
     // TODO: If the context node is in the HTML namespace and its ownerDocument is an HTML document
     std::u16string n(name);
         toLower(n);
-    for (auto i = attributes.begin(); i != attributes.end(); ++i) {
-        Attr attr = *i;
-        if (attr.getName() == n)
-            return true;
-    }
-    return false;
+    return findAttribute(n);
 }
 
 bool ElementImp::hasAttributeNS(const Nullable<std::u16string>& namespaceURI, const std::u16string& localName)
 {
+    std::u16string ns = static_cast<std::u16string>(namespaceURI);
     for (auto i = attributes.begin(); i != attributes.end(); ++i) {
-        Attr attr = *i;
-        if (static_cast<std::u16string>(attr.getNamespaceURI()) == static_cast<std::u16string>(namespaceURI) && attr.getLocalName() == localName)
+        if (i->namespaceURI == ns && i->localName == localName)
             return true;
     }
     return false;
@@ -605,41 +671,80 @@ void ElementImp::insertAdjacentHTML(const insertAdjacentHTMLPosition& position,
     // TODO: implement me!
 }
 
-Element ElementImp::querySelector(CSSSelectorsGroup* selectorsGroup, ViewCSSImp* view)
+bool ElementImp::findIndexedElements(CSSSelectorsGroup* selectorsGroup, ViewCSSImp* view, bool firstOnly, std::vector<ElementImp*>& elements)
 {
-    if (selectorsGroup->evaluate(this, view))
-        return this;
-    for (auto i = getFirstElementChild(); i; i = i.getNextElementSibling()) {
-        if (auto imp = dynamic_cast<ElementImp*>(i.self())) {
-            if (Element e = imp->querySelector(selectorsGroup, view))
-                return e;
+    for (unsigned i = 0; i < selectorsGroup->getLength(); ++i) {
+        if (selectorsGroup->getSelector(i)->getKeyType() == CSSSelector::NoKey)
+            return false;
+    }
+    // The document indexes cover the elements in the document tree only.
+    DocumentImp* document = getOwnerDocumentImp();
+    ElementImp* root = dynamic_cast<ElementImp*>(document->getDocumentElement().self());
+    if (!root || (root != this && !root->isAncestorOf(this)))
+        return false;
+
+    // The candidates in this subtree lie between this element and the node
+    // following this subtree in each sorted list.
+    NodeImp* following = 0;
+    for (NodeImp* node = this; node && !following; node = node->parentNode)
+        following = node->nextSibling;
+    for (unsigned i = 0; i < selectorsGroup->getLength(); ++i) {
+        CSSSelector* selector = selectorsGroup->getSelector(i);
+        const std::vector<ElementImp*>* list = document->findElements(selector->getKeyType(), selector->getKey());
+        if (!list)
+            continue;
+        auto begin = (this == root) ? list->begin() : std::lower_bound(list->begin(), list->end(), this, DocumentImp::precedes);
+        auto end = following ? std::lower_bound(begin, list->end(), following, DocumentImp::precedes) : list->end();
+        for (auto j = begin; j != end; ++j) {
+            ElementImp* e = *j;
+            if (!selector->isKeyOnly()) {
+                Element element(e);
+                if (!selector->match(element, view, true))
+                    continue;
+            }
+            elements.push_back(e);
+            if (firstOnly)
+                break;
         }
     }
+    if (1 < selectorsGroup->getLength())
+        DocumentImp::sortInTreeOrder(elements);
+    return true;
+}
+
+Element ElementImp::querySelector(CSSSelectorsGroup* selectorsGroup, ViewCSSImp* view)
+{
+    for (ElementImp* e = this; e; e = e->getNextElement(this)) {
+        if (selectorsGroup->evaluate(e, view))
+            return e;
+    }
     return 0;
 }
 
 Element ElementImp::querySelector(const std::u16string& selectors)
 {
-    CSSParser parser;
-    std::unique_ptr<CSSSelectorsGroup> selectorsGroup(parser.parseSelectorsGroup(selectors));
-    if (!selectorsGroup)
+    DocumentImp* document = getOwnerDocumentImp();
+    if (!document)
         return 0;
-
-    if (!getOwnerDocumentImp())
+    CSSSelectorsGroup* selectorsGroup = document->getSelectorsGroup(selectors);
+    if (!selectorsGroup)
         return 0;
-    WindowImp* window = getOwnerDocumentImp()->getDefaultWindow();
+    WindowImp* window = document->getDefaultWindow();
     if (!window)
         return 0;
-    return querySelector(selectorsGroup.get(), window->getView());
+    ViewCSSImp* view = window->getView();
+
+    std::vector<ElementImp*> elements;
+    if (findIndexedElements(selectorsGroup, view, true, elements))
+        return elements.empty() ? 0 : elements.front();
+    return querySelector(selectorsGroup, view);
 }
 
 void ElementImp::querySelectorAll(NodeListImp* nodeList, CSSSelectorsGroup* selectorsGroup, ViewCSSImp* view)
 {
-    if (selectorsGroup->evaluate(this, view))
-        nodeList->addItem(this);
-    for (auto i = getFirstElementChild(); i; i = i.getNextElementSibling()) {
-        if (auto imp = dynamic_cast<ElementImp*>(i.self()))
-            imp->querySelectorAll(nodeList, selectorsGroup, view);
+    for (ElementImp* e = this; e; e = e->getNextElement(this)) {
+        if (selectorsGroup->evaluate(e, view))
+            nodeList->addItem(e);
     }
 }
 
@@ -649,17 +754,24 @@ NodeList ElementImp::querySelectorAll(const std::u16string& selectors)
     if (!nodeList)
         return 0;
 
-    CSSParser parser;
-    std::unique_ptr<CSSSelectorsGroup> selectorsGroup(parser.parseSelectorsGroup(selectors));
-    if (!selectorsGroup)
+    DocumentImp* document = getOwnerDocumentImp();
+    if (!document)
         return nodeList;
-
-    if (!getOwnerDocumentImp())
+    CSSSelectorsGroup* selectorsGroup = document->getSelectorsGroup(selectors);
+    if (!selectorsGroup)
         return nodeList;
-    WindowImp* window = getOwnerDocumentImp()->getDefaultWindow();
+    WindowImp* window = document->getDefaultWindow();
     if (!window)
         return nodeList;
-    querySelectorAll(nodeList, selectorsGroup.get(), window->getView());
+    ViewCSSImp* view = window->getView();
+
+    std::vector<ElementImp*> elements;
+    if (findIndexedElements(selectorsGroup, view, false, elements)) {
+        for (auto i = elements.begin(); i != elements.end(); ++i)
+            nodeList->addItem(*i);
+        return nodeList;
+    }
+    querySelectorAll(nodeList, selectorsGroup, view);
     return nodeList;
 }
 
@@ -706,10 +818,15 @@ ElementImp::ElementImp(ElementImp* org, bool deep) :
     namespaceURI = org->namespaceURI;
     prefix = org->prefix;
     localName = org->localName;
-    for (auto i = org->attributes.begin(); i != org->attributes.end(); ++i) {
-        if (Attr attr = new(std::nothrow) AttrImp(*dynamic_cast<AttrImp*>((*i).self())))
-            attributes.push_back(attr);
-    }
+    attributes.reserve(org->attributes.size());
+    for (auto i = org->attributes.begin(); i != org->attributes.end(); ++i)
+        attributes.push_back(AttrData(i->namespaceURI, i->prefix, i->localName, i->value));
+}
+
+ElementImp::~ElementImp()
+{
+    for (auto i = attributes.begin(); i != attributes.end(); ++i)
+        detachAttr(*i);
 }
 
 }}}}  // org::w3c::dom::bootstrap
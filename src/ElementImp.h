@@ -36,11 +36,16 @@
 #include <org/w3c/dom/xbl2/XBLImplementationList.h>
 
 #include <deque>
+#include <vector>
 
 #include "NodeImp.h"
 
+class Attribute;
+
 namespace org { namespace w3c { namespace dom { namespace bootstrap {
 
+class AttrImp;
+class CSSSelector;
 class CSSSelectorsGroup;
 class HTMLCollectionImp;
 class NodeListImp;
@@ -49,21 +54,80 @@ class ViewCSSImp;
 class ElementImp : public ObjectMixin<ElementImp, NodeImp>
 {
     friend class AttrArray;
+    friend class AttrImp;
     friend class ViewCSSImp;
 
-    std::deque<Attr> attributes;
+    // An attribute is kept as a name-value pair; the Attr node is created
+    // only when it is requested.
+    struct AttrData
+    {
+        std::u16string namespaceURI;    // empty if null
+        std::u16string prefix;          // empty if null
+        std::u16string localName;
+        std::u16string value;
+        Attr attr;
+
+        AttrData(const std::u16string& namespaceURI, const std::u16string& prefix, const std::u16string& localName, const std::u16string& value) :
+            namespaceURI(namespaceURI),
+            prefix(prefix),
+            localName(localName),
+            value(value),
+            attr(0)
+        {
+        }
+        bool hasName(const std::u16string& name) const {
+            if (prefix.empty())
+                return localName == name;
+            return name.length() == prefix.length() + 1 + localName.length() &&
+                   !name.compare(0, prefix.length(), prefix) &&
+                   name[prefix.length()] == u':' &&
+                   !name.compare(prefix.length() + 1, localName.length(), localName);
+        }
+        std::u16string getName() const {
+            if (prefix.empty())
+                return localName;
+            return prefix + u':' + localName;
+        }
+    };
+
+    std::vector<AttrData> attributes;
     std::u16string namespaceURI;
     std::u16string prefix;
     std::u16string localName;
 
+    // Collects the elements in this subtree that match selectorsGroup in tree
+    // order using the document indexes; returns false if the group has a
+    // selector without a key, or this element is not in the document tree.
+    bool findIndexedElements(CSSSelectorsGroup* selectorsGroup, ViewCSSImp* view, bool firstOnly, std::vector<ElementImp*>& elements);
     Element querySelector(CSSSelectorsGroup* selectorsGroup, ViewCSSImp* view);
     void querySelectorAll(NodeListImp* nodeList, CSSSelectorsGroup* selectorsGroup, ViewCSSImp* view);
 
+    Attr getAttr(AttrData& data);
+    void detachAttr(AttrData& data);
+    void dispatchAttrModified(const AttrData& data, const std::u16string& prevValue, const std::u16string& attrName, unsigned short attrChange);
+
+    // for AttrImp
+    std::u16string getAttrValue(AttrImp* attr);
+    void setAttrValue(AttrImp* attr, const std::u16string& value);
+
 public:
     ElementImp(DocumentImp* ownerDocument, const std::u16string& localName, const std::u16string& namespaceURI, const std::u16string& prefix = u"");
     ElementImp(ElementImp* org, bool deep);
-
-    void setAttributes(const std::deque<Attr>& attributes);
+    ~ElementImp();
+
+    void setAttributes(const std::deque<Attribute>& attributes);
+    Attr getAttributeNodeImp(const std::u16string& namespaceURI, const std::u16string& localName);
+
+    // Returns the value of the attribute of the specified lowercase name
+    // without creating a copy, or 0 if there is no such attribute. The
+    // pointer is valid until the attributes of this element are modified.
+    const std::u16string* findAttribute(const std::u16string& name) const {
+        for (auto i = attributes.begin(); i != attributes.end(); ++i) {
+            if (i->hasName(name))
+                return &i->value;
+        }
+        return 0;
+    }
     ElementImp* getNextElement(ElementImp* root = 0);
 
     // notify() is called when conditions that are not handled by DOM events
@@ -24,6 +24,7 @@
 #include "http/HTTPConnection.h"
 
 #include "Profile.h"
+#include "ScriptCache.h"
 #include "Test.util.h"
 
 #ifdef USE_V8
@@ -35,6 +36,25 @@ using namespace org::w3c::dom;
 
 extern html::Window window;
 
+namespace
+{
+
+// Quits if the fonts or the built-in style sheets could not be loaded.
+void checkStartup(int value)
+{
+    bool startingUp = getDOMImplementation()->isStartingUp();
+    std::string error = getDOMImplementation()->getStartupError();
+    if (!error.empty()) {
+        std::cerr << "error: " << error << ".\n";
+        glutLeaveMainLoop();
+        return;
+    }
+    if (startingUp)
+        glutTimerFunc(50, checkStartup, 0);
+}
+
+}
+
 int main(int argc, char* argv[])
 {
 #ifdef USE_V8
@@ -72,31 +92,66 @@ int main(int argc, char* argv[])
         return EXIT_FAILURE;
     }
     HttpRequest::setCachePath(profile.createPath("cache"));
+    if (profile.createDirectory("scripts") != -1)
+        ScriptCache::setCachePath(profile.createPath("scripts"));
+    FontDatabase::setIndexPath(profile.createPath("fonts.index"));
 
     init(&argc, argv);
     initLogLevel(&argc, argv, 0);
-    initFonts(&argc, argv);
+    recordTime("startup");
+    bool testFonts = removeTestFontsOption(&argc, argv);
     setWindowClass("escudo", "Escudo");
 
-    // Load the default style sheet
+    // Start the HTTP service first so that the navigator page can be requested
+    // while the fonts and the built-in style sheets are being loaded. The
+    // loading tasks are joined before the first cascade; cf. waitForStartup().
+    HttpRequest::setAboutPath(argv[1]);
+    std::thread httpService(std::ref(HttpConnectionManager::getInstance()));
+    recordTime("http service started");
+
+    getDOMImplementation()->addStartupTask([testFonts]() -> std::string {
+        loadFonts(testFonts);
+        recordTime("fonts loaded");
+        return "";
+    });
+
+    // The style sheet paths are resolved here as the task may outlive profile
+    // if the main loop is left early; cf. waitForStartup() below.
     std::string defaultSheet = profile.getProfilePath() + "/default.css";
     if (!profile.hasFile(defaultSheet))
         defaultSheet = std::string(argv[1]) + "/default.css";
-    getDOMImplementation()->setDefaultStyleSheet(loadStyleSheet(defaultSheet.c_str()));
-
-    // Load the presentational hints
+    std::string defaultSnapshot = profile.createPath("default.css.snapshot");
     std::string presHints = profile.getProfilePath() + "/preshint.css";
     if (!profile.hasFile(presHints))
         presHints = std::string(argv[1]) + "/preshint.css";
-    getDOMImplementation()->setPresentationalHints(loadStyleSheet(presHints.c_str()));
-
-    // Load the user style sheet
+    std::string presHintsSnapshot = profile.createPath("preshint.css.snapshot");
     std::string userSheet = profile.getProfilePath() + "/user.css";
-    if (profile.hasFile(userSheet))
-        getDOMImplementation()->setUserStyleSheet(loadStyleSheet(userSheet.c_str()));
-
-    HttpRequest::setAboutPath(argv[1]);
-    std::thread httpService(std::ref(HttpConnectionManager::getInstance()));
+    if (!profile.hasFile(userSheet))
+        userSheet.clear();
+    std::string userSnapshot = profile.createPath("user.css.snapshot");
+    getDOMImplementation()->addStartupTask([=]() -> std::string {
+        // Load the default style sheet
+        css::CSSStyleSheet sheet = loadStyleSheet(defaultSheet.c_str(), defaultSnapshot.c_str());
+        if (!sheet)
+            return "cannot load the default style sheet '" + defaultSheet + "'";
+        getDOMImplementation()->setDefaultStyleSheet(sheet);
+
+        // Load the presentational hints
+        sheet = loadStyleSheet(presHints.c_str(), presHintsSnapshot.c_str());
+        if (!sheet)
+            return "cannot load the presentational hints '" + presHints + "'";
+        getDOMImplementation()->setPresentationalHints(sheet);
+
+        // Load the user style sheet
+        if (!userSheet.empty()) {
+            sheet = loadStyleSheet(userSheet.c_str(), userSnapshot.c_str());
+            if (!sheet)
+                return "cannot load the user style sheet '" + userSheet + "'";
+            getDOMImplementation()->setUserStyleSheet(sheet);
+        }
+        recordTime("style sheets loaded");
+        return "";
+    });
 
     std::string navigatorPath = profile.getProfilePath() + "/escudo.html";
     if (!profile.hasFile(navigatorPath))
@@ -106,13 +161,20 @@ int main(int argc, char* argv[])
     imp->setFaviconOverridable(true);
     imp->enableZoom(false);
     imp->open(utfconv(getFileURL(navigatorPath)), u"_self", u"", true);
+    recordTime("navigator requested");
 
+    glutTimerFunc(50, checkStartup, 0);
     glutMainLoop();
 
+    // The startup tasks may still be running if the main loop was left early.
+    getDOMImplementation()->waitForStartup();
+
     window = 0;
 
     ECMAScriptContext::shutDown();
 
     HttpConnectionManager::getInstance().stop();
     httpService.join();
+
+    return getDOMImplementation()->hasStartupFailed() ? EXIT_FAILURE : EXIT_SUCCESS;
 }
@@ -16,14 +16,21 @@
 
 #include "html/HTMLInputStream.h"
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <random>
 #include <sstream>
 
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
 
+#include <unicode/ucnv.h>
+
+#include "U16InputStream.h"
+#include "utf.h"
+
 char data[64*1024];
 char encoding[1024];
 
@@ -40,6 +47,164 @@ int test()
     return EXIT_SUCCESS;
 }
 
+// Converts UTF-8 with ICU as the reference decoder.
+std::u16string icuUtf8to16(const std::string& utf8)
+{
+    UErrorCode err = U_ZERO_ERROR;
+    UConverter* converter = ucnv_open("utf-8", &err);
+    std::u16string text(utf8.length() + 1, u'\0');
+    const char* source = utf8.data();
+    UChar* target = reinterpret_cast<UChar*>(&text[0]);
+    ucnv_toUnicode(converter,
+                   &target, target + text.length(),
+                   &source, source + utf8.length(),
+                   0, true, &err);
+    text.resize(reinterpret_cast<char16_t*>(target) - &text[0]);
+    ucnv_close(converter);
+    return text;
+}
+
+// Applies the preprocessing done by U16ConverterInputStream to text.
+std::u16string preprocess(const std::u16string& text)
+{
+    std::u16string result;
+    char16_t lastChar = 0;
+    for (auto i = text.begin(); i != text.end(); ++i) {
+        char16_t c = *i;
+        if (c == 0xFEFF)
+            continue;
+        if (lastChar == '\r' && c == '\n') {
+            lastChar = c;
+            continue;
+        }
+        lastChar = c;
+        if (c == '\r')
+            c = '\n';
+        else if (c == '\0')
+            c = u'\xfffd';
+        result += c;
+    }
+    return result;
+}
+
+// Decodes utf8 with utf8to16() splitting the source and the target at random
+// positions.
+std::u16string splitUtf8to16(const std::string& utf8, std::mt19937& engine)
+{
+    std::u16string text;
+    char16_t buffer[4];
+    const char* source = utf8.data();
+    const char* end = source + utf8.length();
+    const char* sourceLimit = source;
+    do {
+        sourceLimit = std::min(end, sourceLimit + engine() % 8);
+        bool flush = (sourceLimit == end);
+        for (;;) {
+            const char* previous = source;
+            char16_t* target = buffer;
+            char16_t* targetLimit = buffer + 1 + engine() % 4;
+            utf8to16(&source, sourceLimit, &target, targetLimit, flush);
+            text.append(buffer, target - buffer);
+            if (source == previous && 2 <= targetLimit - buffer)
+                break;
+        }
+    } while (sourceLimit < end);
+    return text;
+}
+
+// Generates UTF-8 text mixing ASCII runs, valid and ill-formed sequences,
+// CR, LF, NUL, and BOM.
+std::string randomUtf8(std::mt19937& engine, size_t length)
+{
+    static const char* pieces[] = {
+        "\r\n", "\r", "\n", "", "\xef\xbb\xbf",
+        "\xc3\xa9", "\xe3\x81\x82", "\xf0\x9f\x98\x80", "\xf4\x8f\xbf\xbf",
+        "\xc0\xaf", "\xe0\x80\xaf", "\xed\xa0\x80", "\xf4\x90\x80\x80", "\xf8\x88\x80\x80\x80",
+        "\xe3\x81", "\xf0\x9f\x98", "\x80", "\xff",
+    };
+    std::string utf8;
+    while (utf8.length() < length) {
+        switch (engine() % 4) {
+        case 0:
+            utf8.append(engine() % 64, 'a' + engine() % 26);
+            break;
+        case 1:
+            utf8 += static_cast<char>(engine() % 256);
+            break;
+        default: {
+            const char* piece = pieces[engine() % (sizeof pieces / sizeof pieces[0])];
+            if (*piece)
+                utf8 += piece;
+            else
+                utf8 += '\0';
+            break;
+        }
+        }
+    }
+    return utf8;
+}
+
+int testUtf8(const char* name, const std::string& utf8, std::mt19937& engine)
+{
+    std::u16string expected = icuUtf8to16(utf8);
+    std::u16string decoded = splitUtf8to16(utf8, engine);
+    std::istringstream stream(utf8);
+    U16ConverterInputStream converterInputStream(stream, "utf-8");
+    std::u16string read = converterInputStream;
+    if (decoded != expected) {
+        std::cout << "FAIL: utf8to16 " << name << '\n';
+        return EXIT_FAILURE;
+    }
+    if (read != preprocess(expected)) {
+        std::cout << "FAIL: U16ConverterInputStream " << name << '\n';
+        return EXIT_FAILURE;
+    }
+    std::cout << "PASS: " << name << '\n';
+    return EXIT_SUCCESS;
+}
+
+// Checks the UTF-8 decoder against ICU.
+int testUtf8()
+{
+    int rc = EXIT_SUCCESS;
+    std::mt19937 engine(1);
+    const size_t chunkSize = U16ConverterInputStream::ChunkSize;
+
+    // Sequences split at the chunk boundary, complete or truncated at the end.
+    static const char* sequences[] = {
+        "\xc3\xa9", "\xe3\x81\x82", "\xf0\x9f\x98\x80", "\xed\xa0\x80", "\xe3\x81", "\xf0\x9f\x98"
+    };
+    for (auto i = std::begin(sequences); i != std::end(sequences); ++i) {
+        for (size_t k = 1; k <= strlen(*i); ++k) {
+            std::string utf8(chunkSize - k, 'a');
+            utf8 += *i;
+            rc |= testUtf8("chunk boundary", utf8 + "bc", engine);
+            rc |= testUtf8("chunk boundary at the end", utf8, engine);
+        }
+    }
+
+    // A surrogate pair is not split at targetLimit.
+    const char* source = "\xf0\x9f\x98\x80";
+    char16_t buffer[2];
+    char16_t* target = buffer;
+    utf8to16(&source, source + 4, &target, buffer + 1, true);
+    if (target != buffer || source[0] != '\xf0') {
+        std::cout << "FAIL: surrogate pair at targetLimit\n";
+        rc = EXIT_FAILURE;
+    } else {
+        utf8to16(&source, source + 4, &target, buffer + 2, true);
+        if (target != buffer + 2 || buffer[0] != 0xD83D || buffer[1] != 0xDE00) {
+            std::cout << "FAIL: surrogate pair at targetLimit\n";
+            rc = EXIT_FAILURE;
+        } else
+            std::cout << "PASS: surrogate pair at targetLimit\n";
+    }
+
+    for (int i = 0; i < 64; ++i)
+        rc |= testUtf8("random", randomUtf8(engine, 1 + engine() % (3 * chunkSize)), engine);
+    return rc;
+}
+
 int load(const char* filename)
 {
     int rc = EXIT_SUCCESS;
@@ -79,7 +244,7 @@ int main(int argc, char* argv[])
         std::cout << "usage: " << argv[0] << " [test.dat]...\n";
         exit(EXIT_FAILURE);
     }
-    int rc = EXIT_SUCCESS;
+    int rc = testUtf8();
     for (int i = 1; i < argc; ++i)
         rc |= load(argv[i]);
     return rc;
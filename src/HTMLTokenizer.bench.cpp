@@ -0,0 +1,106 @@
+/*
+ * Copyright 2013 Esrille Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// HTMLTokenizer.bench reports the tokenizer throughput over the specified
+// HTML files, or the inputs of the html5lib tokenizer tests.
+
+#include "html/HTMLInputStream.h"
+#include "html/HTMLTokenizer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "picojson.h"
+
+namespace
+{
+
+bool loadInputs(const char* filename, std::vector<std::string>& inputs)
+{
+    std::ifstream stream(filename);
+    if (!stream) {
+        std::cerr << "error: cannot open " << filename << ".\n";
+        return false;
+    }
+    std::string path(filename);
+    if (path.length() < 5 || path.compare(path.length() - 5, 5, ".test")) {
+        std::ostringstream html;
+        html << stream.rdbuf();
+        inputs.push_back(html.str());
+        return true;
+    }
+
+    picojson::value value;
+    stream >> value;
+    if (!stream)
+        return false;
+    picojson::array array = value.get<picojson::object>()["tests"].get<picojson::array>();
+    for (auto i = array.begin(); i != array.end(); ++i)
+        inputs.push_back(i->get<picojson::object>()["input"].to_str());
+    return true;
+}
+
+size_t tokenize(const std::string& input)
+{
+    size_t count = 0;
+    std::istringstream stream(input);
+    HTMLInputStream htmlInputStream(stream, "utf-8");
+    HTMLTokenizer tokenizer(&htmlInputStream);
+    while (tokenizer.getToken().getType() != Token::Type::EndOfFile)
+        ++count;
+    return count;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned repeat = 16;
+    int i = 1;
+    if (i < argc && strncmp(argv[i], "--repeat=", 9) == 0)
+        repeat = std::max(1, atoi(argv[i++] + 9));
+    if (argc <= i) {
+        std::cout << "usage: " << argv[0] << " [--repeat=N] [tokenizer.test | file.html]...\n";
+        return EXIT_FAILURE;
+    }
+    std::vector<std::string> inputs;
+    for (; i < argc; ++i) {
+        if (!loadInputs(argv[i], inputs))
+            return EXIT_FAILURE;
+    }
+
+    size_t bytes = 0;
+    size_t tokens = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned r = 0; r < repeat; ++r) {
+        for (auto i = inputs.begin(); i != inputs.end(); ++i) {
+            tokens += tokenize(*i);
+            bytes += i->length();
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "tokens: " << tokens << '\n';
+    if (0.0 < seconds)
+        std::cout << "throughput: " << bytes / seconds / (1024 * 1024) << " MB/s (" << bytes << " bytes)\n";
+    return EXIT_SUCCESS;
+}
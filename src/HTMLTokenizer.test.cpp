@@ -78,7 +78,10 @@ bool emit(const Token& token, std::ostream& output)
         break;
     case Token::Type::Character:
         characterMode = true;
-        characters += token.getChar();
+        if (token.isRun())
+            characters += token.getName();
+        else
+            characters += token.getChar();
         break;
     case Token::Type::EndOfFile:
         eof = true;
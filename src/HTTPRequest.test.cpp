@@ -18,6 +18,7 @@
 
 #include <unistd.h>
 
+#include <cstdlib>
 #include <iostream>
 #include <boost/version.hpp>
 #include <boost/iostreams/stream.hpp>
@@ -60,11 +61,95 @@ int test(std::u16string urlString)
     return 0;
 }
 
+// Reads the content of a data: URL, or returns false on error.
+bool readData(const std::u16string& url, std::string& content)
+{
+    HttpRequest request;
+    request.open(u"get", url);
+    request.send();
+    if (request.getReadyState() != HttpRequest::DONE || request.getError())
+        return false;
+    std::FILE* file = request.openFile();
+    if (!file)
+        return false;
+    content.clear();
+    for (int c; (c = fgetc(file)) != EOF;)
+        content += static_cast<char>(c);
+    fclose(file);
+    return true;
+}
+
+int testData(const std::u16string& url, const std::string& expected)
+{
+    std::string content;
+    if (!readData(url, content) || content != expected) {
+        std::cout << "FAIL: " << url << '\n';
+        return EXIT_FAILURE;
+    }
+    // The second request shares the content decoded by the first one.
+    HttpRequest first;
+    first.open(u"get", url);
+    first.send();
+    if (!readData(url, content) || content != expected) {
+        std::cout << "FAIL: " << url << " (shared)\n";
+        return EXIT_FAILURE;
+    }
+    std::cout << "PASS: " << url << '\n';
+    return EXIT_SUCCESS;
+}
+
+int testDataError(const std::u16string& url)
+{
+    std::string content;
+    if (readData(url, content)) {
+        std::cout << "FAIL: " << url << '\n';
+        return EXIT_FAILURE;
+    }
+    std::cout << "PASS: " << url << '\n';
+    return EXIT_SUCCESS;
+}
+
+int testData()
+{
+    int rc = EXIT_SUCCESS;
+
+    // Percent-encoded data is decoded only once.
+    rc |= testData(u"data:,Hello%2C%20World!", "Hello, World!");
+    rc |= testData(u"data:,%2541", "%41");
+    rc |= testData(u"data:text/plain,", "");
+
+    // Whole groups of four digits
+    rc |= testData(u"data:;base64,QUJD", "ABC");
+    rc |= testData(u"data:;base64,SGVsbG8sIFdvcmxkIQ==", "Hello, World!");
+    rc |= testData(u"data:;base64,AP8A/w==", std::string("\0\xff\0\xff", 4));
+    // Padding
+    rc |= testData(u"data:;base64,QQ==", "A");
+    rc |= testData(u"data:;base64,QUI=", "AB");
+    // White space within and between the groups
+    rc |= testData(u"data:;base64,QU%20JD%0AQUJD", "ABCABC");
+    rc |= testData(u"data:;base64,", "");
+    // Blocks of 16 and 32 digits, followed by the white space, the padding,
+    // or a partial block
+    rc |= testData(u"data:;base64,QUJDREVGR0hJSktMTU5PUFFSU1RVVldYWVphYmNkZWZnaGlqa2xtbm9wcXJzdHV2d3h5ejAxMjM0NTY3ODkrLw==",
+                   "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/");
+    rc |= testData(u"data:;base64,+/+/AAAA////09Tr%20QUJDREVGR0hJSktM",
+                   std::string("\xfb\xff\xbf\0\0\0\xff\xff\xff\xd3\xd4\xeb" "ABCDEFGHIJKL", 24));
+
+    rc |= testDataError(u"data:;base64,Q===");
+    rc |= testDataError(u"data:;base64,QUJ");
+    rc |= testDataError(u"data:;base64,QU*D");
+    rc |= testDataError(u"data:;base64,QUJDQ");
+    rc |= testDataError(u"data:;base64,QUJDREVGR0hJSktMTU5P*FFSU1RVVldY");
+    rc |= testDataError(u"data:text/plain");
+
+    return rc;
+}
+
 int main(int argc, char* argv[])
 {
     initLogLevel(&argc, argv, 3);
 
-    int result = 0;
+    int result = testData();
     if (2 <= argc) {
         for (int i = 1; i < argc; ++i)
             result += test(utfconv(argv[1]));
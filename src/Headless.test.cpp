@@ -0,0 +1,251 @@
+/*
+ * Copyright 2013 Esrille Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Headless.test renders a page into an OSMesa offscreen buffer without
+// GLUT and a display, so that layout and paint can be benchmarked on the
+// machines without a display.
+
+#include <png.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <GL/glew.h>
+#include <GL/osmesa.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "DOMImplementationImp.h"
+#include "ECMAScript.h"
+#include "Trace.h"
+#include "WindowImp.h"
+#include "utf.h"
+#include "http/HTTPConnection.h"
+
+#include "Test.util.h"
+
+using namespace org::w3c::dom::bootstrap;
+using namespace org::w3c::dom;
+
+extern html::Window window;
+
+// There is no window to name. These replace Test.x11.cpp, which would refer
+// to GLX in libGL.
+void setWindowClass(const char* name, const char* cls)
+{
+}
+
+void setWindowTitle(const std::string& title)
+{
+}
+
+void setIcon(size_t n, size_t width, size_t height, uint32_t* image)
+{
+}
+
+namespace
+{
+
+bool hasExtension(const char* name)
+{
+    const char* extensions = reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS));
+    size_t length = strlen(name);
+    for (const char* p = extensions; p && (p = strstr(p, name)); p += length) {
+        if ((p == extensions || p[-1] == ' ') && (p[length] == ' ' || p[length] == '\0'))
+            return true;
+    }
+    return false;
+}
+
+// Loads the GLEW functions from OSMesa in place of glewInit(), which would
+// look them up in libGL through GLX.
+bool loadGLFunctions()
+{
+#define LOAD(name) (name = reinterpret_cast<decltype(name)>(OSMesaGetProcAddress(#name)))
+    // GLEW_ARB_framebuffer_object, etc. are read-only.
+    __GLEW_ARB_framebuffer_object = hasExtension("GL_ARB_framebuffer_object");
+    __GLEW_EXT_framebuffer_object = hasExtension("GL_EXT_framebuffer_object");
+    bool loaded = LOAD(glBlendFuncSeparate);
+    if (GLEW_ARB_framebuffer_object) {
+        loaded = LOAD(glGenFramebuffers) && LOAD(glBindFramebuffer) && LOAD(glDeleteFramebuffers) &&
+                 LOAD(glFramebufferTexture2D) && LOAD(glFramebufferRenderbuffer) &&
+                 LOAD(glGenRenderbuffers) && LOAD(glBindRenderbuffer) && LOAD(glDeleteRenderbuffers) &&
+                 LOAD(glRenderbufferStorage) && loaded;
+    } else if (GLEW_EXT_framebuffer_object) {
+        loaded = LOAD(glGenFramebuffersEXT) && LOAD(glBindFramebufferEXT) && LOAD(glDeleteFramebuffersEXT) &&
+                 LOAD(glFramebufferTexture2DEXT) && LOAD(glFramebufferRenderbufferEXT) &&
+                 LOAD(glGenRenderbuffersEXT) && LOAD(glBindRenderbufferEXT) && LOAD(glDeleteRenderbuffersEXT) &&
+                 LOAD(glRenderbufferStorageEXT) && loaded;
+    }
+#undef LOAD
+    return loaded;
+}
+
+bool writePng(const char* path, int width, int height)
+{
+    std::vector<unsigned char> pixels(width * height * 4);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+
+    FILE* file = fopen(path, "wb");
+    if (!file)
+        return false;
+    png_structp png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, 0, 0, 0);
+    png_infop info_ptr = png_ptr ? png_create_info_struct(png_ptr) : 0;
+    if (!info_ptr || setjmp(png_jmpbuf(png_ptr))) {
+        png_destroy_write_struct(&png_ptr, info_ptr ? &info_ptr : 0);
+        fclose(file);
+        return false;
+    }
+    png_init_io(png_ptr, file);
+    png_set_IHDR(png_ptr, info_ptr, width, height, 8, PNG_COLOR_TYPE_RGB_ALPHA,
+                 PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+    png_write_info(png_ptr, info_ptr);
+    // Note the rows read by glReadPixels() are bottom up.
+    for (int y = height - 1; 0 <= y; --y)
+        png_write_row(png_ptr, &pixels[y * width * 4]);
+    png_write_end(png_ptr, info_ptr);
+    png_destroy_write_struct(&png_ptr, &info_ptr);
+    fclose(file);
+    return true;
+}
+
+// Loads url into a new window, and returns the time taken until the page has
+// settled in milliseconds, or a negative value if it did not settle in time.
+double load(const std::u16string& url, int width, int height, unsigned timeout)
+{
+    typedef std::chrono::steady_clock Clock;
+
+    WindowImp* imp = new WindowImp(0, 0, WindowImp::TopLevel);
+    window = imp;
+    reshape(width, height);
+
+    auto start = Clock::now();
+    window.open(url, u"_self", u"", true);
+    while (!imp->isSettled()) {
+        if (std::chrono::seconds(timeout) < Clock::now() - start)
+            return -1.0;
+        HttpConnectionManager::getInstance().poll();
+        if (imp->poll())
+            renderWindow();
+        else
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    renderWindow();
+    glFinish();
+    return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count() / 1000.0;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    int width = 816;
+    int height = 1056;
+    unsigned repeat = 1;
+    unsigned timeout = 60;
+    const char* pngPath = 0;
+    for (int i = 1; i < argc;) {
+        if (strncmp(argv[i], "--size=", 7) == 0)
+            sscanf(argv[i] + 7, "%dx%d", &width, &height);
+        else if (strncmp(argv[i], "--repeat=", 9) == 0)
+            repeat = std::max(1, atoi(argv[i] + 9));
+        else if (strncmp(argv[i], "--timeout=", 10) == 0)
+            timeout = atoi(argv[i] + 10);
+        else if (strncmp(argv[i], "--png=", 6) == 0)
+            pngPath = argv[i] + 6;
+        else {
+            ++i;
+            continue;
+        }
+        for (int j = i; j < argc; ++j)
+            argv[j] = argv[j + 1];
+        --argc;
+    }
+
+    initLogLevel(&argc, argv, 0);
+    initFonts(&argc, argv);
+
+    if (argc < 3 || width <= 0 || height <= 0) {
+        std::cout << "usage : " << argv[0] << " [--size=WxH] [--repeat=N] [--timeout=sec] [--png=file.png] default.css [user.css] url\n";
+        return EXIT_FAILURE;
+    }
+
+    OSMesaContext context = OSMesaCreateContextExt(OSMESA_RGBA, 24, 8, 0, 0);
+    if (!context) {
+        std::cout << "error: failed to create an OSMesa context.\n";
+        return EXIT_FAILURE;
+    }
+    std::vector<unsigned char> buffer(width * height * 4);
+    if (!OSMesaMakeCurrent(context, buffer.data(), GL_UNSIGNED_BYTE, width, height)) {
+        std::cout << "error: failed to bind the OSMesa context.\n";
+        return EXIT_FAILURE;
+    }
+    if (!loadGLFunctions()) {
+        std::cout << "error: failed to load the GL functions from OSMesa.\n";
+        return EXIT_FAILURE;
+    }
+    initGLState();
+
+    // The phases are timed with the trace events; cf. --trace=path
+    if (!Trace::isEnabled())
+        Trace::enable("");
+
+    // Load the default CSS file
+    getDOMImplementation()->setDefaultStyleSheet(loadStyleSheet(argv[1]));
+
+    // Load the user CSS file
+    if (4 <= argc)
+        getDOMImplementation()->setUserStyleSheet(loadStyleSheet(argv[2]));
+
+    std::thread httpService(std::ref(HttpConnectionManager::getInstance()));
+
+    int result = EXIT_SUCCESS;
+    std::u16string url = utfconv(argv[argc - 1]);
+    double total = 0.0;
+    for (unsigned i = 0; i < repeat; ++i) {
+        uint64_t since = Trace::now();
+        double time = load(url, width, height, timeout);
+        if (time < 0.0) {
+            std::cout << "error: the page did not settle in " << timeout << " seconds.\n";
+            result = EXIT_FAILURE;
+            break;
+        }
+        total += time;
+        std::cout << "## run " << (i + 1) << ": " << time << " ms\n";
+        Trace::summarize(std::cout, since);
+    }
+    if (result == EXIT_SUCCESS) {
+        std::cout << "## average: " << (total / repeat) << " ms\n";
+        if (pngPath && !writePng(pngPath, width, height)) {
+            std::cout << "error: failed to write " << pngPath << ".\n";
+            result = EXIT_FAILURE;
+        }
+    }
+
+    window = 0;
+
+    ECMAScriptContext::shutDown();
+
+    HttpConnectionManager::getInstance().stop();
+    httpService.join();
+
+    OSMesaDestroyContext(context);
+    return result;
+}
@@ -207,6 +207,17 @@ bool MediaListImp::matches(WindowImp* window)
         return false;
     if (mediaQueries.empty())
         return true;
+    uint64_t generation = window->getMediaGeneration();
+    uint64_t cached = cachedResult.load(std::memory_order_acquire);
+    if ((cached >> 1) == generation)
+        return cached & 1;
+    bool result = evaluate(window);
+    cachedResult.store((generation << 1) | result, std::memory_order_release);
+    return result;
+}
+
+bool MediaListImp::evaluate(WindowImp* window)
+{
     for (auto i = mediaQueries.begin(); i != mediaQueries.end(); ++i) {
         bool result = false;
         if (i->type & MediaListImp::Screen) {   // TODO: Support other medium
@@ -449,6 +460,7 @@ void MediaListImp::appendMedium(unsigned media)
     }
     if (!contains(mediaQuery))
         mediaQueries.push_back(std::move(mediaQuery));
+    cachedResult = 0;
 }
 
 void MediaListImp::appendFeature(int feature, CSSParserExpr* expr)
@@ -539,6 +551,7 @@ void MediaListImp::appendMedium(const std::u16string& medium)
         if (!contains(*i))
             mediaQueries.push_back(std::move(*i));
     }
+    cachedResult = 0;
 }
 
 void MediaListImp::deleteMedium(const std::u16string& medium)
@@ -552,6 +565,7 @@ void MediaListImp::deleteMedium(const std::u16string& medium)
         if (found != mediaQueries.end())
             mediaQueries.erase(found);
     }
+    cachedResult = 0;
 }
 
 }  // org::w3c::dom::bootstrap
@@ -23,6 +23,8 @@
 
 #include <org/w3c/dom/stylesheets/MediaList.h>
 
+#include <atomic>
+#include <cstdint>
 #include <list>
 
 namespace org { namespace w3c { namespace dom { namespace bootstrap {
@@ -140,21 +142,34 @@ private:
 
     std::list<MediaQuery> mediaQueries;
 
+    // The result of the last evaluation in the lowest bit and its media
+    // generation in the upper bits, which is valid while the generation of
+    // the window stays the same. 0 is not a valid generation. The cache is
+    // packed into a single atomic word since the style sheets are matched
+    // on the worker threads as well as on the main thread.
+    std::atomic<uint64_t> cachedResult;
+
+    bool evaluate(WindowImp* window);
+
 public:
-    MediaListImp()
+    MediaListImp() :
+        cachedResult(0)
     {}
     MediaListImp(MediaListImp&& other) :
-        mediaQueries(std::move(other.mediaQueries))
+        mediaQueries(std::move(other.mediaQueries)),
+        cachedResult(0)
     {}
 
     MediaListImp& operator=(MediaListImp&& other) {
         mediaFeatures.clear();
         mediaQueries = std::move(other.mediaQueries);
+        cachedResult = 0;
         return *this;
     }
 
     void clear() {
         mediaQueries.clear();
+        cachedResult = 0;
     }
     bool matches(WindowImp* window);
 
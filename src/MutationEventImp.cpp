@@ -16,6 +16,8 @@
 
 #include "MutationEventImp.h"
 
+#include "ElementImp.h"
+
 namespace org
 {
 namespace w3c
@@ -35,6 +37,24 @@ void MutationEventImp::initMutationEvent(const std::u16string& typeArg, bool can
     initEvent(typeArg, canBubbleArg, cancelableArg);
 }
 
+void MutationEventImp::initAttrModifiedEvent(Element element, const std::u16string& namespaceURI, const std::u16string& localName, const std::u16string& prevValueArg, const std::u16string& newValueArg, const std::u16string& attrNameArg, unsigned short attrChangeArg)
+{
+    initMutationEvent(u"DOMAttrModified", true, false, 0, prevValueArg, newValueArg, attrNameArg, attrChangeArg);
+    attrElement = element;
+    attrNamespaceURI = namespaceURI;
+    attrLocalName = localName;
+}
+
+Object MutationEventImp::getRelatedNode()
+{
+    if (!relatedNode && attrElement) {
+        if (ElementImp* element = dynamic_cast<ElementImp*>(attrElement.self()))
+            relatedNode = element->getAttributeNodeImp(attrNamespaceURI, attrLocalName);
+        attrElement = 0;
+    }
+    return relatedNode;
+}
+
 }
 }
 }
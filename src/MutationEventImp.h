@@ -25,6 +25,7 @@
 #include "EventImp.h"
 
 #include <org/w3c/dom/events/Event.h>
+#include <org/w3c/dom/Element.h>
 #include <org/w3c/dom/Node.h>
 
 namespace org
@@ -42,17 +43,22 @@ class MutationEventImp : public ObjectMixin<MutationEventImp, EventImp>
     std::u16string newValue;
     std::u16string attrName;
     unsigned short attrChange;
+
+    // For DOMAttrModified, the Attr node is created from these when it is requested.
+    Element        attrElement;
+    std::u16string attrNamespaceURI;
+    std::u16string attrLocalName;
+
 public:
     MutationEventImp() :
         relatedNode(0),
-        attrChange(0)
+        attrChange(0),
+        attrElement(0)
     {
     }
 
     // MutationEvent
-    Object getRelatedNode() {
-        return relatedNode;
-    }
+    Object getRelatedNode();
     std::u16string getPrevValue() {
         return prevValue;
     }
@@ -66,6 +72,7 @@ public:
         return attrChange;
     }
     void initMutationEvent(const std::u16string& typeArg, bool canBubbleArg, bool cancelableArg, Object relatedNodeArg, const std::u16string& prevValueArg, const std::u16string& newValueArg, const std::u16string& attrNameArg, unsigned short attrChangeArg);
+    void initAttrModifiedEvent(Element element, const std::u16string& namespaceURI, const std::u16string& localName, const std::u16string& prevValueArg, const std::u16string& newValueArg, const std::u16string& attrNameArg, unsigned short attrChangeArg);
     // Object
     virtual Any message_(uint32_t selector, const char* id, int argc, Any* argv)
     {
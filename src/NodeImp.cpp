@@ -28,6 +28,8 @@ namespace org { namespace w3c { namespace dom { namespace bootstrap {
 
 NodeImp* NodeImp::removeChild(NodeImp* item)
 {
+    if (item->ownerDocument)
+        item->ownerDocument->elementRemoved(this, item);
     NodeImp* next = item->nextSibling;
     NodeImp* prev = item->previousSibling;
     if (!next)
@@ -54,6 +56,8 @@ NodeImp* NodeImp::insertBefore(NodeImp* item, NodeImp* after)
         item->previousSibling->nextSibling = item;
     item->parentNode = this;
     ++childCount;
+    if (item->ownerDocument)
+        item->ownerDocument->elementInserted(this, item);
     return item;
 }
 
@@ -69,6 +73,8 @@ NodeImp* NodeImp::appendChild(NodeImp* item)
     lastChild = item;
     item->parentNode = this;
     ++childCount;
+    if (item->ownerDocument)
+        item->ownerDocument->elementInserted(this, item);
     return item;
 }
 
@@ -31,6 +31,7 @@
 #include <org/w3c/dom/NodeList.h>
 
 #include "EventTargetImp.h"
+#include "SlabAllocator.h"
 
 #include <list>
 
@@ -41,6 +42,7 @@ class DocumentImp;
 class NodeImp : public ObjectMixin<NodeImp, EventTargetImp>
 {
     friend class NodeListImp;
+    friend class DocumentImp;   // for the element indexes
     friend class ElementImp;
     friend class EventTargetImp;
     friend class HTMLElementImp;  // for focus
@@ -65,6 +67,8 @@ public:
     NodeImp(NodeImp* org, bool deep);
     ~NodeImp();
 
+    ES_SLAB_ALLOCATED(SlabAllocator::getNodeAllocator())
+
     // Returns true if this is an ancestor of the node
     bool isAncestorOf(NodeImp* node) {
         for (NodeImp* parent = node->parentNode; parent; parent = parent->parentNode) {
@@ -34,14 +34,66 @@ using namespace org::w3c::dom;
 
 extern html::Window window;
 
+namespace
+{
+
+// In the --serve mode, the test URLs are read from the standard input one per
+// line. Each test is run in a new window, and "## done" is written out once
+// the page has settled so that the harness can send the next URL.
+void serve(int value)
+{
+    static bool settled = false;
+
+    WindowImp* imp = static_cast<WindowImp*>(window.self());
+    if (imp && imp->isSettled()) {
+        if (!settled) {
+            // Let the page be rendered and dumped once more before moving on.
+            settled = true;
+            glutPostRedisplay();
+        } else {
+            std::cout << "## done\n";
+            std::cout.flush();
+            imp = 0;
+        }
+    } else
+        settled = false;
+    if (!imp) {
+        std::string url;
+        if (!std::getline(std::cin, url)) {
+            glutLeaveMainLoop();
+            return;
+        }
+        settled = false;
+        imp = new WindowImp(0, 0, WindowImp::TopLevel);
+        window = imp;
+        imp->setSize(glutGet(GLUT_WINDOW_WIDTH), glutGet(GLUT_WINDOW_HEIGHT));
+        window.open(utfconv(url), u"_self", u"", true);
+    }
+    glutTimerFunc(50, serve, 0);
+}
+
+}
+
 int main(int argc, char* argv[])
 {
 #ifdef USE_V8
     v8::HandleScope handleScope;
 #endif  // USE_V8
 
-    if (argc < 3) {
+    bool serving = false;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--serve") == 0) {
+            serving = true;
+            for (int j = i; j < argc; ++j)
+                argv[j] = argv[j + 1];
+            --argc;
+            break;
+        }
+    }
+
+    if (argc < (serving ? 2 : 3)) {
         std::cout << "usage : " << argv[0] << " default.css [user.css] url\n";
+        std::cout << "        " << argv[0] << " default.css [user.css] --serve\n";
         return EXIT_FAILURE;
     }
 
@@ -66,13 +118,17 @@ int main(int argc, char* argv[])
     getDOMImplementation()->setDefaultStyleSheet(loadStyleSheet(argv[1]));
 
     // Load the user CSS file
-    if (4 <= argc)
+    if ((serving ? 3 : 4) <= argc)
         getDOMImplementation()->setUserStyleSheet(loadStyleSheet(argv[2]));
 
     std::thread httpService(std::ref(HttpConnectionManager::getInstance()));
 
-    window = new WindowImp(0, 0, WindowImp::TopLevel);
-    window.open(utfconv(argv[argc - 1]), u"_self", u"", true);
+    if (serving)
+        glutTimerFunc(50, serve, 0);
+    else {
+        window = new WindowImp(0, 0, WindowImp::TopLevel);
+        window.open(utfconv(argv[argc - 1]), u"_self", u"", true);
+    }
 
     glutMainLoop();
 
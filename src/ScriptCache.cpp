@@ -0,0 +1,169 @@
+/*
+ * Copyright 2013 Esrille Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ScriptCache.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <sstream>
+
+#include "utf.h"
+
+namespace
+{
+
+const char* Signature = "Escudo script cache 1";
+
+std::mutex evictionMutex;
+int64_t totalSize = -1;  // of the entries; -1 until the directory is scanned
+
+std::string getHeader(const std::string& engine, const std::u16string& url, uint64_t sourceHash, size_t sourceLength)
+{
+    std::ostringstream header;
+    header << Signature << '\n' << engine << '\n' << utfconv(url) << '\n' <<
+        std::hex << sourceHash << ' ' << std::dec << sourceLength << '\n';
+    return header.str();
+}
+
+}
+
+std::string ScriptCache::cachePath;
+
+// FNV-1a
+uint64_t ScriptCache::hash(const std::u16string& s, uint64_t h)
+{
+    for (auto i = s.begin(); i != s.end(); ++i) {
+        h ^= static_cast<uint64_t>(*i);
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+std::string ScriptCache::getFilePath(const std::u16string& url, uint64_t sourceHash)
+{
+    char name[24];
+    sprintf(name, "/%016llx", static_cast<unsigned long long>(hash(url, sourceHash)));
+    return cachePath + name;
+}
+
+bool ScriptCache::read(const std::string& engine, const std::u16string& url, const std::u16string& source, std::vector<char>& data)
+{
+    if (!isCacheable(source))
+        return false;
+    uint64_t sourceHash = hash(source);
+    std::string path = getFilePath(url, sourceHash);
+    std::ifstream stream(path.c_str(), std::ios::in | std::ios::binary);
+    if (!stream)
+        return false;
+    std::string header = getHeader(engine, url, sourceHash, source.length());
+    std::string stored(header.length(), '\0');
+    if (!stream.read(&stored[0], stored.length()) || stored != header)
+        return false;
+    data.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+    if (data.empty())
+        return false;
+    utime(path.c_str(), 0);  // Mark the entry as recently used for evict().
+    return true;
+}
+
+void ScriptCache::write(const std::string& engine, const std::u16string& url, const std::u16string& source, const void* data, size_t length)
+{
+    if (!isCacheable(source) || !data || !length)
+        return;
+    uint64_t sourceHash = hash(source);
+    std::string path = getFilePath(url, sourceHash);
+    // Concurrent writers of the same entry each write their own temporary file.
+    std::string tmp = path + ".tmpXXXXXX";
+    int fd = mkstemp(&tmp[0]);
+    if (fd == -1)
+        return;
+    FILE* file = fdopen(fd, "wb");
+    if (!file) {
+        close(fd);
+        remove(tmp.c_str());
+        return;
+    }
+    std::string header = getHeader(engine, url, sourceHash, source.length());
+    bool written = fwrite(header.data(), 1, header.length(), file) == header.length() &&
+                   fwrite(data, 1, length, file) == length;
+    if (fclose(file) != 0)
+        written = false;
+    struct stat st;
+    int64_t size = header.length() + length;
+    if (stat(path.c_str(), &st) == 0)
+        size -= st.st_size;     // replacing the entry
+    if (!written || rename(tmp.c_str(), path.c_str()) == -1) {
+        remove(tmp.c_str());
+        return;
+    }
+
+    // Keep track of the total size so that the directory is scanned only
+    // when it exceeds MaxSize.
+    std::lock_guard<std::mutex> lock(evictionMutex);
+    if (totalSize < 0 || static_cast<int64_t>(MaxSize) < totalSize + size)
+        totalSize = evict();
+    else
+        totalSize += size;
+}
+
+// Removes the least recently used entries once the cache exceeds MaxSize,
+// down to 3/4 of MaxSize so that the eviction is not repeated at every write.
+// Returns the total size of the remaining entries. Called with evictionMutex
+// locked.
+uint64_t ScriptCache::evict()
+{
+    struct Entry
+    {
+        uint64_t used;  // in nanoseconds
+        off_t size;
+        std::string path;
+    };
+
+    DIR* dir = opendir(cachePath.c_str());
+    if (!dir)
+        return 0;
+    std::vector<Entry> entries;
+    uint64_t total = 0;
+    while (struct dirent* entry = readdir(dir)) {
+        if (entry->d_name[0] == '.' || strstr(entry->d_name, ".tmp"))
+            continue;
+        std::string path = cachePath + '/' + entry->d_name;
+        struct stat st;
+        if (stat(path.c_str(), &st) == -1 || !S_ISREG(st.st_mode))
+            continue;
+        entries.push_back({ st.st_mtim.tv_sec * 1000000000ull + st.st_mtim.tv_nsec, st.st_size, path });
+        total += st.st_size;
+    }
+    closedir(dir);
+    if (total <= MaxSize)
+        return total;
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.used < b.used; });
+    for (auto i = entries.begin(); i != entries.end() && MaxSize / 4 * 3 < total; ++i) {
+        if (remove(i->path.c_str()) == 0)
+            total -= i->size;
+    }
+    return total;
+}
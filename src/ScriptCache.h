@@ -0,0 +1,57 @@
+/*
+ * Copyright 2013 Esrille Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ES_SCRIPT_CACHE_H_INCLUDED
+#define ES_SCRIPT_CACHE_H_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// ScriptCache keeps the compiled form of scripts in the profile directory so
+// that the same scripts are not compiled again at every launch. An entry is
+// keyed by the URL of the script and the hash of its source text, and it is
+// tagged with the engine version that produced it. Once the entries exceed
+// MaxSize in total, the least recently used ones are removed. The entries can
+// be written from the worker threads.
+class ScriptCache
+{
+    static std::string cachePath;
+
+    static uint64_t hash(const std::u16string& s, uint64_t h = 14695981039346656037ull);
+    static std::string getFilePath(const std::u16string& url, uint64_t sourceHash);
+    static uint64_t evict();
+
+public:
+    // Scripts shorter than this are compiled faster than they are read back.
+    static const size_t MinLength = 1024;
+    static const size_t MaxSize = 32 * 1024 * 1024;
+
+    static void setCachePath(const std::string& path) {
+        cachePath = path;
+    }
+
+    static bool isCacheable(const std::u16string& source) {
+        return !cachePath.empty() && MinLength <= source.length();
+    }
+
+    // Reads the data cached by engine for source at url into data.
+    static bool read(const std::string& engine, const std::u16string& url, const std::u16string& source, std::vector<char>& data);
+    static void write(const std::string& engine, const std::u16string& url, const std::u16string& source, const void* data, size_t length);
+};
+
+#endif  // ES_SCRIPT_CACHE_H_INCLUDED
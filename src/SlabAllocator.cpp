@@ -0,0 +1,227 @@
+/*
+ * Copyright 2013 Esrille Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SlabAllocator.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+
+const unsigned MaxAllocators = 4;
+
+std::atomic_uint allocatorCount(0);
+__thread SlabAllocator::Statistics threadStatistics[MaxAllocators];
+
+pthread_key_t threadCacheKey;
+pthread_once_t threadCacheKeyOnce = PTHREAD_ONCE_INIT;
+
+}
+
+struct SlabAllocator::ThreadCache
+{
+    SlabAllocator* allocator;
+    FreeBlock* freeLists[SizeClasses];
+    size_t counts[SizeClasses];
+};
+
+SlabAllocator::SlabAllocator(const char* name) :
+    name(name),
+    current(0),
+    remaining(0),
+    liveBytes(0),
+    id(allocatorCount++)
+{
+    assert(id < MaxAllocators);
+    std::memset(freeLists, 0, sizeof freeLists);
+}
+
+void SlabAllocator::releaseThreadCaches(void* p)
+{
+    ThreadCache* caches = static_cast<ThreadCache*>(p);
+    for (unsigned i = 0; i < MaxAllocators; ++i) {
+        ThreadCache& cache(caches[i]);
+        if (!cache.allocator)
+            continue;
+        for (size_t c = 0; c < SizeClasses; ++c) {
+            FreeBlock* head = cache.freeLists[c];
+            if (!head)
+                continue;
+            FreeBlock* tail = head;
+            while (tail->next)
+                tail = tail->next;
+            cache.allocator->release(c, head, tail, cache.counts[c]);
+            cache.freeLists[c] = 0;
+            cache.counts[c] = 0;
+        }
+    }
+}
+
+SlabAllocator::ThreadCache& SlabAllocator::getThreadCache() noexcept
+{
+    static __thread ThreadCache caches[MaxAllocators];
+    ThreadCache& cache(caches[id]);
+    if (!cache.allocator) {
+        cache.allocator = this;
+        // Return the cached blocks to the shared free lists at thread exit.
+        static __thread bool registered;
+        if (!registered) {
+            registered = true;
+            pthread_once(&threadCacheKeyOnce, [] { pthread_key_create(&threadCacheKey, releaseThreadCaches); });
+            pthread_setspecific(threadCacheKey, caches);
+        }
+    }
+    return cache;
+}
+
+SlabAllocator::FreeBlock* SlabAllocator::refill(size_t sizeClass, size_t& count) noexcept
+{
+    size_t blockSize = (sizeClass + 1) * Granularity;
+    FreeBlock* head = 0;
+    size_t n = 0;
+    std::lock_guard<std::mutex> lock(mutex);
+    for (; n < count && freeLists[sizeClass]; ++n) {
+        FreeBlock* block = freeLists[sizeClass];
+        freeLists[sizeClass] = block->next;
+        block->next = head;
+        head = block;
+    }
+    for (; n < count; ++n) {
+        if (remaining < blockSize) {
+            // Hand out the rest of the current chunk to the free lists first.
+            while (Granularity <= remaining) {
+                size_t c = getSizeClass(remaining < MaxSize ? remaining - remaining % Granularity : MaxSize);
+                size_t s = (c + 1) * Granularity;
+                FreeBlock* block = reinterpret_cast<FreeBlock*>(current);
+                block->next = freeLists[c];
+                freeLists[c] = block;
+                current += s;
+                remaining -= s;
+            }
+            current = static_cast<char*>(std::malloc(ChunkSize));
+            if (!current) {
+                remaining = 0;
+                break;
+            }
+            chunks.push_back(current);
+            remaining = ChunkSize;
+        }
+        FreeBlock* block = reinterpret_cast<FreeBlock*>(current);
+        current += blockSize;
+        remaining -= blockSize;
+        block->next = head;
+        head = block;
+    }
+    liveBytes += n * blockSize;
+    count = n;
+    return head;
+}
+
+void SlabAllocator::release(size_t sizeClass, FreeBlock* head, FreeBlock* tail, size_t count) noexcept
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    tail->next = freeLists[sizeClass];
+    freeLists[sizeClass] = head;
+    liveBytes -= count * (sizeClass + 1) * Granularity;
+}
+
+void* SlabAllocator::allocate(size_t size) noexcept
+{
+    if (size == 0)
+        size = 1;
+    threadStatistics[id].count++;
+    threadStatistics[id].bytes += size;
+    if (MaxSize < size)
+        return ::operator new(size, std::nothrow);
+
+    size_t sizeClass = getSizeClass(size);
+    ThreadCache& cache(getThreadCache());
+    FreeBlock* block = cache.freeLists[sizeClass];
+    if (!block) {
+        size_t count = getBatchSize(sizeClass);
+        block = refill(sizeClass, count);
+        if (!block)
+            return 0;
+        cache.counts[sizeClass] = count;
+    }
+    cache.freeLists[sizeClass] = block->next;
+    --cache.counts[sizeClass];
+    return block;
+}
+
+void SlabAllocator::deallocate(void* p, size_t size) noexcept
+{
+    if (!p)
+        return;
+    if (size == 0)
+        size = 1;
+    if (MaxSize < size) {
+        ::operator delete(p);
+        return;
+    }
+    size_t sizeClass = getSizeClass(size);
+    ThreadCache& cache(getThreadCache());
+    FreeBlock* block = static_cast<FreeBlock*>(p);
+    block->next = cache.freeLists[sizeClass];
+    cache.freeLists[sizeClass] = block;
+    size_t batch = getBatchSize(sizeClass);
+    if (2 * batch < ++cache.counts[sizeClass]) {
+        // Return a batch to the shared free lists so that the blocks freed by
+        // a thread can be reused by the other threads.
+        FreeBlock* tail = block;
+        for (size_t i = 1; i < batch; ++i)
+            tail = tail->next;
+        cache.freeLists[sizeClass] = tail->next;
+        cache.counts[sizeClass] -= batch;
+        release(sizeClass, block, tail, batch);
+    }
+}
+
+size_t SlabAllocator::getLiveBytes()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return liveBytes;
+}
+
+SlabAllocator::Statistics SlabAllocator::getStatistics() const
+{
+    return threadStatistics[id];
+}
+
+// Note the allocators are never destructed since objects allocated from them
+// can be released while the program exits.
+
+SlabAllocator& SlabAllocator::getNodeAllocator()
+{
+    static SlabAllocator* allocator = new SlabAllocator("node");
+    return *allocator;
+}
+
+SlabAllocator& SlabAllocator::getBoxAllocator()
+{
+    static SlabAllocator* allocator = new SlabAllocator("box");
+    return *allocator;
+}
+
+SlabAllocator& SlabAllocator::getRuleAllocator()
+{
+    static SlabAllocator* allocator = new SlabAllocator("rule");
+    return *allocator;
+}
@@ -0,0 +1,113 @@
+/*
+ * Copyright 2013 Esrille Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ES_SLAB_ALLOCATOR_H_INCLUDED
+#define ES_SLAB_ALLOCATOR_H_INCLUDED
+
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <new>
+
+// SlabAllocator carves small objects of the same size class out of large
+// chunks and recycles them through per-size-class free lists. Each thread
+// keeps its own free lists so that allocating and freeing objects usually
+// takes no lock; blocks are moved between the thread's free lists and the
+// shared ones in batches. Objects larger than MaxSize are passed through to
+// the global operator new.
+class SlabAllocator
+{
+public:
+    static const size_t Granularity = 16;
+    static const size_t MaxSize = 1024;
+    static const size_t ChunkSize = 64 * 1024;
+
+    // Allocation statistics of the current thread
+    struct Statistics
+    {
+        unsigned long count;    // # of allocations
+        unsigned long bytes;    // # of bytes allocated
+
+        Statistics operator-(const Statistics& other) const {
+            return Statistics{ count - other.count, bytes - other.bytes };
+        }
+    };
+
+private:
+    static const size_t SizeClasses = MaxSize / Granularity;
+
+    struct FreeBlock
+    {
+        FreeBlock* next;
+    };
+    struct ThreadCache;
+
+    const char* name;
+    std::mutex mutex;   // for the shared free lists and the chunks
+    FreeBlock* freeLists[SizeClasses];
+    std::deque<char*> chunks;
+    char* current;
+    size_t remaining;
+    size_t liveBytes;   // including the blocks in the free lists of the threads
+    unsigned id;
+
+    static size_t getSizeClass(size_t size) {
+        return (size + Granularity - 1) / Granularity - 1;
+    }
+    // Returns the number of blocks moved between the free lists at once.
+    static size_t getBatchSize(size_t sizeClass) {
+        size_t count = 8192 / ((sizeClass + 1) * Granularity);
+        return (count < 4) ? 4 : count;
+    }
+
+    ThreadCache& getThreadCache() noexcept;
+    FreeBlock* refill(size_t sizeClass, size_t& count) noexcept;
+    void release(size_t sizeClass, FreeBlock* head, FreeBlock* tail, size_t count) noexcept;
+    static void releaseThreadCaches(void* caches);
+
+public:
+    SlabAllocator(const char* name);
+
+    void* allocate(size_t size) noexcept;
+    void deallocate(void* p, size_t size) noexcept;
+
+    const char* getName() const {
+        return name;
+    }
+    size_t getLiveBytes();
+    Statistics getStatistics() const;
+
+    // Allocators for the DOM nodes, for the CSS boxes, and for the matched rules
+    static SlabAllocator& getNodeAllocator();
+    static SlabAllocator& getBoxAllocator();
+    static SlabAllocator& getRuleAllocator();
+};
+
+// Declares class-specific allocation functions that use the specified SlabAllocator.
+#define ES_SLAB_ALLOCATED(allocator) \
+    static void* operator new(size_t size) { \
+        if (void* p = allocator.allocate(size)) \
+            return p; \
+        throw std::bad_alloc(); \
+    } \
+    static void* operator new(size_t size, const std::nothrow_t&) noexcept { \
+        return allocator.allocate(size); \
+    } \
+    static void operator delete(void* p, size_t size) noexcept { \
+        allocator.deallocate(p, size); \
+    }
+
+#endif  // ES_SLAB_ALLOCATOR_H_INCLUDED
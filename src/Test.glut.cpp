@@ -73,7 +73,7 @@ void reshape(int w, int h)
         imp->setSize(w, h);
 }
 
-void display()
+void renderWindow()
 {
     glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
@@ -94,7 +94,11 @@ void display()
     }
 
     deleteTextures();
+}
 
+void display()
+{
+    renderWindow();
     glutSwapBuffers();  // This would block until the sync happens
 }
 
@@ -239,8 +243,6 @@ void timer(int value)
 
 void init(int* argc, char* argv[], int width, int height)
 {
-    threadFlags = MainThread;
-
     glutInit(argc, argv);
     glutInitDisplayMode(GLUT_RGB | GLUT_DOUBLE | GLUT_DEPTH | GLUT_STENCIL);
     if (width <= 0 || height <= 0) {
@@ -252,18 +254,40 @@ void init(int* argc, char* argv[], int width, int height)
     glutInitWindowSize(width, height);
     glutCreateWindow(argv[0]);
 
+    initGL();
+
+    glutReshapeFunc(reshape);
+    glutDisplayFunc(display);
+    glutKeyboardFunc(keyboard);
+    glutKeyboardUpFunc(keyboardUp);
+    glutSpecialFunc(special);
+    glutSpecialUpFunc(specialUp);
+    glutMouseFunc(mouse);
+    glutMotionFunc(mouseMove);
+    glutPassiveMotionFunc(mouseMove);
+    glutEntryFunc(entry);
+    glutTimerFunc(50, timer, 0);
+    glutSetOption(GLUT_ACTION_ON_WINDOW_CLOSE, GLUT_ACTION_CONTINUE_EXECUTION);
+}
+
+void initGL()
+{
     GLenum err = glewInit();
     if (err != GLEW_OK) {
         std::cout << "error: " << glewGetErrorString(err) << "\n";
         exit(EXIT_FAILURE);
     }
+    initGLState();
+}
+
+void initGLState()
+{
+    threadFlags = MainThread;
 
     if (!GLEW_EXT_framebuffer_object && !GLEW_ARB_framebuffer_object) {
         std::cout << "error: Neither EXT_framebuffer_object nor ARB_framebuffer_object extension is supported by the installed OpenGL driver.\n";
         exit(EXIT_FAILURE);
     }
-    glutReshapeFunc(reshape);
-    glutDisplayFunc(display);
     glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
     glEnable(GL_TEXTURE_2D);
     glDepthFunc(GL_LEQUAL);
@@ -273,16 +297,6 @@ void init(int* argc, char* argv[], int width, int height)
     glEnable(GL_BLEND);
     glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-    glutKeyboardFunc(keyboard);
-    glutKeyboardUpFunc(keyboardUp);
-    glutSpecialFunc(special);
-    glutSpecialUpFunc(specialUp);
-    glutMouseFunc(mouse);
-    glutMotionFunc(mouseMove);
-    glutPassiveMotionFunc(mouseMove);
-    glutEntryFunc(entry);
-    glutTimerFunc(50, timer, 0);
-    glutSetOption(GLUT_ACTION_ON_WINDOW_CLOSE, GLUT_ACTION_CONTINUE_EXECUTION);
 
     glClearStencil(0x00);
     glEnable(GL_STENCIL_TEST);
@@ -37,8 +37,10 @@
 #include "css/Box.h"
 #include "css/CSSInputStream.h"
 #include "css/CSSParser.h"
+#include "css/CSSSnapshot.h"
 #include "css/CSSStyleSheetImp.h"
 #include "font/FontManager.h"
+#include "Trace.h"
 #include "utf.h"
 
 using namespace org::w3c::dom::bootstrap;
@@ -150,6 +152,37 @@ css::CSSStyleSheet loadStyleSheet(const char* path)
     return sheet;
 }
 
+css::CSSStyleSheet loadStyleSheet(const char* path, const char* snapshotPath)
+{
+    char url[PATH_MAX + 7];
+    strcpy(url, "file://");
+    realpath(path, url + 7);
+    css::CSSStyleSheet sheet = CSSSnapshotReader::read(snapshotPath, path);
+    if (sheet) {
+        if (auto imp = dynamic_cast<CSSStyleSheetImp*>(sheet.self()))
+            imp->setHref(toString(url));
+        recordTime("%s: loaded from the snapshot", path);
+        return sheet;
+    }
+    std::ifstream stream(path);
+    if (!stream) {
+        std::cerr << "error: cannot open " << path << ".\n";
+        return 0;
+    }
+    CSSParser parser;
+    CSSSnapshotWriter writer;
+    parser.setSnapshotWriter(&writer);
+    CSSInputStream cssStream(stream, "utf-8");
+    sheet = parser.parse(0, cssStream);
+    if (auto imp = dynamic_cast<CSSStyleSheetImp*>(sheet.self())) {
+        imp->setHref(toString(url));
+        recordTime("%s: parsed", path);
+        if (writer.write(snapshotPath, path, imp))
+            recordTime("%s: snapshot written", path);
+    }
+    return sheet;
+}
+
 Document loadDocument(std::istream& stream)
 {
     HTMLInputStream htmlInputStream(stream, "utf-8");
@@ -166,6 +199,35 @@ Document loadDocument(const char* html)
     return loadDocument(stream);
 }
 
+std::string createHitTestPage()
+{
+    std::string html = "<html><body style='margin: 0'>";
+    for (int i = 0; i < 100; ++i) {
+        html += "<div>";
+        for (int j = 0; j < 100; ++j)
+            html += "<div style='float: left; width: 7px; height: 5px; margin: 1px'></div>";
+        html += "<div style='clear: both'></div></div>";
+    }
+    html += "</body></html>";
+    return html;
+}
+
+Box* linearBoxFromPoint(Box* box, int x, int y)
+{
+    if (!box->isAnonymous() && Element::hasInstance(box->getNode())) {
+        Element element = interface_cast<Element>(box->getNode());
+        x += element.getScrollLeft();
+        y += element.getScrollTop();
+    }
+    for (Box* child = box->getFirstChild(); child; child = child->getNextSibling()) {
+        if (Box* target = linearBoxFromPoint(child, x, y)) {
+            if (!box->isClipped() || box->isInside(x, y))
+                return target;
+        }
+    }
+    return box->isInside(x, y) ? box : 0;
+}
+
 unsigned recordTime(const char* msg, ...)
 {
     typedef std::chrono::high_resolution_clock Clock;
@@ -200,18 +262,25 @@ unsigned getTick()
     return std::chrono::duration_cast<Ticks>(duration).count();
 }
 
+// Processes --v=level and --trace=path; with --trace, the trace events are
+// written to path at exit. cf. Trace.h
 void initLogLevel(int* argc, char* argv[], int defaultLevel)
 {
     logLevel = defaultLevel;
-    for (int i = 1; i < *argc; ++i) {
+    for (int i = 1; i < *argc;) {
         if (strncmp(argv[i], "--v", 3) == 0) {
             if (argv[i][3] == '=')
                 logLevel = atoi(argv[i] + 4);
-            for (; i < *argc; ++i)
-                argv[i] = argv[i + 1];
-            --*argc;
-            break;
+        } else if (strncmp(argv[i], "--trace=", 8) == 0) {
+            Trace::enable(argv[i] + 8);
+            Trace::setThreadName("main");
+        } else {
+            ++i;
+            continue;
         }
+        for (int j = i; j < *argc; ++j)
+            argv[j] = argv[j + 1];
+        --*argc;
     }
 }
 
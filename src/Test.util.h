@@ -38,10 +38,19 @@ void printComputedValues(org::w3c::dom::Node node, org::w3c::dom::bootstrap::Vie
 
 org::w3c::dom::css::CSSStyleSheet loadStyleSheet(std::istream& stream);
 org::w3c::dom::css::CSSStyleSheet loadStyleSheet(const char* path);
+// Loads the style sheet from its snapshot at snapshotPath if it is up to date,
+// and otherwise parses the style sheet and writes out a new snapshot. Returns
+// 0 if the style sheet cannot be opened; this can be called on any thread.
+org::w3c::dom::css::CSSStyleSheet loadStyleSheet(const char* path, const char* snapshotPath);
 
 org::w3c::dom::Document loadDocument(std::istream& stream);
 org::w3c::dom::Document loadDocument(const char* html);
 
+// Returns a page having 10k boxes for testing and timing boxFromPoint().
+std::string createHitTestPage();
+// The hit test without the hit bounds, for verifying and timing boxFromPoint().
+org::w3c::dom::bootstrap::Box* linearBoxFromPoint(org::w3c::dom::bootstrap::Box* box, int x, int y);
+
 unsigned recordTime(const char* msg, ...);
 unsigned getTick();
 
@@ -62,6 +71,13 @@ std::string getFileURL(const std::string& path);
 // Test.glut.cpp
 //
 void init(int* argc, char* argv[], int width = -1, int height = -1);
+// initGL(), reshape() and renderWindow() are the parts of init() and the
+// GLUT callbacks that can be used with any current GL context. initGLState()
+// is initGL() for the GLEW functions loaded by the caller.
+void initGL();
+void initGLState();
+void reshape(int w, int h);
+void renderWindow();
 bool isMainThread();
 void deleteTexture(unsigned texture);
 
@@ -76,5 +92,9 @@ void setIcon(size_t n, size_t width, size_t height, uint32_t* image);
 // ViewCSSImpGL.cpp
 //
 void initFonts(int* argc, char* argv[]);
+// initFonts() split into the command line processing and the actual loading
+// so that fonts can be loaded on a separate thread.
+bool removeTestFontsOption(int* argc, char* argv[]);
+void loadFonts(bool testFonts);
 
 #endif  // TEST_UTIL_H
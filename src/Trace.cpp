@@ -0,0 +1,304 @@
+/*
+ * Copyright 2013 Esrille Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "utf.h"
+
+// The events of a thread are kept in a list of chunks. Only the owner thread
+// appends events, and it publishes each event by incrementing the count of the
+// chunk so that flush() can read the events recorded so far at any time.
+struct Trace::Buffer
+{
+    static const size_t ChunkSize = 1024;
+
+    struct Chunk
+    {
+        Event events[ChunkSize];
+        std::atomic<size_t> count;
+        std::atomic<Chunk*> next;
+        Chunk() : count(0), next(0) {}
+    };
+
+    unsigned tid;
+    std::string name;   // guarded by nameMutex
+    Chunk head;
+    Chunk* tail;
+    Buffer* next;
+
+    Buffer(unsigned tid) :
+        tid(tid),
+        tail(&head),
+        next(0)
+    {
+    }
+};
+
+namespace
+{
+
+typedef std::chrono::steady_clock Clock;
+
+Clock::time_point epoch;
+std::atomic<unsigned> threadCount(0);
+std::mutex nameMutex;
+
+void writeString(std::ostream& stream, const char* s, size_t length)
+{
+    stream << '"';
+    for (size_t i = 0; i < length; ++i) {
+        unsigned char c = s[i];
+        switch (c) {
+        case '"':
+            stream << "\\\"";
+            break;
+        case '\\':
+            stream << "\\\\";
+            break;
+        default:
+            if (c < 0x20) {
+                char escape[8];
+                sprintf(escape, "\\u%04x", c);
+                stream << escape;
+            } else
+                stream << c;
+            break;
+        }
+    }
+    stream << '"';
+}
+
+void writeString(std::ostream& stream, const char* s)
+{
+    writeString(stream, s, strlen(s));
+}
+
+void flushAtExit()
+{
+    Trace::flush();
+}
+
+}
+
+std::atomic<bool> Trace::enabled(false);
+std::atomic<Trace::Buffer*> Trace::buffers(0);
+std::string Trace::path;
+
+Trace::Buffer* Trace::getBuffer()
+{
+    static __thread Buffer* buffer;
+    if (!buffer) {
+        buffer = new(std::nothrow) Buffer(++threadCount);
+        if (!buffer)
+            return 0;
+        Buffer* top = buffers.load();
+        do
+            buffer->next = top;
+        while (!buffers.compare_exchange_weak(top, buffer));
+    }
+    return buffer;
+}
+
+uint64_t Trace::now()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - epoch).count();
+}
+
+void Trace::enable(const std::string& path)
+{
+    if (isEnabled())
+        return;
+    Trace::path = path;
+    epoch = Clock::now();
+    enabled.store(true);
+    atexit(flushAtExit);
+}
+
+void Trace::record(char phase, const char* name, const void* id, const char* argName, const std::string& argValue)
+{
+    Buffer* buffer = getBuffer();
+    if (!buffer)
+        return;
+    Buffer::Chunk* chunk = buffer->tail;
+    size_t count = chunk->count.load(std::memory_order_relaxed);
+    if (count == Buffer::ChunkSize) {
+        chunk = new(std::nothrow) Buffer::Chunk;
+        if (!chunk)
+            return;
+        buffer->tail->next.store(chunk, std::memory_order_release);
+        buffer->tail = chunk;
+        count = 0;
+    }
+    Event& event(chunk->events[count]);
+    event.name = name;
+    event.phase = phase;
+    event.timestamp = now();
+    event.id = id;
+    event.argName = argName;
+    event.argValue = argValue;
+    chunk->count.store(count + 1, std::memory_order_release);
+}
+
+void Trace::record(char phase, const char* name, const void* id, const char* argName, const std::u16string& argValue)
+{
+    record(phase, name, id, argName, utfconv(argValue));
+}
+
+void Trace::setThreadName(const char* name)
+{
+    if (!isEnabled())
+        return;
+    if (Buffer* buffer = getBuffer()) {
+        std::lock_guard<std::mutex> lock(nameMutex);
+        buffer->name = name;
+    }
+}
+
+bool Trace::flush()
+{
+    if (!isEnabled() || path.empty())
+        return false;
+    std::ofstream stream(path.c_str(), std::ios::out | std::ios::trunc);
+    if (!stream)
+        return false;
+    pid_t pid = getpid();
+    const char* separator = "\n";
+    stream << "{\"traceEvents\":[";
+    for (Buffer* buffer = buffers.load(); buffer; buffer = buffer->next) {
+        {
+            std::lock_guard<std::mutex> lock(nameMutex);
+            if (!buffer->name.empty()) {
+                stream << separator << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":" << buffer->tid << ",\"args\":{\"name\":";
+                writeString(stream, buffer->name.c_str(), buffer->name.length());
+                stream << "}}";
+                separator = ",\n";
+            }
+        }
+        for (Buffer::Chunk* chunk = &buffer->head; chunk; chunk = chunk->next.load(std::memory_order_acquire)) {
+            size_t count = chunk->count.load(std::memory_order_acquire);
+            for (size_t i = 0; i < count; ++i) {
+                const Event& event(chunk->events[i]);
+                stream << separator << "{\"name\":";
+                writeString(stream, event.name);
+                stream << ",\"cat\":\"escudo\",\"ph\":\"" << event.phase << "\",\"ts\":" << event.timestamp <<
+                    ",\"pid\":" << pid << ",\"tid\":" << buffer->tid;
+                if (event.id) {
+                    char id[24];
+                    sprintf(id, "%p", event.id);
+                    stream << ",\"id\":\"" << id << '"';
+                }
+                if (event.phase == 'i')
+                    stream << ",\"s\":\"t\"";
+                if (event.argName) {
+                    stream << ",\"args\":{";
+                    writeString(stream, event.argName);
+                    stream << ':';
+                    writeString(stream, event.argValue.c_str(), event.argValue.length());
+                    stream << '}';
+                }
+                stream << '}';
+                separator = ",\n";
+            }
+        }
+    }
+    stream << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    stream.close();
+    return !stream.fail();
+}
+
+void Trace::summarize(std::ostream& stream, uint64_t since)
+{
+    struct Total
+    {
+        unsigned count;
+        uint64_t duration;
+        Total() : count(0), duration(0) {}
+    };
+    std::map<std::string, Total> totals;
+    std::map<std::pair<std::string, const void*>, uint64_t> asyncs;
+    for (Buffer* buffer = buffers.load(); buffer; buffer = buffer->next) {
+        std::vector<const Event*> stack;
+        for (Buffer::Chunk* chunk = &buffer->head; chunk; chunk = chunk->next.load(std::memory_order_acquire)) {
+            size_t count = chunk->count.load(std::memory_order_acquire);
+            for (size_t i = 0; i < count; ++i) {
+                const Event& event(chunk->events[i]);
+                switch (event.phase) {
+                case 'B':
+                    stack.push_back(&event);
+                    break;
+                case 'E':
+                    if (!stack.empty()) {
+                        const Event* begin = stack.back();
+                        stack.pop_back();
+                        if (since <= begin->timestamp) {
+                            Total& total(totals[begin->name]);
+                            ++total.count;
+                            total.duration += event.timestamp - begin->timestamp;
+                        }
+                    }
+                    break;
+                case 'b':
+                    asyncs[std::make_pair(std::string(event.name), event.id)] = event.timestamp;
+                    break;
+                default:
+                    break;
+                }
+            }
+        }
+    }
+    // The async events can end on the other threads.
+    for (Buffer* buffer = buffers.load(); buffer; buffer = buffer->next) {
+        for (Buffer::Chunk* chunk = &buffer->head; chunk; chunk = chunk->next.load(std::memory_order_acquire)) {
+            size_t count = chunk->count.load(std::memory_order_acquire);
+            for (size_t i = 0; i < count; ++i) {
+                const Event& event(chunk->events[i]);
+                if (event.phase != 'e')
+                    continue;
+                auto found = asyncs.find(std::make_pair(std::string(event.name), event.id));
+                if (found == asyncs.end())
+                    continue;
+                if (found->second <= event.timestamp) {
+                    if (found->second < since) {
+                        asyncs.erase(found);
+                        continue;
+                    }
+                    Total& total(totals[event.name]);
+                    ++total.count;
+                    total.duration += event.timestamp - found->second;
+                    asyncs.erase(found);
+                }
+            }
+        }
+    }
+    for (auto i = totals.begin(); i != totals.end(); ++i) {
+        char line[128];
+        snprintf(line, sizeof line, "%-20s %6u %10.3f ms\n", i->first.c_str(), i->second.count, i->second.duration / 1000.0);
+        stream << line;
+    }
+}
@@ -0,0 +1,136 @@
+/*
+ * Copyright 2013 Esrille Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ES_TRACE_H_INCLUDED
+#define ES_TRACE_H_INCLUDED
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+// Trace records the phases of loading a page as the Chrome trace events, which
+// can be loaded into chrome://tracing. The events are appended to the buffer
+// of the recording thread without taking a lock, and they are written out as
+// a JSON file by flush(). Unless enable() is called, recording an event costs
+// a single load of a flag.
+class Trace
+{
+public:
+    struct Event
+    {
+        const char* name;       // a string literal
+        char phase;             // 'B', 'E', 'b', 'e' or 'i'
+        uint64_t timestamp;     // in microseconds
+        const void* id;         // for the async events
+        const char* argName;
+        std::string argValue;
+    };
+
+private:
+    struct Buffer;
+
+    static std::atomic<bool> enabled;
+    static std::atomic<Buffer*> buffers;
+    static std::string path;
+
+    static Buffer* getBuffer();
+
+public:
+    static bool isEnabled() {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    // Starts recording the events, which are written to path at exit unless
+    // path is empty.
+    static void enable(const std::string& path);
+
+    // Returns the current timestamp in microseconds.
+    static uint64_t now();
+
+    static void record(char phase, const char* name, const void* id = 0, const char* argName = 0, const std::string& argValue = "");
+    static void record(char phase, const char* name, const void* id, const char* argName, const std::u16string& argValue);
+
+    static void begin(const char* name, const char* argName = 0, const std::string& argValue = "") {
+        if (isEnabled())
+            record('B', name, 0, argName, argValue);
+    }
+    static void end(const char* name) {
+        if (isEnabled())
+            record('E', name);
+    }
+    static void instant(const char* name, const char* argName = 0, const std::string& argValue = "") {
+        if (isEnabled())
+            record('i', name, 0, argName, argValue);
+    }
+
+    // An async event can begin and end on different threads.
+    static void asyncBegin(const char* name, const void* id, const char* argName = 0, const std::string& argValue = "") {
+        if (isEnabled())
+            record('b', name, id, argName, argValue);
+    }
+    static void asyncBegin(const char* name, const void* id, const char* argName, const std::u16string& argValue) {
+        if (isEnabled())
+            record('b', name, id, argName, argValue);
+    }
+    static void asyncEnd(const char* name, const void* id) {
+        if (isEnabled())
+            record('e', name, id);
+    }
+
+    // Names the current thread in the trace.
+    static void setThreadName(const char* name);
+
+    // Writes out the events recorded so far.
+    static bool flush();
+
+    // Writes the number of times and the total time of each phase that began
+    // at or after since.
+    static void summarize(std::ostream& stream, uint64_t since = 0);
+};
+
+// TraceScope records a pair of 'B' and 'E' events around its lifetime.
+class TraceScope
+{
+    const char* name;
+public:
+    TraceScope(const char* name) :
+        name(Trace::isEnabled() ? name : 0)
+    {
+        if (this->name)
+            Trace::record('B', name);
+    }
+    TraceScope(const char* name, const char* argName, const std::string& argValue) :
+        name(Trace::isEnabled() ? name : 0)
+    {
+        if (this->name)
+            Trace::record('B', name, 0, argName, argValue);
+    }
+    // Note argValue is converted only if the trace is enabled.
+    TraceScope(const char* name, const char* argName, const std::u16string& argValue) :
+        name(Trace::isEnabled() ? name : 0)
+    {
+        if (this->name)
+            Trace::record('B', name, 0, argName, argValue);
+    }
+    ~TraceScope() {
+        if (name)
+            Trace::record('E', name);
+    }
+};
+
+#endif  // ES_TRACE_H_INCLUDED
@@ -23,10 +23,63 @@
 
 #include <algorithm>
 
+#include "utf.h"
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+const size_t U16ConverterInputStream::ChunkSize;
+const size_t U16ConverterInputStream::PrescanSize;
 const char* U16ConverterInputStream::DefaultEncoding = "utf-8";
 
 namespace {
 
+inline bool isSpecial(char16_t c, char16_t delimiter1, char16_t delimiter2)
+{
+    return c == delimiter1 || c == delimiter2 || c == '\r' || c == '\0' || c == 0xFEFF;
+}
+
+// Returns the position of the first delimiter1, delimiter2, '\r', NUL, or BOM
+// in [p, end), or end if there is none.
+const char16_t* findSpecial(const char16_t* p, const char16_t* end, char16_t delimiter1, char16_t delimiter2)
+{
+#if defined(__AVX2__)
+    const __m256i d1 = _mm256_set1_epi16(delimiter1);
+    const __m256i d2 = _mm256_set1_epi16(delimiter2);
+    const __m256i cr = _mm256_set1_epi16('\r');
+    const __m256i nul = _mm256_setzero_si256();
+    const __m256i bom = _mm256_set1_epi16(static_cast<short>(0xFEFF));
+    for (; p + 16 <= end; p += 16) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i m = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi16(v, d1), _mm256_cmpeq_epi16(v, d2)),
+                                    _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi16(v, cr), _mm256_cmpeq_epi16(v, nul)),
+                                                    _mm256_cmpeq_epi16(v, bom)));
+        if (unsigned mask = _mm256_movemask_epi8(m))
+            return p + __builtin_ctz(mask) / 2;
+    }
+#elif defined(__SSE2__)
+    const __m128i d1 = _mm_set1_epi16(delimiter1);
+    const __m128i d2 = _mm_set1_epi16(delimiter2);
+    const __m128i cr = _mm_set1_epi16('\r');
+    const __m128i nul = _mm_setzero_si128();
+    const __m128i bom = _mm_set1_epi16(static_cast<short>(0xFEFF));
+    for (; p + 8 <= end; p += 8) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi16(v, d1), _mm_cmpeq_epi16(v, d2)),
+                                 _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi16(v, cr), _mm_cmpeq_epi16(v, nul)),
+                                              _mm_cmpeq_epi16(v, bom)));
+        if (unsigned mask = _mm_movemask_epi8(m))
+            return p + __builtin_ctz(mask) / 2;
+    }
+#endif
+    for (; p < end; ++p) {
+        if (isSpecial(*p, delimiter1, delimiter2))
+            break;
+    }
+    return p;
+}
+
 struct Override
 {
     const char* input;
@@ -52,6 +105,27 @@ Override overrides[] = {
 
 }  // namespace
 
+size_t U16InputStream::scan(std::u16string& text, char16_t delimiter1, char16_t delimiter2)
+{
+    size_t count = 0;
+    for (int c = peek(); 0 <= c && !isSpecial(c, delimiter1, delimiter2); c = peek()) {
+        char16_t ch;
+        get(ch);
+        text += ch;
+        ++count;
+    }
+    return count;
+}
+
+size_t U16InputStream::read(char16_t* buffer, size_t length)
+{
+    size_t count = 0;
+    char16_t c;
+    while (count < length && get(c))
+        buffer[count++] = c;
+    return count;
+}
+
 U16ConverterInputStream::U16ConverterInputStream(std::istream& stream, const std::string& optionalEncoding) :
     confidence(Certain),
     encoding(optionalEncoding),
@@ -150,15 +224,21 @@ void U16ConverterInputStream::setEncoding(std::string value, bool useDefault)
         value = DefaultEncoding;
     }
 
+    // UTF-8 is decoded without ICU.
+    if (!strcasecmp(value.c_str(), "utf-8") || !strcasecmp(value.c_str(), "utf8")) {
+        utf8 = true;
+        encoding = value;
+        return;
+    }
+
     // Re-check encoding with ICU for conversion
     UErrorCode error = U_ZERO_ERROR;
     converter = ucnv_open(value.c_str(), &error);
     if (!converter) {
         if (useDefault) {
             value = DefaultEncoding;
-            converter = ucnv_open(value.c_str(), &error);
-        }
-        if (!converter)
+            utf8 = true;
+        } else
             eof = true;
     }
     encoding = value;
@@ -169,6 +249,7 @@ void U16ConverterInputStream::initializeConverter()
     flush = false;
     eof = !stream;
     converter = 0;
+    utf8 = false;
     source = sourceLimit = sourceBuffer;
     target = targetBuffer;
     nextChar = target;
@@ -187,11 +268,14 @@ void U16ConverterInputStream::updateSource()
     if (0 < count) {
         stream.read(sourceLimit, count);
         count = stream.gcount();
-        if (!converter) {
+        if (!converter && !utf8) {
             bool useDefault = true;
             if (encoding.empty()) {
-                sourceLimit[count] = '\0';
+                char* end = sourceLimit + std::min(count, PrescanSize);
+                char saved = *end;
+                *end = '\0';
                 useDefault = detect(sourceLimit);
+                *end = saved;
             }
             setEncoding(encoding, useDefault);
         }
@@ -201,10 +285,54 @@ void U16ConverterInputStream::updateSource()
     }
 }
 
+size_t U16ConverterInputStream::scan(std::u16string& text, char16_t delimiter1, char16_t delimiter2)
+{
+    // Leave a pending CR-LF pair and chunk boundaries to peek().
+    if (eof || lastChar == '\r' || nextChar == target)
+        return 0;
+    char16_t* end = const_cast<char16_t*>(findSpecial(nextChar, target, delimiter1, delimiter2));
+    size_t count = end - nextChar;
+    if (0 < count) {
+        text.append(nextChar, count);
+        lastChar = end[-1];
+        nextChar = end;
+    }
+    return count;
+}
+
+size_t U16ConverterInputStream::read(char16_t* buffer, size_t length)
+{
+    size_t count = 0;
+    while (count < length) {
+        if (!eof && lastChar != '\r' && nextChar < target) {
+            // Copy the characters that need no preprocessing at once.
+            char16_t* end = const_cast<char16_t*>(findSpecial(nextChar, std::min(target, nextChar + (length - count)), '\r', '\r'));
+            if (size_t n = end - nextChar) {
+                memcpy(buffer + count, nextChar, n * sizeof(char16_t));
+                count += n;
+                lastChar = end[-1];
+                nextChar = end;
+                continue;
+            }
+        }
+        char16_t c;
+        if (!get(c))
+            break;
+        buffer[count++] = c;
+    }
+    return count;
+}
+
 void U16ConverterInputStream::readChunk()
 {
     nextChar = target = targetBuffer;
     updateSource();
+    if (utf8) {
+        utf8to16(const_cast<const char**>(&source), sourceLimit, &target, targetBuffer + ChunkSize, flush);
+        return;
+    }
+    if (!converter)
+        return;
     UErrorCode err = U_ZERO_ERROR;
     ucnv_toUnicode(converter,
                    reinterpret_cast<UChar**>(&target),
@@ -33,6 +33,15 @@ public:
     virtual int peek() = 0;
     virtual U16InputStream& get(char16_t& c) = 0;
 
+    // Appends the characters preceding the first delimiter1, delimiter2, or
+    // character that needs preprocessing ('\r', NUL, BOM) to text, and returns
+    // the number of characters appended. The stopping character is not consumed.
+    virtual size_t scan(std::u16string& text, char16_t delimiter1, char16_t delimiter2);
+
+    // Reads up to length characters into buffer, and returns the number of
+    // characters read.
+    virtual size_t read(char16_t* buffer, size_t length);
+
     int get() {
         char16_t c;
         get(c);
@@ -41,9 +50,9 @@ public:
     operator std::u16string()
     {
         std::u16string text;
-        char16_t c;
-        while (get(c))
-            text += c;
+        char16_t buffer[1024];
+        while (size_t count = read(buffer, sizeof buffer / sizeof buffer[0]))
+            text.append(buffer, count);
         return text;
     }
 };
@@ -75,7 +84,8 @@ public:
 class U16ConverterInputStream : public U16InputStream
 {
 public:
-    static const size_t ChunkSize = 512;
+    static const size_t ChunkSize = 8192;
+    static const size_t PrescanSize = 1024;    // # of bytes examined by detect()
     static const char* DefaultEncoding;  // "utf-8"
     enum Confidence
     {
@@ -123,7 +133,8 @@ protected:
     }
 
 private:
-    UConverter* converter;
+    UConverter* converter;  // 0 if utf8 is true
+    bool utf8;              // true to decode UTF-8 without using ICU
 
     std::istream& stream;
 
@@ -194,6 +205,8 @@ public:
         }
         return *this;
     }
+    virtual size_t scan(std::u16string& text, char16_t delimiter1, char16_t delimiter2);
+    virtual size_t read(char16_t* buffer, size_t length);
 
     enum Confidence getConfidence() const {
         return confidence;
@@ -16,6 +16,7 @@
 
 #include "WindowImp.h"
 
+#include <atomic>
 #include <new>
 #include <iostream>
 #include <boost/version.hpp>
@@ -39,9 +40,16 @@
 #include "http/HTTPConnection.h"
 
 #include "Test.util.h"
+#include "Trace.h"
 
 namespace org { namespace w3c { namespace dom { namespace bootstrap {
 
+namespace {
+
+std::atomic_uint mediaGenerationCount(0);
+
+}
+
 WindowImp::Parser::Parser(DocumentImp* document, int fd, const std::string& optionalEncoding) :
     stream(fd, boost::iostreams::close_handle),
     htmlInputStream(stream, optionalEncoding),
@@ -55,7 +63,6 @@ WindowImp::WindowImp(WindowImp* parent, ElementImp* frameElement, unsigned short
     request(parent ? parent->getLocation().getHref() : u""),
     history(this),
     backgroundTask(this),
-    thread(std::ref(backgroundTask)),
     window(0),
     view(0),
     viewFlags(0),
@@ -72,8 +79,10 @@ WindowImp::WindowImp(WindowImp* parent, ElementImp* frameElement, unsigned short
     redisplay(false),
     zoomable(true),
     zoom(1.0f),
+    mediaGeneration(++mediaGenerationCount),
     faviconOverridable(false),
-    windowDepth(0)
+    windowDepth(0),
+    nodeStatistics{ 0, 0 }
 {
     if (parent) {
         parent->childWindows.push_back(this);
@@ -92,7 +101,6 @@ WindowImp::~WindowImp()
         }
     }
     backgroundTask.abort();
-    thread.join();
 }
 
 void WindowImp::setSize(unsigned w, unsigned h)
@@ -101,11 +109,19 @@ void WindowImp::setSize(unsigned w, unsigned h)
         width = w;
         height = h;
         setViewFlags(Box::NEED_REFLOW);
-        if (window)
-            window->evaluateMedia();
+        updateMediaGeneration();
     }
 }
 
+void WindowImp::updateMediaGeneration()
+{
+    mediaGeneration = ++mediaGenerationCount;
+    if (view && view->hasActiveStyleSheetsChanged())
+        setViewFlags(Box::NEED_SELECTOR_REMATCHING);
+    if (window)
+        window->evaluateMedia();
+}
+
 void WindowImp::setViewFlags(unsigned short flags)
 {
     if (view) {
@@ -115,6 +131,14 @@ void WindowImp::setViewFlags(unsigned short flags)
         viewFlags |= flags;
 }
 
+void WindowImp::invalidateDynamicState(Element element, unsigned bits)
+{
+    if (view)
+        view->invalidateDynamicState(element, bits);
+    else
+        pendingDynamicStates.push_back(std::make_pair(element, bits));
+}
+
 void WindowImp::enter()
 {
     assert(window);
@@ -139,12 +163,13 @@ float WindowImp::getZoom() const
 
 void WindowImp::setZoom(float value)
 {
-    if (zoomable) {
+    if (zoomable && zoom != value) {
         zoom = value;
         if (view) {
             view->setZoom(zoom);
             redisplay = true;
         }
+        updateMediaGeneration();
     }
 }
 
@@ -161,6 +186,9 @@ void WindowImp::updateView(ViewCSSImp* next)
     view = next;
     if (viewFlags)
         setViewFlags(flags | viewFlags);
+    for (auto i = pendingDynamicStates.begin(); i != pendingDynamicStates.end(); ++i)
+        view->invalidateDynamicState(i->first, i->second);
+    pendingDynamicStates.clear();
     view->setZoom(zoom);
     detail = 0;
     redisplay = true;
@@ -185,6 +213,7 @@ void WindowImp::setDocumentWindow(const DocumentWindowPtr& window)
     delete view;
     view = 0;
     viewFlags = 0;
+    pendingDynamicStates.clear();
     if (window)
         backgroundTask.restart(BackgroundTask::Cascade);
     detail = 0;
@@ -265,6 +294,7 @@ bool WindowImp::poll()
     case HttpRequest::DONE:
         if (!document) {
             recordTime("%*shttp request done", windowDepth * 2, "");
+            nodeStatistics = SlabAllocator::getNodeAllocator().getStatistics();
             // TODO: Check header
             Document newDocument = getDOMImplementation()->createDocument(u"", u"", 0); // TODO: Create HTML document
             if ((document = dynamic_cast<DocumentImp*>(newDocument.self()))) {
@@ -290,6 +320,7 @@ bool WindowImp::poll()
             // the background task, firstly we need to check if we can run JS
             // in the background.
 
+            TraceScope scope("html parse", "url", document->getURL());
             document->enter();
 
             if (!parser->processPendingParsingBlockingScript()) {
@@ -317,7 +348,8 @@ bool WindowImp::poll()
             parser.reset();
             document->exit();
 
-            recordTime("%*shtml parsed", windowDepth * 2, "");
+            SlabAllocator::Statistics allocated = SlabAllocator::getNodeAllocator().getStatistics() - nodeStatistics;
+            recordTime("%*shtml parsed: %lu nodes allocated (%lu bytes)", windowDepth * 2, "", allocated.count, allocated.bytes);
             if (4 <= getLogLevel())
                 dumpTree(std::cerr, document);
         }
@@ -374,6 +406,12 @@ bool WindowImp::poll()
                             recordTime("%*strigger reflow", windowDepth * 2, "");
                             backgroundTask.wakeUp(BackgroundTask::Layout);
                             view = 0;
+                        } else if (flags & Box::NEED_STYLE_REPAINT) {
+                            // The background task owns the box tree while it recalculates the styles,
+                            // and it skips the reflow unless the recalculation affects the boxes.
+                            recordTime("%*strigger style recalculation for repaint", windowDepth * 2, "");
+                            backgroundTask.wakeUp(BackgroundTask::Restyle);
+                            view = 0;
                         } else if (flags & Box::NEED_REPAINT) {
                             redisplay = true;
                             if (flags & Loading) {
@@ -404,9 +442,16 @@ bool WindowImp::poll()
     return result;
 }
 
+bool WindowImp::isSettled()
+{
+    return view && backgroundTask.isIdle() && !view->gatherFlags() &&
+           window->getDocument().getReadyState() == u"complete";
+}
+
 void WindowImp::render(ViewCSSImp* parentView)
 {
     if (view) {
+        TraceScope scope("repaint");
         recordTime("%*srepaint begin: %s (%s)", windowDepth * 2, "", utfconv(window->getDocument().getReadyState()).c_str(), view ? "render" : "canvas");
         if (view->gatherFlags() & Box::NEED_REPAINT) {
             view->clearFlags(Box::NEED_REPAINT);
@@ -1815,6 +1860,9 @@ void WindowImp::updateView()
         } else if (flags & (Box::NEED_STYLE_RECALCULATION | Box::NEED_EXPANSION | Box::NEED_CHILD_REFLOW | Box::NEED_REFLOW)) {
             backgroundTask.wakeUp(BackgroundTask::Layout);
             view = 0;
+        } else if (flags & Box::NEED_STYLE_REPAINT) {
+            backgroundTask.wakeUp(BackgroundTask::Restyle);
+            view = 0;
         }
         while (backgroundTask.isRestarting() ||
                backgroundTask.getState() != BackgroundTask::Done && backgroundTask.getState() != BackgroundTask::Init)
@@ -41,7 +41,9 @@
 #include <org/w3c/dom/html/Transferable.h>
 #include <org/w3c/dom/Document.h>
 
+#include <atomic>
 #include <condition_variable>
+#include <cstdint>
 #include <cstdio>
 #include <deque>
 #include <mutex>
@@ -59,6 +61,7 @@
 #include "HistoryImp.h"
 #include "LocationImp.h"
 #include "NavigatorImp.h"
+#include "SlabAllocator.h"
 #include "html/HTMLInputStream.h"
 #include "html/HTMLParser.h"
 #include "html/ScreenImp.h"
@@ -136,7 +139,8 @@ private:
             Abort = 1,
             Cascade = 4,
             Layout = 8,
-            Restart = 16
+            Restart = 16,
+            Restyle = 32    // recalculates the styles, and lays out only if the boxes are affected
         };
 
     private:
@@ -147,14 +151,24 @@ private:
         volatile unsigned flags;
         ViewCSSImp* view;
         volatile bool xfered;
+        bool scheduled;     // true while a job for this task is queued or running in the worker pool
+        uint64_t jobId;     // cf. WorkerPool::post()
+        std::atomic_bool cancelRequest;     // set to cancel the ongoing cascade or layout
+
+        // Statistics of the cancelled cascades and layouts
+        unsigned cancelCount;
+        unsigned wastedTicks;   // in 1/100 sec
 
         void deleteView();
+        void schedule();
+        unsigned takeCommand();
+        void run(unsigned command);
+        void recordCancel(const char* what, unsigned begin, int resetState, unsigned command);
 
     public:
         BackgroundTask(WindowImp* window);
         ~BackgroundTask();
         void operator()();
-        unsigned sleep();
         void wakeUp(unsigned flags);
         void abort();
         void restart(unsigned flags = 0);
@@ -200,11 +214,11 @@ private:
     Retained<HistoryImp> history;
     Retained<ScreenImp> screen;
     BackgroundTask backgroundTask;
-    std::thread thread;
 
     DocumentWindowPtr window;
     ViewCSSImp* view;
     unsigned short viewFlags;
+    std::deque<std::pair<Element, unsigned>> pendingDynamicStates;  // replayed in updateView()
 
     unsigned short flags;
     std::u16string name;
@@ -230,11 +244,13 @@ private:
     bool redisplay;  // set true to force redisplay
     bool zoomable;
     float zoom;
+    std::atomic_uint mediaGeneration;   // renewed whenever the viewport or the zoom is changed
 
     bool faviconOverridable;
 
     // for report
     unsigned windowDepth;
+    SlabAllocator::Statistics nodeStatistics;   // at the beginning of parsing
 
     void mouse(const EventTask& task);
     void mouseMove(const EventTask& task);
@@ -265,11 +281,19 @@ public:
     }
     void setSize(unsigned w, unsigned h);
     void setViewFlags(unsigned short flags);
+    // Invalidates the styles depending on the dynamic pseudo-classes of element
+    // in bits, or records the change until the view is handed back from the
+    // background task.
+    void invalidateDynamicState(Element element, unsigned bits);
 
     bool isBindingDocumentWindow() const;
 
     bool poll();
 
+    // Returns true if the document has been loaded and there is nothing left
+    // to lay out or to repaint; cf. the view dump in render().
+    bool isSettled();
+
     void beginTranslucent() {
         canvas.beginTranslucent();
     }
@@ -306,6 +330,13 @@ public:
     float getZoom() const;
     void setZoom(float value);
 
+    // Returns the generation of the media features, which is unique across
+    // windows; cf. MediaListImp::matches()
+    unsigned getMediaGeneration() const {
+        return mediaGeneration;
+    }
+    void updateMediaGeneration();
+
     bool getFaviconOverridable() const {
         return faviconOverridable;
     }
@@ -0,0 +1,157 @@
+/*
+ * Copyright 2013 Esrille Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+#include "Trace.h"
+
+namespace
+{
+
+struct ParallelFor
+{
+    std::function<void (size_t)> job;
+    size_t count;
+    std::atomic<size_t> next;
+    std::mutex mutex;
+    std::condition_variable cond;
+    size_t done;
+
+    ParallelFor(const std::function<void (size_t)>& job, size_t count) :
+        job(job),
+        count(count),
+        next(0),
+        done(0)
+    {
+    }
+
+    void operator()() {
+        size_t completed = 0;
+        for (size_t i; (i = next++) < count; ++completed)
+            job(i);
+        if (0 < completed) {
+            std::lock_guard<std::mutex> lock(mutex);
+            done += completed;
+            if (done == count)
+                cond.notify_all();
+        }
+    }
+};
+
+}
+
+WorkerPool::WorkerPool(unsigned count) :
+    bypassed{},
+    lastId(0)
+{
+    for (unsigned i = 0; i < count; ++i)
+        threads.push_back(std::thread(&WorkerPool::run, this));
+}
+
+// Called with mutex locked.
+bool WorkerPool::takeJob(Job& job)
+{
+    int priority = -1;
+    for (int i = MaxPriorities - 1; 0 < i; --i) {
+        if (!queues[i].empty() && AgingLimit <= bypassed[i]) {
+            priority = i;
+            break;
+        }
+    }
+    if (priority < 0) {
+        for (int i = 0; i < MaxPriorities; ++i) {
+            if (!queues[i].empty()) {
+                priority = i;
+                break;
+            }
+        }
+        if (priority < 0)
+            return false;
+    }
+    for (int i = priority + 1; i < MaxPriorities; ++i) {
+        if (!queues[i].empty())
+            ++bypassed[i];
+    }
+    bypassed[priority] = 0;
+    job = std::move(queues[priority].front());
+    queues[priority].pop_front();
+    return true;
+}
+
+void WorkerPool::run()
+{
+    Trace::setThreadName("worker");
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (!takeJob(job))
+                cond.wait(lock);
+        }
+        job.function();
+    }
+}
+
+uint64_t WorkerPool::post(const std::function<void ()>& job, Priority priority)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    uint64_t id = ++lastId;
+    queues[priority].push_back({ job, id });
+    cond.notify_one();
+    return id;
+}
+
+bool WorkerPool::cancel(uint64_t id)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (int i = 0; i < MaxPriorities; ++i) {
+        auto found = std::find_if(queues[i].begin(), queues[i].end(), [id](const Job& job) { return job.id == id; });
+        if (found != queues[i].end()) {
+            if (found == queues[i].begin())
+                bypassed[i] = 0;
+            queues[i].erase(found);
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkerPool::parallelFor(size_t count, const std::function<void (size_t)>& job)
+{
+    if (count == 0)
+        return;
+    auto state = std::make_shared<ParallelFor>(job, count);
+    size_t helpers = std::min<size_t>(threads.size(), count - 1);
+    for (size_t i = 0; i < helpers; ++i)
+        post([state] { (*state)(); }, High);
+    (*state)();
+    std::unique_lock<std::mutex> lock(state->mutex);
+    while (state->done < count)
+        state->cond.wait(lock);
+}
+
+// Note the pool is never destructed since its threads can be running while
+// the program exits.
+
+WorkerPool& WorkerPool::getInstance()
+{
+    static WorkerPool* pool = new WorkerPool(std::max(1u, std::thread::hardware_concurrency()));
+    return *pool;
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright 2013 Esrille Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ES_WORKER_POOL_H_INCLUDED
+#define ES_WORKER_POOL_H_INCLUDED
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// WorkerPool runs jobs on a fixed number of threads shared by the process.
+// Jobs having a higher priority are started first; jobs having the same
+// priority are started in the order they were posted. To keep the lower
+// priority jobs from starving, the job at the front of a queue is started
+// once AgingLimit jobs of the higher priorities have been started ahead of it.
+class WorkerPool
+{
+public:
+    enum Priority
+    {
+        High,       // parts of a job that is already running
+        Normal,     // jobs for the top-level windows
+        Low,        // jobs for the child windows and the binding documents
+        MaxPriorities
+    };
+
+    static const unsigned AgingLimit = 8;
+
+private:
+    struct Job
+    {
+        std::function<void ()> function;
+        uint64_t id;
+    };
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::deque<Job> queues[MaxPriorities];
+    unsigned bypassed[MaxPriorities];   // the jobs started ahead of the front of each queue
+    uint64_t lastId;
+    std::vector<std::thread> threads;
+
+    bool takeJob(Job& job);
+    void run();
+
+public:
+    WorkerPool(unsigned count);
+
+    unsigned getThreadCount() const {
+        return threads.size();
+    }
+
+    // Returns the id of the posted job, which is never 0.
+    uint64_t post(const std::function<void ()>& job, Priority priority = Normal);
+
+    // Removes the job from the queue unless it has already been started, and
+    // returns true if it has been removed.
+    bool cancel(uint64_t id);
+
+    // Calls job(i) for every i in [0, count) using the idle workers and the
+    // calling thread, and returns once every call has completed. The indices
+    // are handed out one at a time, so a worker that is done with a cheap
+    // index simply takes the next one.
+    void parallelFor(size_t count, const std::function<void (size_t)>& job);
+
+    // Returns the pool sized to the number of the hardware threads.
+    static WorkerPool& getInstance();
+};
+
+#endif  // ES_WORKER_POOL_H_INCLUDED
@@ -85,13 +85,19 @@ Box::Box(Node node) :
     backgroundStart(getTick()),
     style(0),
     flags(0),
-    childWindow(0)
+    childWindow(0),
+    hitLeft(-HUGE_VALF),
+    hitTop(-HUGE_VALF),
+    hitRight(HUGE_VALF),
+    hitBottom(HUGE_VALF),
+    hitGrid(0)
 {
 }
 
 Box::~Box()
 {
     delete backgroundRequest;
+    delete hitGrid;
 
     if (stackingContext)
         stackingContext->removeBox(this);
@@ -119,6 +125,7 @@ Box* Box::removeChild(Box* item)
         prev->nextSibling = next;
     item->parentBox = item->previousSibling = item->nextSibling = 0;
     --childCount;
+    resetHitBounds();
 
     if (auto block = dynamic_cast<Block*>(item))
         block->inserted = false;
@@ -143,6 +150,7 @@ Box* Box::insertBefore(Box* item, Box* after)
     item->parentBox = this;
     item->retain_();
     ++childCount;
+    resetHitBounds();
     return item;
 }
 
@@ -160,9 +168,101 @@ Box* Box::appendChild(Box* item)
     item->parentBox = this;
     item->retain_();
     ++childCount;
+    resetHitBounds();
     return item;
 }
 
+void Box::resetHitBounds()
+{
+    for (Box* box = this; box; box = box->parentBox) {
+        if (box->hitLeft == -HUGE_VALF && !box->hitGrid)
+            break;
+        box->hitLeft = box->hitTop = -HUGE_VALF;
+        box->hitRight = box->hitBottom = HUGE_VALF;
+        delete box->hitGrid;
+        box->hitGrid = 0;
+    }
+}
+
+void Box::updateHitBounds()
+{
+    delete hitGrid;
+    hitGrid = 0;
+
+    float left = x + marginLeft;
+    float top = y + marginTop;
+    float right = left + getBorderWidth();
+    float bottom = top + getBorderHeight();
+    bool bounded = left <= right && top <= bottom;  // false if NaN
+    bool clipped = isClipped();
+    for (Box* child = getFirstChild(); child; child = child->getNextSibling()) {
+        child->updateHitBounds();
+        if (clipped)
+            continue;   // hits outside of this box are discarded.
+        left = std::min(left, child->hitLeft);
+        top = std::min(top, child->hitTop);
+        right = std::max(right, child->hitRight);
+        bottom = std::max(bottom, child->hitBottom);
+    }
+
+    // The children are tested in the scrolled coordinates of this box.
+    if (!isAnonymous() && Element::hasInstance(node)) {
+        Element element = interface_cast<Element>(node);
+        float scrollLeft = element.getScrollLeft();
+        float scrollTop = element.getScrollTop();
+        if (Block* block = dynamic_cast<Block*>(this)) {
+            scrollLeft = std::max(scrollLeft, block->getScrollWidth() - block->width);
+            scrollTop = std::max(scrollTop, block->getScrollHeight() - block->height);
+        }
+        if (0.0f < scrollLeft)
+            left -= scrollLeft;
+        if (0.0f < scrollTop)
+            top -= scrollTop;
+    }
+
+    if (!bounded || !(left <= right && top <= bottom)) {
+        hitLeft = hitTop = -HUGE_VALF;
+        hitRight = hitBottom = HUGE_VALF;
+        return;
+    }
+    hitLeft = left;
+    hitTop = top;
+    hitRight = right;
+    hitBottom = bottom;
+
+    if (childCount < HitGridThreshold)
+        return;
+    float gridTop = HUGE_VALF;
+    float gridBottom = -HUGE_VALF;
+    for (Box* child = getFirstChild(); child; child = child->getNextSibling()) {
+        gridTop = std::min(gridTop, child->hitTop);
+        gridBottom = std::max(gridBottom, child->hitBottom);
+    }
+    if (!(gridTop < gridBottom) || gridTop == -HUGE_VALF || gridBottom == HUGE_VALF)
+        return;
+    size_t count = childCount / 4;
+    HitGrid* grid = new(std::nothrow) HitGrid;
+    if (!grid)
+        return;
+    grid->top = gridTop;
+    grid->cellHeight = (gridBottom - gridTop) / count;
+    grid->cells.resize(count);
+    size_t entries = 0;
+    for (Box* child = getFirstChild(); child; child = child->getNextSibling()) {
+        size_t first = std::min(static_cast<size_t>((child->hitTop - gridTop) / grid->cellHeight), count - 1);
+        size_t last = std::min(static_cast<size_t>((child->hitBottom - gridTop) / grid->cellHeight), count - 1);
+        entries += last - first + 1;
+        if (4 * childCount < entries) {
+            // The children overlap too much to be bucketed.
+            delete grid;
+            return;
+        }
+        for (size_t i = first; i <= last; ++i)
+            grid->cells[i].push_back(child);
+    }
+    hitGrid = grid;
+}
+
 void Box::removeChildren()
 {
     while (hasChildBoxes()) {
@@ -1292,6 +1392,8 @@ void Block::layOutChildren(ViewCSSImp* view, FormattingContext* context)
 {
     Box* next;
     for (Box* child = getFirstChild(); child; child = next) {
+        if (view->isCancelled())
+            return;
         next = child->getNextSibling();
         if (!child->layOut(view, context)) {
             removeChild(child);
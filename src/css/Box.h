@@ -23,10 +23,12 @@
 #include <algorithm>
 #include <list>
 #include <string>
+#include <vector>
 
 #include <boost/intrusive_ptr.hpp>
 
 #include "http/HTTPRequest.h"
+#include "SlabAllocator.h"
 #include "CSSStyleDeclarationImp.h"
 #include "FormattingContext.h"
 #include "StackingContext.h"
@@ -70,6 +72,23 @@ public:
     }
 };
 
+// HitGrid buckets the child boxes of a box having many children by their
+// vertical hit bounds so that boxFromPoint() tests only the children that
+// can contain the point.
+struct HitGrid
+{
+    float top;
+    float cellHeight;
+    std::vector<std::vector<Box*>> cells;
+
+    const std::vector<Box*>* lookUp(int y) const {
+        float i = (y - top) / cellHeight;
+        if (i < 0.0f)
+            return 0;
+        return &cells[std::min(static_cast<size_t>(i), cells.size() - 1)];
+    }
+};
+
 class Box : public ContainingBlock
 {
     friend class ViewCSSImp;
@@ -95,9 +114,13 @@ public:
     static const unsigned short NEED_REPOSITION = 0x40;
     static const unsigned short NEED_REPAINT = 0x80;
     static const unsigned short NEED_SELECTOR_REMATCHING = 0x100;
+    static const unsigned short NEED_STYLE_REPAINT = 0x200;  // style recalculation affecting only paint properties
 
     static const unsigned short NEED_TABLE_REFLOW = 0x8000;
 
+    // The minimum # of child boxes to build a HitGrid for
+    static const unsigned HitGridThreshold = 32;
+
 protected:
     Node node;
     Box* parentBox;
@@ -152,6 +175,24 @@ protected:
 
     WindowImp* childWindow;
 
+    // The bounds of the points, in the coordinates of the parent box, at which
+    // boxFromPoint() can hit this box or one of its descendants; cf. updateHitBounds()
+    float hitLeft;
+    float hitTop;
+    float hitRight;
+    float hitBottom;
+    HitGrid* hitGrid;
+
+    Box* hitChild(Box* box, int x, int y, StackingContext* context) {
+        if (!box->mayHit(x, y))
+            return 0;
+        if (Box* target = box->boxFromPoint(x, y, context)) {
+            if (!isClipped() || isInside(x, y))
+                return target;
+        }
+        return 0;
+    }
+
     void renderBorderEdge(ViewCSSImp* view, int edge, unsigned borderStyle, unsigned color,
                           float a, float b, float c, float d,
                           float e, float f, float g, float h);
@@ -159,6 +200,8 @@ public:
     Box(Node node);
     virtual ~Box();
 
+    ES_SLAB_ALLOCATED(SlabAllocator::getBoxAllocator())
+
     virtual unsigned getBoxType() const = 0;
 
     virtual bool isAnonymous() const {
@@ -458,15 +501,30 @@ public:
             x += element.getScrollLeft();
             y += element.getScrollTop();
         }
-        for (Box* box = getFirstChild(); box; box = box->getNextSibling()) {
-            if (Box* target = box->boxFromPoint(x, y, context)) {
-                if (!isClipped() || isInside(x, y))
+        if (hitGrid) {
+            if (const std::vector<Box*>* cell = hitGrid->lookUp(y)) {
+                for (auto i = cell->begin(); i != cell->end(); ++i) {
+                    if (Box* target = hitChild(*i, x, y, context))
+                        return target;
+                }
+            }
+        } else {
+            for (Box* box = getFirstChild(); box; box = box->getNextSibling()) {
+                if (Box* target = hitChild(box, x, y, context))
                     return target;
             }
         }
         return isInside(x, y) ? this : 0;
     }
 
+    bool mayHit(int u, int v) const {
+        return hitLeft <= u && u < hitRight && hitTop <= v && v < hitBottom;
+    }
+    // Rebuilds the hit bounds of this box and its descendants after resolveXY().
+    void updateHitBounds();
+    // Invalidates the hit bounds of this box and its ancestors.
+    void resetHitBounds();
+
     void updateScrollSize();
     void resetScrollSize();
 
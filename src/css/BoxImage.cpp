@@ -28,6 +28,7 @@
 #include "Bmp.h"
 
 #include "utf.h"
+#include "Trace.h"
 #include "http/HTTPRequest.h"
 
 namespace org { namespace w3c { namespace dom { namespace bootstrap {
@@ -332,6 +333,7 @@ BoxImage::BoxImage(unsigned repeat) :
 void BoxImage::open(FILE* file)
 {
     assert(file);
+    TraceScope scope("image decode");
     long pos = ftell(file);
     pixels = readAsIco(file, naturalWidth, naturalHeight, format);
     if (!pixels) {
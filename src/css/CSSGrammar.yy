@@ -816,11 +816,11 @@ optional_media_query_value
 declaration_list
   : declaration {
         if (CSSStyleDeclarationImp* decl = parser->getStyleDeclaration())
-            decl->commitAppend();
+            decl->commitAppend(parser->getSnapshotWriter());
     }
   | declaration_list ';' optional_space declaration {
         if (CSSStyleDeclarationImp* decl = parser->getStyleDeclaration())
-            decl->commitAppend();
+            decl->commitAppend(parser->getSnapshotWriter());
     }
   | declaration error {
         if (CSSStyleDeclarationImp* decl = parser->getStyleDeclaration())
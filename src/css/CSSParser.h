@@ -44,6 +44,7 @@ class CSSStyleSheetImp;
 class CSSStyleDeclarationImp;
 class CSSMediaRuleImp;
 class CSSRuleImp;
+class CSSSnapshotWriter;
 
 struct CSSParserNumber
 {
@@ -264,6 +265,7 @@ class CSSParser
     CSSMediaRuleImp* mediaRule;
     bool caseSensitive;  // for element names and attribute names.
     bool importable;
+    CSSSnapshotWriter* snapshotWriter;
 
     Retained<MediaListImp> mediaList;
 
@@ -280,7 +282,8 @@ public:
         selectorsGroup(0),
         mediaRule(0),
         caseSensitive(false),
-        importable(true)
+        importable(true),
+        snapshotWriter(0)
     {
     }
 
@@ -353,6 +356,14 @@ public:
     bool isImportable() {
         return importable;
     }
+
+    // Records the parsed declarations for writing out a snapshot of the style sheet.
+    void setSnapshotWriter(CSSSnapshotWriter* writer) {
+        snapshotWriter = writer;
+    }
+    CSSSnapshotWriter* getSnapshotWriter() const {
+        return snapshotWriter;
+    }
 };
 
 inline void CSSerror(CSSParser* parser, const char* message, ...)
@@ -0,0 +1,139 @@
+/*
+ * Copyright 2013 Esrille Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "CSSRuleIndex.h"
+
+#include <algorithm>
+
+#include "CSSStyleSheetImp.h"
+#include "ElementImp.h"
+#include "ViewCSSImp.h"
+
+#include "utf.h"
+
+namespace org { namespace w3c { namespace dom { namespace bootstrap {
+
+void CSSRuleIndex::collectSources(std::vector<Source>& sources, CSSRuleListImp* ruleList, unsigned importance)
+{
+    // Declarations in imported style sheets are considered to be before any
+    // declarations in the style sheet itself; cf. CSSRuleListImp::find()
+    for (auto i = ruleList->importList.begin(); i != ruleList->importList.end(); ++i) {
+        if (CSSStyleSheetImp* sheet = dynamic_cast<CSSStyleSheetImp*>((*i)->getStyleSheet().self())) {
+            if (CSSRuleListImp* imported = dynamic_cast<CSSRuleListImp*>(sheet->getCssRules().self()))
+                collectSources(sources, imported, importance);
+        }
+    }
+    sources.push_back(Source{ ruleList, ruleList->order, importance });
+}
+
+void CSSRuleIndex::collectSources(std::vector<Source>& sources, const StyleSheetList& list)
+{
+    for (auto i = list.begin(); i != list.end(); ++i) {
+        if (CSSStyleSheetImp* sheet = dynamic_cast<CSSStyleSheetImp*>(i->first.self())) {
+            if (CSSRuleListImp* ruleList = dynamic_cast<CSSRuleListImp*>(sheet->getCssRules().self()))
+                collectSources(sources, ruleList, i->second);
+        }
+    }
+}
+
+CSSRuleIndex::CSSRuleIndex(const StyleSheetList& list) :
+    styleSheets(list)
+{
+    collectSources(sources, list);
+    for (auto i = sources.begin(); i != sources.end(); ++i)
+        append(i->ruleList, i->importance);
+    std::stable_sort(ids.begin(), ids.end());
+    std::stable_sort(classes.begin(), classes.end());
+    std::stable_sort(types.begin(), types.end());
+}
+
+void CSSRuleIndex::append(const CSSRuleListImp* ruleList, unsigned importance)
+{
+    for (auto i = ruleList->misc.begin(); i != ruleList->misc.end(); ++i)
+        misc.push_back(Entry{ std::u16string(), importance, *i });
+    for (auto i = ruleList->mapType.begin(); i != ruleList->mapType.end(); ++i)
+        types.push_back(Entry{ i->first, importance, i->second });
+    for (auto i = ruleList->mapClass.begin(); i != ruleList->mapClass.end(); ++i)
+        classes.push_back(Entry{ i->first, importance, i->second });
+    for (auto i = ruleList->mapID.begin(); i != ruleList->mapID.end(); ++i)
+        ids.push_back(Entry{ i->first, importance, i->second });
+}
+
+bool CSSRuleIndex::isUpToDate(const StyleSheetList& list) const
+{
+    std::vector<Source> current;
+    collectSources(current, list);
+    return current == sources;
+}
+
+void CSSRuleIndex::find(CSSRuleListImp::RuleSet& set, ViewCSSImp* view, Element& element, const Entry* begin, const Entry* end) const
+{
+    for (const Entry* i = begin; i != end; ++i) {
+        CSSSelector* selector = i->rule.selector;
+        size_t mark = view ? view->getDynamicList().size() : 0;
+        if (!selector->match(element, view, false)) {
+            if (view)
+                view->getDynamicList().resize(mark);
+            continue;
+        }
+        // TODO: emplace() seems to be not ready yet with libstdc++.
+        CSSRuleListImp::PrioritizedRule rule(i->importance, i->rule);
+        set.push_back(rule);
+    }
+}
+
+void CSSRuleIndex::find(CSSRuleListImp::RuleSet& set, ViewCSSImp* view, Element& element, const std::vector<Entry>& entries, const std::u16string& key) const
+{
+    Entry probe{ key, 0, CSSRuleListImp::Rule{ 0, 0, 0 } };
+    auto range = std::equal_range(entries.begin(), entries.end(), probe);
+    if (range.first != range.second)
+        find(set, view, element, &*range.first, &*range.first + (range.second - range.first));
+}
+
+void CSSRuleIndex::find(CSSRuleListImp::RuleSet& set, ViewCSSImp* view, Element& element) const
+{
+    if (!misc.empty())
+        find(set, view, element, &misc.front(), &misc.front() + misc.size());
+    find(set, view, element, types, element.getLocalName());
+
+    ElementImp* imp = dynamic_cast<ElementImp*>(element.self());
+    if (!imp)
+        return;
+    if (const std::u16string* attr = imp->findAttribute(u"class")) {
+        const std::u16string& classes = *attr;
+        for (size_t pos = 0; pos < classes.length();) {
+            if (isSpace(classes[pos])) {
+                ++pos;
+                continue;
+            }
+            size_t start = pos++;
+            while (pos < classes.length() && !isSpace(classes[pos]))
+                ++pos;
+            find(set, view, element, this->classes, classes.substr(start, pos - start));
+        }
+    }
+    if (const std::u16string* id = imp->findAttribute(u"id"))
+        find(set, view, element, ids, *id);
+}
+
+std::shared_ptr<const CSSRuleIndex> CSSRuleIndex::update(const std::shared_ptr<const CSSRuleIndex>& index, const StyleSheetList& list)
+{
+    if (index && index->isUpToDate(list))
+        return index;
+    return std::make_shared<const CSSRuleIndex>(list);
+}
+
+}}}}  // org::w3c::dom::bootstrap
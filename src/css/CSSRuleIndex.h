@@ -0,0 +1,93 @@
+/*
+ * Copyright 2013 Esrille Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ES_CSSRULEINDEX_H
+#define ES_CSSRULEINDEX_H
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <org/w3c/dom/css/CSSStyleSheet.h>
+
+#include "CSSRuleListImp.h"
+
+namespace org { namespace w3c { namespace dom { namespace bootstrap {
+
+// CSSRuleIndex merges the selector indexes of a list of style sheets, including
+// the imported ones, into flat arrays sorted by key. Once constructed, an index
+// is never modified so that it can be shared by windows and threads.
+class CSSRuleIndex
+{
+public:
+    // Style sheets paired with their importance, i.e., CSSRuleListImp::Importance
+    typedef std::vector<std::pair<css::CSSStyleSheet, unsigned>> StyleSheetList;
+
+private:
+    struct Entry
+    {
+        std::u16string key;
+        unsigned importance;
+        CSSRuleListImp::Rule rule;
+
+        bool operator<(const Entry& other) const {
+            return key < other.key;
+        }
+    };
+
+    // The state of a rule list at the time the index was built; since rules are
+    // only appended to a CSSRuleListImp, the index is stale once the count differs.
+    struct Source
+    {
+        const CSSRuleListImp* ruleList;
+        unsigned count;
+        unsigned importance;
+
+        bool operator==(const Source& other) const {
+            return ruleList == other.ruleList && count == other.count && importance == other.importance;
+        }
+    };
+
+    StyleSheetList styleSheets;     // keeps the indexed rules alive
+    std::vector<Source> sources;
+    std::vector<Entry> ids;
+    std::vector<Entry> classes;
+    std::vector<Entry> types;
+    std::vector<Entry> misc;
+
+    static void collectSources(std::vector<Source>& sources, CSSRuleListImp* ruleList, unsigned importance);
+    static void collectSources(std::vector<Source>& sources, const StyleSheetList& list);
+
+    void append(const CSSRuleListImp* ruleList, unsigned importance);
+    void find(CSSRuleListImp::RuleSet& set, ViewCSSImp* view, Element& element, const Entry* begin, const Entry* end) const;
+    void find(CSSRuleListImp::RuleSet& set, ViewCSSImp* view, Element& element, const std::vector<Entry>& entries, const std::u16string& key) const;
+
+public:
+    CSSRuleIndex(const StyleSheetList& list);
+
+    bool isUpToDate(const StyleSheetList& list) const;
+    void find(CSSRuleListImp::RuleSet& set, ViewCSSImp* view, Element& element) const;
+
+    // Returns index if it is still valid for list, or a new index for list.
+    static std::shared_ptr<const CSSRuleIndex> update(const std::shared_ptr<const CSSRuleIndex>& index, const StyleSheetList& list);
+};
+
+typedef std::shared_ptr<const CSSRuleIndex> CSSRuleIndexPtr;
+
+}}}}  // org::w3c::dom::bootstrap
+
+#endif  // ES_CSSRULEINDEX_H
@@ -16,13 +16,19 @@
 
 #include "CSSRuleListImp.h"
 
+#include <memory>
+#include <new>
+
 #include "CSSMediaRuleImp.h"
 #include "CSSStyleDeclarationImp.h"
 #include "CSSStyleSheetImp.h"
 
 #include "DocumentImp.h"
+#include "ElementImp.h"
 #include "ViewCSSImp.h"
 
+#include "SlabAllocator.h"
+
 namespace org { namespace w3c { namespace dom { namespace bootstrap {
 
 using namespace css;
@@ -98,26 +104,34 @@ void CSSRuleListImp::find(RuleSet& set, ViewCSSImp* view, Element& element, std:
 {
     for (auto i = map.find(key); i != map.end() && i->first == key; ++i) {
         CSSSelector* selector = i->second.selector;
-        if (!selector->match(element, view, false))
+        size_t mark = view ? view->getDynamicList().size() : 0;
+        if (!selector->match(element, view, false)) {
+            if (view)
+                view->getDynamicList().resize(mark);
             continue;
+        }
         // TODO: emplace() seems to be not ready yet with libstdc++.
         PrioritizedRule rule(importance, i->second);
-        set.insert(rule);
+        set.push_back(rule);
     }
 }
 
 void CSSRuleListImp::findByID(RuleSet& set, ViewCSSImp* view, Element& element)
 {
-    Nullable<std::u16string> attr = element.getAttribute(u"id");
-    if (attr.hasValue())
-        find(set, view, element, mapID, attr.value());
+    ElementImp* imp = dynamic_cast<ElementImp*>(element.self());
+    if (!imp)
+        return;
+    if (const std::u16string* id = imp->findAttribute(u"id"))
+        find(set, view, element, mapID, *id);
 }
 
 void CSSRuleListImp::findByClass(RuleSet& set, ViewCSSImp* view, Element& element)
 {
-    Nullable<std::u16string> attr = element.getAttribute(u"class");
-    if (attr.hasValue()) {
-        std::u16string classes = attr.value();
+    ElementImp* imp = dynamic_cast<ElementImp*>(element.self());
+    if (!imp)
+        return;
+    if (const std::u16string* attr = imp->findAttribute(u"class")) {
+        const std::u16string& classes = *attr;
         for (size_t pos = 0; pos < classes.length();) {
             if (isSpace(classes[pos])) {
                 ++pos;
@@ -140,11 +154,15 @@ void CSSRuleListImp::findMisc(RuleSet& set, ViewCSSImp* view, Element& element)
 {
     for (auto i = misc.begin(); i != misc.end(); ++i) {
         CSSSelector* selector = i->selector;
-        if (!selector->match(element, view, false))
+        size_t mark = view ? view->getDynamicList().size() : 0;
+        if (!selector->match(element, view, false)) {
+            if (view)
+                view->getDynamicList().resize(mark);
             continue;
+        }
         // TODO: emplace() seems to be not ready yet with libstdc++.
         PrioritizedRule rule(importance, *i);
-        set.insert(rule);
+        set.push_back(rule);
     }
 }
 
@@ -168,9 +186,31 @@ void CSSRuleListImp::find(RuleSet& set, ViewCSSImp* view, Element& element, unsi
     findByID(set, view, element);
 }
 
-bool CSSRuleListImp::hasHover(const RuleSet& set)
+void CSSRuleListImp::MatchedRuleList::assign(const RuleSet& set)
+{
+    clear();
+    if (set.empty())
+        return;
+    void* p = SlabAllocator::getRuleAllocator().allocate(sizeof(PrioritizedRule) * set.size());
+    if (!p)
+        return;
+    rules = static_cast<PrioritizedRule*>(p);
+    count = set.size();
+    std::uninitialized_copy(set.begin(), set.end(), rules);
+}
+
+void CSSRuleListImp::MatchedRuleList::clear()
+{
+    if (!rules)
+        return;
+    SlabAllocator::getRuleAllocator().deallocate(rules, sizeof(PrioritizedRule) * count);
+    rules = 0;
+    count = 0;
+}
+
+bool CSSRuleListImp::hasHover(const MatchedRuleList& list)
 {
-    for (auto i = set.begin(); i != set.end(); ++i) {
+    for (auto i = list.begin(); i != list.end(); ++i) {
         CSSSelector* selector = i->getSelector();
         if (selector && selector->hasHover())
             return true;
@@ -23,10 +23,12 @@
 
 #include <org/w3c/dom/css/CSSRuleList.h>
 
+#include <algorithm>
 #include <deque>
 #include <list>
 #include <map>
 #include <set>
+#include <vector>
 
 #include "CSSImportRuleImp.h"
 #include "CSSStyleRuleImp.h"
@@ -37,6 +39,8 @@ class DocumentImp;
 
 class CSSRuleListImp : public ObjectMixin<CSSRuleListImp>
 {
+    friend class CSSRuleIndex;
+
 public:
     struct Rule
     {
@@ -100,7 +104,49 @@ public:
         }
     };
 
-    typedef std::multiset<PrioritizedRule> RuleSet;
+    // A scratch list of the matched rules; call sort() once matching is done.
+    typedef std::vector<PrioritizedRule> RuleSet;
+
+    static void sort(RuleSet& set) {
+        // Keep the rules having the same priority in the order they were found.
+        std::stable_sort(set.begin(), set.end());
+    }
+
+    // MatchedRuleList is the compact copy of a sorted RuleSet that is kept per
+    // element. The rules are stored in a single block allocated from the rule
+    // allocator.
+    class MatchedRuleList
+    {
+        PrioritizedRule* rules;
+        unsigned count;
+
+        MatchedRuleList(const MatchedRuleList&) = delete;
+        MatchedRuleList& operator=(const MatchedRuleList&) = delete;
+
+    public:
+        MatchedRuleList() :
+            rules(0),
+            count(0)
+        {}
+        ~MatchedRuleList() {
+            clear();
+        }
+        void assign(const RuleSet& set);
+        void clear();
+
+        const PrioritizedRule* begin() const {
+            return rules;
+        }
+        const PrioritizedRule* end() const {
+            return rules + count;
+        }
+        bool empty() const {
+            return !count;
+        }
+        unsigned size() const {
+            return count;
+        }
+    };
 
 private:
     unsigned importance;
@@ -177,7 +223,7 @@ public:
         return css::CSSRuleList::getMetaData();
     }
 
-    static bool hasHover(const RuleSet& set);
+    static bool hasHover(const MatchedRuleList& list);
 };
 
 }}}}  // org::w3c::dom::bootstrap
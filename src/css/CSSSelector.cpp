@@ -23,6 +23,8 @@
 
 #include "CSSStyleDeclarationImp.h"
 #include "CSSRuleListImp.h"
+#include "CSSSnapshot.h"
+#include "ElementImp.h"
 #include "ViewCSSImp.h"
 
 namespace org { namespace w3c { namespace dom { namespace bootstrap {
@@ -30,6 +32,31 @@ namespace org { namespace w3c { namespace dom { namespace bootstrap {
 namespace
 {
 
+size_t getTextLength(const CSSParserExpr* expr)
+{
+    size_t length = 0;
+    for (auto i = expr->list.begin(); i != expr->list.end(); ++i) {
+        if (0 < i->text.length)
+            length += i->text.length;
+        if (i->unit == CSSParserTerm::CSS_TERM_FUNCTION && i->expr)
+            length += getTextLength(i->expr);
+    }
+    return length;
+}
+
+void copyText(CSSParserExpr* expr, char16_t*& p)
+{
+    for (auto i = expr->list.begin(); i != expr->list.end(); ++i) {
+        if (0 < i->text.length) {
+            std::memcpy(p, i->text.text, i->text.length * sizeof(char16_t));
+            i->text.text = p;
+            p += i->text.length;
+        }
+        if (i->unit == CSSParserTerm::CSS_TERM_FUNCTION && i->expr)
+            copyText(i->expr, p);
+    }
+}
+
 inline bool find(const std::u16string& s, const std::u16string& t)
 {
     return s.find(t) != std::u16string::npos;
@@ -143,12 +170,108 @@ CSSSpecificity CSSPrimarySelector::getSpecificity() {
 
 CSSSpecificity CSSSelector::getSpecificity()
 {
-    CSSSpecificity specificity;
-    for (auto i = simpleSelectors.begin(); i != simpleSelectors.end(); ++i)
-        specificity += (*i)->getSpecificity();
+    if (!hasSpecificity) {
+        specificity = CSSSpecificity();
+        for (auto i = simpleSelectors.begin(); i != simpleSelectors.end(); ++i)
+            specificity += (*i)->getSpecificity();
+        hasSpecificity = true;
+    }
     return specificity;
 }
 
+void CSSPrimarySelector::write(CSSSnapshotWriter& writer)
+{
+    writer.writeUnsigned(CSSSnapshot::PrimarySelector);
+    writer.writeInteger(combinator);
+    writer.writeString(namespacePrefix);
+    writer.writeString(name);
+    writer.writeUnsigned(chain.size());
+    for (auto i = chain.begin(); i != chain.end(); ++i)
+        (*i)->write(writer);
+}
+
+void CSSIDSelector::write(CSSSnapshotWriter& writer)
+{
+    writer.writeUnsigned(CSSSnapshot::IDSelector);
+    writer.writeString(name);
+}
+
+void CSSClassSelector::write(CSSSnapshotWriter& writer)
+{
+    writer.writeUnsigned(CSSSnapshot::ClassSelector);
+    writer.writeString(name);
+}
+
+void CSSAttributeSelector::write(CSSSnapshotWriter& writer)
+{
+    writer.writeUnsigned(CSSSnapshot::AttributeSelector);
+    writer.writeString(namespacePrefix);
+    writer.writeString(name);
+    writer.writeInteger(op);
+    writer.writeString(value);
+    writer.writeString(flags);
+}
+
+void CSSPseudoSelector::copyExpressionText()
+{
+    if (!expression)
+        return;
+    expressionText.resize(getTextLength(expression));
+    if (!expressionText.empty()) {
+        char16_t* p = &expressionText[0];
+        copyText(expression, p);
+    }
+}
+
+void CSSPseudoSelector::writeFunction(CSSSnapshotWriter& writer)
+{
+    writer.writeString(name);
+    writer.writeUnsigned(expression ? 1 : 0);
+    if (expression)
+        writer.writeExpr(expression);
+}
+
+void CSSPseudoClassSelector::write(CSSSnapshotWriter& writer)
+{
+    writer.writeUnsigned(CSSSnapshot::PseudoClassSelector);
+    writer.writeInteger(id);
+    writeFunction(writer);
+}
+
+void CSSLangPseudoClassSelector::write(CSSSnapshotWriter& writer)
+{
+    writer.writeUnsigned(CSSSnapshot::LangPseudoClassSelector);
+    writer.writeString(lang);
+}
+
+void CSSNthPseudoClassSelector::write(CSSSnapshotWriter& writer)
+{
+    writer.writeUnsigned(CSSSnapshot::NthPseudoClassSelector);
+    writer.writeInteger(getID());
+    writer.writeInteger(a);
+    writer.writeInteger(b);
+}
+
+void CSSPseudoElementSelector::write(CSSSnapshotWriter& writer)
+{
+    writer.writeUnsigned(CSSSnapshot::PseudoElementSelector);
+    writer.writeInteger(id);
+}
+
+void CSSNegationPseudoClassSelector::write(CSSSnapshotWriter& writer)
+{
+    writer.writeUnsigned(CSSSnapshot::NegationPseudoClassSelector);
+    selector->write(writer);
+}
+
+void CSSSelector::write(CSSSnapshotWriter& writer)
+{
+    writer.writeUnsigned(getSpecificity());
+    writer.writeUnsigned(simpleSelectors.size());
+    for (auto i = simpleSelectors.begin(); i != simpleSelectors.end(); ++i)
+        (*i)->write(writer);
+}
+
 bool CSSPrimarySelector::match(Element& e, ViewCSSImp* view, bool dynamic)
 {
     if (name != u"*") {
@@ -168,6 +291,10 @@ bool CSSPrimarySelector::match(Element& e, ViewCSSImp* view, bool dynamic)
 
 bool CSSIDSelector::match(Element& e, ViewCSSImp* view, bool dynamic)
 {
+    if (ElementImp* element = dynamic_cast<ElementImp*>(e.self())) {
+        const std::u16string* id = element->findAttribute(u"id");
+        return id && *id == name;
+    }
     Nullable<std::u16string> id = e.getAttribute(u"id");
     if (!id.hasValue())
         return false;
@@ -176,6 +303,10 @@ bool CSSIDSelector::match(Element& e, ViewCSSImp* view, bool dynamic)
 
 bool CSSClassSelector::match(Element& e, ViewCSSImp* view, bool dynamic)
 {
+    if (ElementImp* element = dynamic_cast<ElementImp*>(e.self())) {
+        const std::u16string* classes = element->findAttribute(u"class");
+        return classes && contains(*classes, name);
+    }
     Nullable<std::u16string> classes = e.getAttribute(u"class");
     if (!classes.hasValue())
         return false;
@@ -240,6 +371,11 @@ bool CSSSelector::match(Element& element, ViewCSSImp* view, bool dynamic)
             }
             if (!e)
                 return false;
+            if (!dynamic && view && (*i)->hasDynamicPseudoClassSelector()) {
+                // Any of the further ancestors could match instead of e once its state changes.
+                for (Element a = e.getParentElement(); a; a = a.getParentElement())
+                    (*i)->match(a, view, dynamic);
+            }
             break;
         case CSSPrimarySelector::Child:
             e = e.getParentElement();
@@ -258,6 +394,10 @@ bool CSSSelector::match(Element& element, ViewCSSImp* view, bool dynamic)
             }
             if (!e)
                 return false;
+            if (!dynamic && view && (*i)->hasDynamicPseudoClassSelector()) {
+                for (Element s = e.getPreviousElementSibling(); s; s = s.getPreviousElementSibling())
+                    (*i)->match(s, view, dynamic);
+            }
             break;
         default:
             return false;
@@ -286,7 +426,7 @@ bool CSSPseudoClassSelector::match(Element& element, ViewCSSImp* view, bool dyna
             // It it the responsibility of the reflow and repaint operation to actually
             // check the status of each element.
             if (view)
-                view->hoverList.push_back(element.self());
+                view->getDynamicList().push_back(std::make_pair(element.self(), id));
             return true;
         } else if (view)
             return view->isHovered(element);
@@ -296,17 +436,21 @@ bool CSSPseudoClassSelector::match(Element& element, ViewCSSImp* view, bool dyna
             return true;
         break;
     case Active:
-        if (!dynamic)
+        if (!dynamic) {
+            if (view)
+                view->getDynamicList().push_back(std::make_pair(element.self(), id));
             return true;
-        else {
+        } else {
             // TODO: Implement me!
             return false;
         }
         break;
     case Focus:
-        if (!dynamic)
+        if (!dynamic) {
+            if (view)
+                view->getDynamicList().push_back(std::make_pair(element.self(), id));
             return true;
-        else {
+        } else {
             Document document = element.getOwnerDocument();
             return document.hasFocus() && document.getActiveElement() == element;
         }
@@ -365,6 +509,13 @@ bool CSSPrimarySelector::hasPseudoClassSelector(int type) const
     return false;
 }
 
+bool CSSPrimarySelector::hasDynamicPseudoClassSelector() const
+{
+    return hasPseudoClassSelector(CSSPseudoClassSelector::Hover) ||
+           hasPseudoClassSelector(CSSPseudoClassSelector::Active) ||
+           hasPseudoClassSelector(CSSPseudoClassSelector::Focus);
+}
+
 bool CSSSelector::hasPseudoClassSelector(int type) const
 {
     for (auto i = simpleSelectors.begin(); i != simpleSelectors.end(); ++i) {
@@ -410,6 +561,44 @@ void CSSPrimarySelector::registerToRuleList(CSSRuleListImp* ruleList, CSSSelecto
         ruleList->appendMisc(selector, declaration);
 }
 
+// Chooses the key in the same order of preference as registerToRuleList().
+int CSSPrimarySelector::getKey(std::u16string& key, bool& keyOnly) const
+{
+    keyOnly = false;
+    for (auto i = chain.begin(); i != chain.end(); ++i) {
+        if (CSSIDSelector* idSelector = dynamic_cast<CSSIDSelector*>(*i)) {
+            key = idSelector->getName();
+            keyOnly = (name == u"*" && chain.size() == 1);
+            return CSSSelector::IDKey;
+        }
+    }
+    for (auto i = chain.begin(); i != chain.end(); ++i) {
+        if (CSSClassSelector* classSelector = dynamic_cast<CSSClassSelector*>(*i)) {
+            key = classSelector->getName();
+            keyOnly = (name == u"*" && chain.size() == 1);
+            return CSSSelector::ClassKey;
+        }
+    }
+    if (name != u"*") {
+        key = name;
+        return CSSSelector::TypeKey;
+    }
+    key.clear();
+    return CSSSelector::NoKey;
+}
+
+void CSSSelector::compile()
+{
+    keyType = NoKey;
+    key.clear();
+    keyOnly = false;
+    if (simpleSelectors.empty())
+        return;
+    keyType = simpleSelectors.back()->getKey(key, keyOnly);
+    if (1 < simpleSelectors.size())
+        keyOnly = false;
+}
+
 CSSPseudoElementSelector* CSSPrimarySelector::getPseudoElement() const
 {
     if (chain.empty())
@@ -38,6 +38,7 @@ namespace bootstrap {
 
 class CSSRuleListImp;
 class CSSSelector;
+class CSSSnapshotWriter;
 class ViewCSSImp;
 
 class CSSSpecificity
@@ -100,6 +101,7 @@ public:
         text += CSSSerializeIdentifier(name);
     }
     virtual CSSSpecificity getSpecificity() = 0;
+    virtual void write(CSSSnapshotWriter& writer) = 0;
     virtual bool match(Element& element, ViewCSSImp* view, bool dynamic) {
         return false;
     }
@@ -162,11 +164,14 @@ public:
     }
     virtual void serialize(std::u16string& text);
     virtual CSSSpecificity getSpecificity();
+    virtual void write(CSSSnapshotWriter& writer);
     virtual bool match(Element& element, ViewCSSImp* view, bool dynamic);
     virtual bool isValid() const;
     virtual bool hasPseudoClassSelector(int type) const;
+    bool hasDynamicPseudoClassSelector() const;
     void registerToRuleList(CSSRuleListImp* ruleList, CSSSelector* selector, CSSStyleDeclarationImp* declaration);
     CSSPseudoElementSelector* getPseudoElement() const;
+    int getKey(std::u16string& key, bool& keyOnly) const;
 };
 
 // '#' IDENT
@@ -182,6 +187,7 @@ public:
     virtual CSSSpecificity getSpecificity() {
         return CSSSpecificity(1, 0, 0);
     }
+    virtual void write(CSSSnapshotWriter& writer);
     virtual bool match(Element& element, ViewCSSImp* view, bool dynamic);
     virtual bool isValid() const {
         return !name.empty();
@@ -201,6 +207,7 @@ public:
     virtual CSSSpecificity getSpecificity() {
             return CSSSpecificity(0, 1, 0);
     }
+    virtual void write(CSSSnapshotWriter& writer);
     virtual bool match(Element& element, ViewCSSImp* view, bool dynamic);
     virtual bool isValid() const {
         return !name.empty();
@@ -263,12 +270,16 @@ public:
     virtual CSSSpecificity getSpecificity() {
             return CSSSpecificity(0, 1, 0);
     }
+    virtual void write(CSSSnapshotWriter& writer);
     virtual bool match(Element& element, ViewCSSImp* view, bool dynamic);
 };
 
 class CSSPseudoSelector : public CSSSimpleSelector
 {
     CSSParserExpr* expression;
+    std::u16string expressionText;  // the text of expression if copied by copyExpressionText()
+protected:
+    void writeFunction(CSSSnapshotWriter& writer);
 public:
     CSSPseudoSelector(const std::u16string& ident) :
         CSSSimpleSelector(ident) {
@@ -285,6 +296,10 @@ public:
             text += u'(' + expression->getCssText() + u')';
     }
 
+    // Copies the text referred to by the expression so that the expression
+    // no longer depends on the buffer it was parsed from.
+    void copyExpressionText();
+
     enum Type {
         PseudoClass,
         PseudoElement
@@ -330,6 +345,7 @@ public:
     virtual CSSSpecificity getSpecificity() {
         return CSSSpecificity(0, 1, 0);
     }
+    virtual void write(CSSSnapshotWriter& writer);
     virtual bool match(Element& element, ViewCSSImp* view, bool dynamic);
     virtual bool isValid() const {
         return id != Unknown;
@@ -355,6 +371,7 @@ public:
         toLower(this->lang);    // TODO: html only
     }
     virtual void serialize(std::u16string& text);
+    virtual void write(CSSSnapshotWriter& writer);
     virtual bool match(Element& element, ViewCSSImp* view, bool dynamic);
 };
 
@@ -371,6 +388,7 @@ public:
         b(b) {
     }
     virtual void serialize(std::u16string& text);
+    virtual void write(CSSSnapshotWriter& writer);
 };
 
 // ::
@@ -403,6 +421,7 @@ public:
     virtual CSSSpecificity getSpecificity() {
         return CSSSpecificity(0, 0, 1);
     }
+    virtual void write(CSSSnapshotWriter& writer);
     virtual bool match(Element& element, ViewCSSImp* view, bool dynamic) {
         return id != Unknown;
     }
@@ -432,6 +451,7 @@ public:
     virtual CSSSpecificity getSpecificity() {
         return selector->getSpecificity();
     }
+    virtual void write(CSSSnapshotWriter& writer);
     virtual bool isValid() const {
         return selector && selector->isValid();
     }
@@ -439,19 +459,46 @@ public:
 
 class CSSSelector
 {
+public:
+    // Key types of the rightmost compound selector; cf. compile()
+    enum
+    {
+        NoKey,
+        IDKey,
+        ClassKey,
+        TypeKey
+    };
+
+private:
     std::deque<CSSPrimarySelector*> simpleSelectors;
+    int keyType;
+    std::u16string key;
+    bool keyOnly;   // true if an element having the key always matches this selector
+    bool hasSpecificity;
+    CSSSpecificity specificity;
+
 public:
-    CSSSelector(CSSPrimarySelector* simpleSelector) {
+    CSSSelector(CSSPrimarySelector* simpleSelector) :
+        keyType(NoKey),
+        keyOnly(false),
+        hasSpecificity(false)
+    {
         simpleSelectors.push_back(simpleSelector);
     }
     void append(int combinator, CSSPrimarySelector* simpleSelector) {
         if (simpleSelector) {
             simpleSelector->setCombinator(combinator);
             simpleSelectors.push_back(simpleSelector);
+            hasSpecificity = false;
         }
     }
     void serialize(std::u16string& text);
     CSSSpecificity getSpecificity();
+    void setSpecificity(const CSSSpecificity& value) {
+        specificity = value;
+        hasSpecificity = true;
+    }
+    void write(CSSSnapshotWriter& writer);
 
     bool match(Element& element, ViewCSSImp* view, bool dynamic);
     CSSPseudoElementSelector* getPseudoElement() const;
@@ -462,6 +509,20 @@ public:
         return hasPseudoClassSelector(CSSPseudoClassSelector::Hover);
     }
     void registerToRuleList(CSSRuleListImp* ruleList, CSSStyleDeclarationImp* declaration);
+
+    // compile() precomputes the key of the rightmost compound selector so that
+    // candidate elements can be looked up from the document indexes before
+    // running the right-to-left match.
+    void compile();
+    int getKeyType() const {
+        return keyType;
+    }
+    const std::u16string& getKey() const {
+        return key;
+    }
+    bool isKeyOnly() const {
+        return keyOnly;
+    }
 };
 
 class CSSSelectorsGroup
@@ -501,6 +562,17 @@ public:
         }
         return false;
     }
+
+    void compile() {
+        for (auto i = selectors.begin(); i != selectors.end(); ++i)
+            (*i)->compile();
+    }
+    size_t getLength() const {
+        return selectors.size();
+    }
+    CSSSelector* getSelector(size_t index) const {
+        return selectors[index];
+    }
 };
 
 }}}}  // org::w3c::dom::bootstrap
@@ -0,0 +1,510 @@
+/*
+ * Copyright 2013 Esrille Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "CSSSnapshot.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include <org/w3c/dom/css/CSSPrimitiveValue.h>
+
+#include "CSSMediaRuleImp.h"
+#include "CSSRuleListImp.h"
+#include "CSSSelector.h"
+#include "CSSStyleDeclarationImp.h"
+#include "CSSStyleRuleImp.h"
+#include "CSSStyleSheetImp.h"
+#include "utf.h"
+
+namespace org { namespace w3c { namespace dom { namespace bootstrap {
+
+using namespace css;
+
+namespace
+{
+
+bool hasText(unsigned short unit)
+{
+    switch (unit) {
+    case CSSPrimitiveValue::CSS_STRING:
+    case CSSPrimitiveValue::CSS_URI:
+    case CSSPrimitiveValue::CSS_IDENT:
+    case CSSPrimitiveValue::CSS_UNICODE_RANGE:
+    case CSSPrimitiveValue::CSS_RGBCOLOR:
+    case CSSPrimitiveValue::CSS_DIMENSION:
+    case CSSParserTerm::CSS_TERM_FUNCTION:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void deleteExpr(CSSParserExpr* expr)
+{
+    for (auto i = expr->list.begin(); i != expr->list.end(); ++i) {
+        if (i->unit == CSSParserTerm::CSS_TERM_FUNCTION && i->expr)
+            deleteExpr(i->expr);
+    }
+    delete expr;
+}
+
+// Returns the 64-bit FNV-1a hash of the contents of the specified file.
+bool hashFile(const std::string& path, uint64_t& size, uint64_t& hash)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+        return false;
+    size = 0;
+    hash = 14695981039346656037ull;
+    char buffer[8192];
+    ssize_t length;
+    while (0 < (length = read(fd, buffer, sizeof buffer))) {
+        for (ssize_t i = 0; i < length; ++i) {
+            hash ^= static_cast<unsigned char>(buffer[i]);
+            hash *= 1099511628211ull;
+        }
+        size += length;
+    }
+    close(fd);
+    return length == 0;
+}
+
+}
+
+//
+// CSSSnapshotWriter
+//
+
+void CSSSnapshotWriter::writeNumber(double value)
+{
+    uint32_t w[2];
+    static_assert(sizeof w == sizeof value, "unexpected size of double");
+    std::memcpy(w, &value, sizeof w);
+    output->push_back(w[0]);
+    output->push_back(w[1]);
+}
+
+void CSSSnapshotWriter::writeString(const char16_t* text, size_t length)
+{
+    output->push_back(length);
+    for (size_t i = 0; i < length; i += 2) {
+        uint32_t w = 0;
+        std::memcpy(&w, text + i, (i + 1 < length) ? 4 : 2);
+        output->push_back(w);
+    }
+}
+
+void CSSSnapshotWriter::writeExpr(CSSParserExpr* expr)
+{
+    writeUnsigned(expr->list.size());
+    for (auto i = expr->list.begin(); i != expr->list.end(); ++i) {
+        CSSParserTerm& term(*i);
+        writeInteger(term.op);
+        writeUnsigned(term.unit);
+        writeNumber(term.number.number);
+        writeUnsigned(term.number.integer);
+        writeUnsigned(term.rgb);
+        if (hasText(term.unit))
+            writeString(term.text.text, term.text.length);
+        if (term.unit == CSSParserTerm::CSS_TERM_FUNCTION) {
+            writeUnsigned(term.expr ? 1 : 0);
+            if (term.expr)
+                writeExpr(term.expr);
+        }
+    }
+}
+
+void CSSSnapshotWriter::appendProperty(int id, CSSParserExpr* expr, const std::u16string& prio)
+{
+    pending.clear();
+    output = &pending;
+    writeInteger(id);
+    writeString(prio);
+    writeExpr(expr);
+    output = &words;
+}
+
+void CSSSnapshotWriter::commitAppend(const CSSStyleDeclarationImp* decl)
+{
+    Declaration& declaration = declarations[decl];
+    ++declaration.count;
+    declaration.words.insert(declaration.words.end(), pending.begin(), pending.end());
+}
+
+void CSSSnapshotWriter::writeStyleRule(CSSStyleRuleImp* rule)
+{
+    writeUnsigned(CSSSnapshot::StyleRule);
+    CSSSelectorsGroup* selectorsGroup = rule->getSelectorsGroup();
+    writeUnsigned(selectorsGroup->getLength());
+    for (auto i = selectorsGroup->begin(); i != selectorsGroup->end(); ++i)
+        (*i)->write(*this);
+    auto found = declarations.find(dynamic_cast<CSSStyleDeclarationImp*>(rule->getStyle().self()));
+    if (found == declarations.end()) {
+        writeUnsigned(0);
+        return;
+    }
+    writeUnsigned(found->second.count);
+    output->insert(output->end(), found->second.words.begin(), found->second.words.end());
+}
+
+bool CSSSnapshotWriter::writeRule(css::CSSRule rule)
+{
+    if (CSSStyleRuleImp* styleRule = dynamic_cast<CSSStyleRuleImp*>(rule.self())) {
+        writeStyleRule(styleRule);
+        return true;
+    }
+    if (CSSMediaRuleImp* mediaRule = dynamic_cast<CSSMediaRuleImp*>(rule.self())) {
+        CSSRuleListImp* ruleList = dynamic_cast<CSSRuleListImp*>(mediaRule->getCssRules().self());
+        if (!ruleList)
+            return false;
+        writeUnsigned(CSSSnapshot::MediaRule);
+        writeString(mediaRule->getMedia().getMediaText());
+        writeUnsigned(ruleList->getLength());
+        for (unsigned i = 0; i < ruleList->getLength(); ++i) {
+            CSSStyleRuleImp* styleRule = dynamic_cast<CSSStyleRuleImp*>(ruleList->item(i).self());
+            if (!styleRule)
+                return false;
+            writeStyleRule(styleRule);
+        }
+        return true;
+    }
+    return false;
+}
+
+bool CSSSnapshotWriter::write(const std::string& snapshotPath, const std::string& sourcePath, CSSStyleSheetImp* styleSheet)
+{
+    uint64_t size;
+    uint64_t hash;
+    if (!styleSheet || !hashFile(sourcePath, size, hash))
+        return false;
+    CSSRuleListImp* ruleList = dynamic_cast<CSSRuleListImp*>(styleSheet->getCssRules().self());
+    if (!ruleList)
+        return false;
+
+    words.clear();
+    writeUnsigned(CSSSnapshot::Signature);
+    writeUnsigned(CSSSnapshot::Version);
+    writeUnsigned(size);
+    writeUnsigned(size >> 32);
+    writeUnsigned(hash);
+    writeUnsigned(hash >> 32);
+    writeString(utfconv(sourcePath));
+    writeUnsigned(ruleList->getLength());
+    for (unsigned i = 0; i < ruleList->getLength(); ++i) {
+        if (!writeRule(ruleList->item(i)))
+            return false;
+    }
+
+    std::string tmp = snapshotPath + ".tmp";
+    std::ofstream stream(tmp.c_str(), std::ios::binary);
+    stream.write(reinterpret_cast<const char*>(words.data()), words.size() * sizeof(uint32_t));
+    stream.close();
+    if (!stream || rename(tmp.c_str(), snapshotPath.c_str()) == -1) {
+        remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+//
+// CSSSnapshotReader
+//
+
+double CSSSnapshotReader::readNumber()
+{
+    uint32_t w[2];
+    w[0] = readUnsigned();
+    w[1] = readUnsigned();
+    double value;
+    std::memcpy(&value, w, sizeof value);
+    return value;
+}
+
+CSSParserString CSSSnapshotReader::readText()
+{
+    CSSParserString text = { u"", 0 };
+    size_t length = readUnsigned();
+    size_t count = (length + 1) / 2;
+    if (error || static_cast<size_t>(end - current) < count) {
+        error = true;
+        return text;
+    }
+    // The text is referred to in place; cf. read().
+    text.text = reinterpret_cast<const char16_t*>(current);
+    text.length = length;
+    current += count;
+    return text;
+}
+
+CSSParserExpr* CSSSnapshotReader::readExpr()
+{
+    CSSParserExpr* expr = new(std::nothrow) CSSParserExpr;
+    if (!expr) {
+        error = true;
+        return 0;
+    }
+    for (unsigned count = readUnsigned(); 0 < count && !error; --count) {
+        CSSParserTerm term;
+        term.op = readInteger();
+        term.unit = readUnsigned();
+        term.number.number = readNumber();
+        term.number.integer = readUnsigned();
+        term.rgb = readUnsigned();
+        term.text = { u"", 0 };
+        if (hasText(term.unit))
+            term.text = readText();
+        term.expr = 0;
+        if (term.unit == CSSParserTerm::CSS_TERM_FUNCTION && readUnsigned())
+            term.expr = readExpr();
+        term.propertyID = 0;
+        term.parser = &parser;
+        expr->push_back(term);
+    }
+    if (error) {
+        deleteExpr(expr);
+        return 0;
+    }
+    return expr;
+}
+
+CSSSimpleSelector* CSSSnapshotReader::readSimpleSelector()
+{
+    switch (readUnsigned()) {
+    case CSSSnapshot::PrimarySelector:
+        return readPrimarySelector();
+    case CSSSnapshot::IDSelector:
+        return new(std::nothrow) CSSIDSelector(readString());
+    case CSSSnapshot::ClassSelector:
+        return new(std::nothrow) CSSClassSelector(readString());
+    case CSSSnapshot::AttributeSelector: {
+        std::u16string namespacePrefix = readString();
+        std::u16string name = readString();
+        int op = readInteger();
+        std::u16string value = readString();
+        std::u16string flags = readString();
+        return new(std::nothrow) CSSAttributeSelector(namespacePrefix, name, op, value, flags);
+    }
+    case CSSSnapshot::PseudoClassSelector: {
+        int id = readInteger();
+        CSSParserTerm function;
+        function.unit = CSSParserTerm::CSS_TERM_FUNCTION;
+        function.text = readText();
+        if (!readUnsigned())
+            return new(std::nothrow) CSSPseudoClassSelector(std::u16string(function.text.text, function.text.length), id);
+        function.expr = readExpr();
+        if (!function.expr)
+            break;
+        if (CSSPseudoClassSelector* selector = new(std::nothrow) CSSPseudoClassSelector(function, id)) {
+            // The selector outlives the mapping; cf. read().
+            selector->copyExpressionText();
+            return selector;
+        }
+        deleteExpr(function.expr);
+        break;
+    }
+    case CSSSnapshot::LangPseudoClassSelector:
+        return new(std::nothrow) CSSLangPseudoClassSelector(readString());
+    case CSSSnapshot::NthPseudoClassSelector: {
+        int id = readInteger();
+        long a = readInteger();
+        long b = readInteger();
+        return new(std::nothrow) CSSNthPseudoClassSelector(a, b, id);
+    }
+    case CSSSnapshot::PseudoElementSelector:
+        return new(std::nothrow) CSSPseudoElementSelector(readInteger());
+    case CSSSnapshot::NegationPseudoClassSelector:
+        if (CSSSimpleSelector* selector = readSimpleSelector())
+            return new(std::nothrow) CSSNegationPseudoClassSelector(selector);
+        break;
+    default:
+        break;
+    }
+    error = true;
+    return 0;
+}
+
+CSSPrimarySelector* CSSSnapshotReader::readPrimarySelector()
+{
+    int combinator = readInteger();
+    std::u16string namespacePrefix = readString();
+    std::u16string name = readString();
+    CSSPrimarySelector* primary = new(std::nothrow) CSSPrimarySelector(namespacePrefix, name);
+    if (!primary) {
+        error = true;
+        return 0;
+    }
+    if (combinator != CSSPrimarySelector::None)
+        primary->setCombinator(combinator);
+    for (unsigned count = readUnsigned(); 0 < count && !error; --count)
+        primary->append(readSimpleSelector());
+    return primary;
+}
+
+CSSSelectorsGroup* CSSSnapshotReader::readSelectorsGroup()
+{
+    CSSSelectorsGroup* selectorsGroup = 0;
+    for (unsigned count = readUnsigned(); 0 < count && !error; --count) {
+        unsigned specificity = readUnsigned();
+        CSSSelector* selector = 0;
+        for (unsigned length = readUnsigned(); 0 < length && !error; --length) {
+            if (readUnsigned() != CSSSnapshot::PrimarySelector) {
+                error = true;
+                break;
+            }
+            CSSPrimarySelector* primary = readPrimarySelector();
+            if (!primary)
+                break;
+            if (!selector)
+                selector = new(std::nothrow) CSSSelector(primary);
+            else
+                selector->append(primary->getCombinator(), primary);
+        }
+        if (!selector) {
+            error = true;
+            break;
+        }
+        selector->setSpecificity(CSSSpecificity(specificity >> 16, specificity >> 8, specificity));
+        if (!selectorsGroup)
+            selectorsGroup = new(std::nothrow) CSSSelectorsGroup(selector);
+        else
+            selectorsGroup->append(selector);
+    }
+    if (!selectorsGroup)
+        error = true;
+    return selectorsGroup;
+}
+
+CSSStyleDeclarationImp* CSSSnapshotReader::readDeclaration()
+{
+    CSSStyleDeclarationImp* decl = new(std::nothrow) CSSStyleDeclarationImp;
+    if (!decl) {
+        error = true;
+        return 0;
+    }
+    for (unsigned count = readUnsigned(); 0 < count && !error; --count) {
+        int id = readInteger();
+        std::u16string prio = readString();
+        if (CSSParserExpr* expr = readExpr()) {
+            decl->setProperty(id, expr, prio);
+            deleteExpr(expr);
+        }
+    }
+    return decl;
+}
+
+CSSStyleRuleImp* CSSSnapshotReader::readStyleRule()
+{
+    CSSSelectorsGroup* selectorsGroup = readSelectorsGroup();
+    if (error) {
+        delete selectorsGroup;
+        return 0;
+    }
+    CSSStyleDeclarationImp* decl = readDeclaration();
+    if (error) {
+        delete selectorsGroup;
+        delete decl;
+        return 0;
+    }
+    return new(std::nothrow) CSSStyleRuleImp(selectorsGroup, decl);
+}
+
+css::CSSRule CSSSnapshotReader::readRule()
+{
+    switch (readUnsigned()) {
+    case CSSSnapshot::StyleRule:
+        return readStyleRule();
+    case CSSSnapshot::MediaRule:
+        if (CSSMediaRuleImp* mediaRule = new(std::nothrow) CSSMediaRuleImp) {
+            css::CSSRule rule(mediaRule);
+            mediaRule->setMedia(readString());
+            for (unsigned count = readUnsigned(); 0 < count && !error; --count) {
+                if (readUnsigned() != CSSSnapshot::StyleRule) {
+                    error = true;
+                    break;
+                }
+                if (CSSStyleRuleImp* styleRule = readStyleRule())
+                    mediaRule->append(styleRule);
+            }
+            return rule;
+        }
+        break;
+    default:
+        break;
+    }
+    error = true;
+    return 0;
+}
+
+css::CSSStyleSheet CSSSnapshotReader::readStyleSheet(const std::string& sourcePath)
+{
+    if (readUnsigned() != CSSSnapshot::Signature || readUnsigned() != CSSSnapshot::Version)
+        return 0;
+    uint64_t size = readUnsigned();
+    size |= static_cast<uint64_t>(readUnsigned()) << 32;
+    uint64_t hash = readUnsigned();
+    hash |= static_cast<uint64_t>(readUnsigned()) << 32;
+    if (readString() != utfconv(sourcePath) || error)
+        return 0;
+    uint64_t sourceSize;
+    uint64_t sourceHash;
+    if (!hashFile(sourcePath, sourceSize, sourceHash) || size != sourceSize || hash != sourceHash)
+        return 0;
+
+    CSSStyleSheetImp* styleSheet = new(std::nothrow) CSSStyleSheetImp;
+    if (!styleSheet)
+        return 0;
+    css::CSSStyleSheet sheet(styleSheet);
+    for (unsigned count = readUnsigned(); 0 < count && !error; --count) {
+        css::CSSRule rule = readRule();
+        if (!error)
+            styleSheet->append(rule, 0);
+    }
+    if (error || current != end)
+        return 0;
+    return sheet;
+}
+
+css::CSSStyleSheet CSSSnapshotReader::read(const std::string& snapshotPath, const std::string& sourcePath)
+{
+    int fd = open(snapshotPath.c_str(), O_RDONLY);
+    if (fd == -1)
+        return 0;
+    struct stat st;
+    if (fstat(fd, &st) == -1 || st.st_size == 0 || st.st_size % sizeof(uint32_t)) {
+        close(fd);
+        return 0;
+    }
+    void* map = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return 0;
+    const uint32_t* begin = static_cast<const uint32_t*>(map);
+    CSSSnapshotReader reader(begin, begin + st.st_size / sizeof(uint32_t));
+    css::CSSStyleSheet sheet = reader.readStyleSheet(sourcePath);
+    // The parser terms refer to the text in the mapping only while the
+    // declarations are replayed. The pseudo-class selectors keep copies of
+    // their expression text.
+    munmap(map, st.st_size);
+    return sheet;
+}
+
+}}}}  // org::w3c::dom::bootstrap
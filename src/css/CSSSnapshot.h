@@ -0,0 +1,161 @@
+/*
+ * Copyright 2013 Esrille Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ES_CSSSNAPSHOT_H
+#define ES_CSSSNAPSHOT_H
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <org/w3c/dom/css/CSSRule.h>
+#include <org/w3c/dom/css/CSSStyleSheet.h>
+
+#include "CSSParser.h"
+
+namespace org { namespace w3c { namespace dom { namespace bootstrap {
+
+class CSSPrimarySelector;
+class CSSSelectorsGroup;
+class CSSSimpleSelector;
+class CSSStyleDeclarationImp;
+class CSSStyleRuleImp;
+class CSSStyleSheetImp;
+
+// A style sheet snapshot is a binary image of a parsed style sheet that can be
+// mapped into memory and turned back into a CSSStyleSheetImp without running
+// the tokenizer and the grammar. Declarations are kept as the expressions the
+// parser produced, and are replayed through CSSStyleDeclarationImp::setProperty()
+// upon loading. The snapshot is tied to the size and the hash of the contents
+// of its source file, and is discarded once the source file has been changed.
+//
+// Note only style rules and @media rules are supported; style sheets having
+// any other kind of rules are not snapshotted.
+class CSSSnapshot
+{
+public:
+    static const uint32_t Signature = 0x73736345;  // "Ecss"
+    static const uint32_t Version = 2;
+
+    // Tags
+    enum
+    {
+        PrimarySelector = 1,
+        IDSelector,
+        ClassSelector,
+        AttributeSelector,
+        PseudoClassSelector,
+        LangPseudoClassSelector,
+        NthPseudoClassSelector,
+        PseudoElementSelector,
+        NegationPseudoClassSelector,
+
+        StyleRule = 32,
+        MediaRule
+    };
+};
+
+class CSSSnapshotWriter
+{
+    struct Declaration
+    {
+        unsigned count;
+        std::vector<uint32_t> words;
+    };
+
+    std::vector<uint32_t> words;
+    std::vector<uint32_t> pending;
+    std::vector<uint32_t>* output;
+    std::map<const CSSStyleDeclarationImp*, Declaration> declarations;
+
+    bool writeRule(css::CSSRule rule);
+    void writeStyleRule(CSSStyleRuleImp* rule);
+
+public:
+    CSSSnapshotWriter() :
+        output(&words)
+    {
+    }
+
+    // Called back by CSSStyleDeclarationImp::commitAppend() while parsing
+    void appendProperty(int id, CSSParserExpr* expr, const std::u16string& prio);
+    void commitAppend(const CSSStyleDeclarationImp* decl);
+
+    void writeUnsigned(uint32_t value) {
+        output->push_back(value);
+    }
+    void writeInteger(int value) {
+        output->push_back(static_cast<uint32_t>(value));
+    }
+    void writeNumber(double value);
+    void writeString(const char16_t* text, size_t length);
+    void writeString(const std::u16string& text) {
+        writeString(text.c_str(), text.length());
+    }
+    void writeExpr(CSSParserExpr* expr);
+
+    bool write(const std::string& snapshotPath, const std::string& sourcePath, CSSStyleSheetImp* styleSheet);
+};
+
+class CSSSnapshotReader
+{
+    const uint32_t* current;
+    const uint32_t* end;
+    bool error;
+    CSSParser parser;
+
+    CSSSnapshotReader(const uint32_t* begin, const uint32_t* end) :
+        current(begin),
+        end(end),
+        error(false)
+    {
+    }
+
+    uint32_t readUnsigned() {
+        if (end <= current) {
+            error = true;
+            return 0;
+        }
+        return *current++;
+    }
+    int readInteger() {
+        return static_cast<int>(readUnsigned());
+    }
+    double readNumber();
+    CSSParserString readText();
+    std::u16string readString() {
+        CSSParserString text = readText();
+        return std::u16string(text.text, text.length);
+    }
+    CSSParserExpr* readExpr();
+    CSSSimpleSelector* readSimpleSelector();
+    CSSPrimarySelector* readPrimarySelector();
+    CSSSelectorsGroup* readSelectorsGroup();
+    CSSStyleDeclarationImp* readDeclaration();
+    CSSStyleRuleImp* readStyleRule();
+    css::CSSRule readRule();
+    css::CSSStyleSheet readStyleSheet(const std::string& sourcePath);
+
+public:
+    // Returns 0 if there is no valid snapshot of the source file.
+    static css::CSSStyleSheet read(const std::string& snapshotPath, const std::string& sourcePath);
+};
+
+}}}}  // org::w3c::dom::bootstrap
+
+#endif  // ES_CSSSNAPSHOT_H
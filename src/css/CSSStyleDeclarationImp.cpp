@@ -20,6 +20,7 @@
 #include <org/w3c/dom/html/HTMLBodyElement.h>
 
 #include "CSSPropertyValueImp.h"
+#include "CSSSnapshot.h"
 #include "CSSValueParser.h"
 #include "DocumentImp.h"
 #include "MutationEventImp.h"
@@ -210,6 +211,7 @@ CSSStyleDeclarationBoard::CSSStyleDeclarationBoard(CSSStyleDeclarationImp* style
     top.specify(style->top);
     unicodeBidi.specify(style->unicodeBidi);
     verticalAlign.specify(style->verticalAlign);
+    visibility.specify(style->visibility);
     whiteSpace.specify(style->whiteSpace);
     wordSpacing.specify(style->wordSpacing);
     width.specify(style->width);
@@ -271,6 +273,7 @@ void CSSStyleDeclarationImp::restoreComputedValues(CSSStyleDeclarationBoard& boa
     top.specify(board.top);
     unicodeBidi.specify(board.unicodeBidi);
     verticalAlign.specify(board.verticalAlign);
+    visibility.specify(board.visibility);
     whiteSpace.specify(board.whiteSpace);
     wordSpacing.specify(board.wordSpacing);
     width.specify(board.width);
@@ -310,6 +313,9 @@ unsigned CSSStyleDeclarationBoard::compare(CSSStyleDeclarationImp* style)
         flags |= Box::NEED_EXPANSION;
     if (style->position != position)
         flags |= Box::NEED_EXPANSION;
+    // 'visibility: collapse' removes table rows and columns.
+    if ((style->visibility.getValue() == CSSVisibilityValueImp::Collapse) != (visibility.getValue() == CSSVisibilityValueImp::Collapse))
+        flags |= Box::NEED_EXPANSION;
 #if 0  // TODO: Check following properties
     binding;
 #endif
@@ -886,10 +892,17 @@ int CSSStyleDeclarationImp::appendProperty(const std::u16string& property, CSSPa
     return propertyID;
 }
 
-int CSSStyleDeclarationImp::commitAppend()
+int CSSStyleDeclarationImp::commitAppend(CSSSnapshotWriter* snapshotWriter)
 {
-    if (propertyID)
+    if (propertyID) {
+        // Note the expression needs to be recorded before it is validated as
+        // CSSValueParser rewrites the terms in place.
+        if (snapshotWriter)
+            snapshotWriter->appendProperty(propertyID, expression, priority);
         propertyID = setProperty(propertyID, expression, priority);
+        if (snapshotWriter && propertyID)
+            snapshotWriter->commitAppend(this);
+    }
     return propertyID;
 }
 
@@ -1737,7 +1750,7 @@ void CSSStyleDeclarationImp::compute(ViewCSSImp* view, CSSStyleDeclarationImp* p
         if (htmlElement)
             elementDecl = dynamic_cast<CSSStyleDeclarationImp*>(htmlElement.getStyle().self());
         // Normal declarations
-        for (auto i = ruleSet.begin(); i != ruleSet.end(); ++i) {
+        for (auto i = matchedRules.begin(); i != matchedRules.end(); ++i) {
             if (CSSStyleDeclarationImp* pseudo = createPseudoElementStyle(i->getPseudoElementID())) {
                 if (i->isActive(element, view))
                     pseudo->specify(i->getDeclaration());
@@ -1746,7 +1759,7 @@ void CSSStyleDeclarationImp::compute(ViewCSSImp* view, CSSStyleDeclarationImp* p
         if (elementDecl)
             specify(elementDecl);
         // Author important declarations
-        for (auto i = ruleSet.begin(); i != ruleSet.end(); ++i) {
+        for (auto i = matchedRules.begin(); i != matchedRules.end(); ++i) {
             if (CSSStyleDeclarationImp* pseudo = createPseudoElementStyle(i->getPseudoElementID())) {
                 if (i->isActive(element, view) && !i->isUserStyle())
                     pseudo->specifyImportant(i->getDeclaration());
@@ -1755,7 +1768,7 @@ void CSSStyleDeclarationImp::compute(ViewCSSImp* view, CSSStyleDeclarationImp* p
         if (elementDecl)
             specifyImportant(elementDecl);
         // User important declarations
-        for (auto i = ruleSet.begin(); i != ruleSet.end(); ++i) {
+        for (auto i = matchedRules.begin(); i != matchedRules.end(); ++i) {
             if (CSSStyleDeclarationImp* pseudo = createPseudoElementStyle(i->getPseudoElementID())) {
                 if (i->isActive(element, view) && i->isUserStyle())
                     pseudo->specifyImportant(i->getDeclaration());
@@ -2357,14 +2370,71 @@ CSSStyleDeclarationImp* CSSStyleDeclarationImp::createPseudoElementStyle(int id)
     return style;
 }
 
-CSSStyleDeclarationImp* CSSStyleDeclarationImp::getAffectedByHover() const
+bool CSSStyleDeclarationImp::isPaintProperty(int id)
 {
-    const CSSStyleDeclarationImp* affected = 0;
-    for (const CSSStyleDeclarationImp* style = this; style; style = style->parentStyle) {
-        if (style->affectedBits & (1u << CSSPseudoClassSelector::Hover))
-            affected = style;
+    switch (id) {
+    case Background:
+    case BackgroundAttachment:
+    case BackgroundColor:
+    case BackgroundImage:
+    case BackgroundPosition:
+    case BackgroundRepeat:
+    case BorderColor:
+    case BorderTopColor:
+    case BorderRightColor:
+    case BorderBottomColor:
+    case BorderLeftColor:
+    case Color:
+    case Cursor:
+    case Outline:
+    case OutlineColor:
+    case OutlineStyle:
+    case OutlineWidth:
+    case Visibility:
+    case Opacity:
+        return true;
+    default:
+        return false;
     }
-    return const_cast<CSSStyleDeclarationImp*>(affected);
+}
+
+bool CSSStyleDeclarationImp::isPaintMutation(int id, unsigned previousVisibility) const
+{
+    if (!isPaintProperty(id))
+        return false;
+    if (id == Visibility &&
+        (previousVisibility == CSSVisibilityValueImp::Collapse || visibility.getValue() == CSSVisibilityValueImp::Collapse))
+        return false;
+    return true;
+}
+
+bool CSSStyleDeclarationImp::hasPaintPropertiesOnly() const
+{
+    for (unsigned id = 1; id < MaxProperties; ++id) {
+        if (propertySet.test(id) && !isPaintProperty(id))
+            return false;
+    }
+    // 'visibility: collapse' affects the table layout.
+    if (propertySet.test(Visibility) && visibility.getValue() == CSSVisibilityValueImp::Collapse)
+        return false;
+    return true;
+}
+
+bool CSSStyleDeclarationImp::dependsForPaintOnly(unsigned bits) const
+{
+    for (auto i = matchedRules.begin(); i != matchedRules.end(); ++i) {
+        CSSSelector* selector = i->getSelector();
+        if (!selector)
+            continue;
+        for (int id = 0; bits >> id; ++id) {
+            if ((bits & (1u << id)) && selector->hasPseudoClassSelector(id)) {
+                if (!i->getDeclaration()->hasPaintPropertiesOnly())
+                    return false;
+                break;
+            }
+        }
+    }
+    return true;
 }
 
 std::u16string CSSStyleDeclarationImp::resolveRelativeURL(const std::u16string& url) const
@@ -2448,6 +2518,7 @@ std::u16string CSSStyleDeclarationImp::getPropertyPriority(const std::u16string&
 
 void CSSStyleDeclarationImp::setProperty(int id, Nullable<std::u16string> value, const std::u16string& prio)
 {
+    unsigned previous = visibility.getValue();
     if (!value.hasValue())
         removeProperty(id);
     else {
@@ -2469,9 +2540,9 @@ void CSSStyleDeclarationImp::setProperty(int id, Nullable<std::u16string> value,
         assert(getPseudoElementSelectorType() == CSSPseudoElementSelector::NonPseudo);
         html::HTMLElement element(owner);
         // Note the mutation event triggered by the following operation must be ignored in the element.
-        setFlags(Mutated);
+        setFlags(Mutated | (isPaintMutation(id, previous) ? PaintMutated : 0));
         element.setAttribute(u"style", getCssText());
-        clearFlags(Mutated);
+        clearFlags(Mutated | PaintMutated);
     }
 }
 
@@ -2520,13 +2591,15 @@ std::u16string CSSStyleDeclarationImp::removeProperty(int id)
 
 std::u16string CSSStyleDeclarationImp::removeProperty(const std::u16string& property)
 {
-    std::u16string result = removeProperty(getPropertyID(property));
+    int id = getPropertyID(property);
+    unsigned previous = visibility.getValue();
+    std::u16string result = removeProperty(id);
     if (owner && html::HTMLElement::hasInstance(owner)) {
         html::HTMLElement element(owner);
         // Note the mutation event triggered by the following operation must be ignored in the element.
-        setFlags(Mutated);
+        setFlags(Mutated | (isPaintMutation(id, previous) ? PaintMutated : 0));
         element.setAttribute(u"style", getCssText());
-        clearFlags(Mutated);
+        clearFlags(Mutated | PaintMutated);
     }
     return result;
 }
@@ -3891,8 +3964,7 @@ void CSSStyleDeclarationImp::clearProperties()
 
 void CSSStyleDeclarationImp::resetComputedStyle()
 {
-    ruleSet.clear();
-    affectedBits = 0;
+    matchedRules.clear();
     for (int i = CSSPseudoElementSelector::NonCSS; i < CSSPseudoElementSelector::MaxPseudoElements; ++i)
         pseudoElements[i] = 0;
     marker = before = after = 0;
@@ -3917,7 +3989,6 @@ CSSStyleDeclarationImp::CSSStyleDeclarationImp(int pseudoElementSelectorType) :
     propertyID(Unknown),
     expression(0),
     flags(0),
-    affectedBits(0),
     parentStyle(0),
     bodyStyle(0),
     emptyInline(0),
@@ -3960,7 +4031,6 @@ CSSStyleDeclarationImp::CSSStyleDeclarationImp(CSSStyleDeclarationImp* org) :
     propertyID(Unknown),
     expression(0),
     flags(0),
-    affectedBits(0),
     parentStyle(0),
     bodyStyle(0),
     emptyInline(0),
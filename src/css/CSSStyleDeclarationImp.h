@@ -101,6 +101,7 @@ struct CSSStyleDeclarationBoard
     CSSAutoLengthValueImp top;                              // TBD       R
     CSSUnicodeBidiValueImp unicodeBidi;                     // F
     CSSVerticalAlignValueImp verticalAlign;                 // F         R
+    CSSVisibilityValueImp visibility;                       // B
     CSSWhiteSpaceValueImp whiteSpace;                       // F
     CSSWordSpacingValueImp wordSpacing;                     // F
     CSSAutoLengthValueImp width;                            // F         R
@@ -288,7 +289,8 @@ public:
         Resolved = 0x02,
         ComputedStyle = 0x2000000,
         Mutated = 0x4000000,
-        NeedSelectorMatching = 0x8000000
+        NeedSelectorMatching = 0x8000000,
+        PaintMutated = 0x10000000   // Mutated only in paint properties
     };
 
 private:
@@ -312,8 +314,7 @@ private:
     //
     unsigned flags;
 
-    CSSRuleListImp::RuleSet ruleSet;
-    unsigned affectedBits;  // 1u << CSSPseudoClassSelector::Hover, etc.
+    CSSRuleListImp::MatchedRuleList matchedRules;
     CSSStyleDeclarationImp* parentStyle;
     CSSStyleDeclarationImp* bodyStyle;
     int emptyInline;    // 0: none, 1: first, 2: last, 3: both, 4: empty
@@ -494,9 +495,12 @@ public:
     bool isMutated() const {
         return flags & Mutated;
     }
+    bool isPaintMutated() const {
+        return flags & PaintMutated;
+    }
 
     int appendProperty(const std::u16string& property, CSSParserExpr* expr, const std::u16string& prio = u"");
-    int commitAppend();
+    int commitAppend(CSSSnapshotWriter* snapshotWriter = 0);
     int cancelAppend();
 
     int setProperty(int id, CSSParserExpr* expr, const std::u16string& prio = u"");
@@ -515,7 +519,15 @@ public:
     CSSStyleDeclarationImp* getPseudoElementStyle(const std::u16string& name);
     CSSStyleDeclarationImp* createPseudoElementStyle(int id);
 
-    CSSStyleDeclarationImp* getAffectedByHover() const;
+    // Returns true if changing the property does not affect the layout.
+    static bool isPaintProperty(int id);
+    // Returns true if changing the property id from the previous 'visibility'
+    // value does not affect the layout.
+    bool isPaintMutation(int id, unsigned previousVisibility) const;
+    bool hasPaintPropertiesOnly() const;
+    // Returns true if the matched rules that depend on the dynamic
+    // pseudo-classes in bits specify paint properties only.
+    bool dependsForPaintOnly(unsigned bits) const;
 
     void specifyWithoutInherited(const CSSStyleDeclarationImp* style);
     void specify(const CSSStyleDeclarationImp* style);
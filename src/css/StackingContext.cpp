@@ -460,6 +460,8 @@ Box* StackingContext::boxFromPoint(int x, int y)
         int s = x - relativeX;
         int t = y - relativeY;
         for (Box* base = firstBase; base; base = base->nextBase) {
+            if (!base->mayHit(s, t))
+                continue;
             if (Box* target = base->boxFromPoint(s, t, this))
                 return target;
         }
@@ -471,6 +473,19 @@ Box* StackingContext::boxFromPoint(int x, int y)
     return 0;
 }
 
+void StackingContext::updateHitBounds(Box* root)
+{
+    for (Box* base = firstBase; base; base = base->nextBase) {
+        Box* box = base;
+        while (box && box != root)
+            box = box->getParentBox();
+        if (!box)
+            base->updateHitBounds();
+    }
+    for (StackingContext* childContext = getFirstChild(); childContext; childContext = childContext->getNextSibling())
+        childContext->updateHitBounds(root);
+}
+
 void StackingContext::dump(std::string indent)
 {
     std::cout << indent << "z-index: ";
@@ -177,6 +177,8 @@ public:
     }
 
     Box* boxFromPoint(int x, int y);
+    // Rebuilds the hit bounds of the base boxes that are not in the tree of root.
+    void updateHitBounds(Box* root);
 
     void dump(std::string indent = "");
 };
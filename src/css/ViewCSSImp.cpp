@@ -24,6 +24,7 @@
 #include <org/w3c/dom/html/HTMLLinkElement.h>
 #include <org/w3c/dom/html/HTMLStyleElement.h>
 
+#include <algorithm>
 #include <new>
 #include <boost/bind.hpp>
 
@@ -39,6 +40,7 @@
 #include "html/HTMLTemplateElementImp.h"
 
 #include "Box.h"
+#include "WorkerPool.h"
 #include "Table.h"
 #include "StackingContext.h"
 
@@ -48,6 +50,26 @@ namespace org { namespace w3c { namespace dom { namespace bootstrap {
 
 namespace {
 
+// Selector matching is done in parallel only if at least this many elements
+// need to be matched; the elements are handed to the workers in chunks.
+const size_t ParallelMatchingThreshold = 256;
+const size_t MatchingChunkSize = 32;
+
+// The dynamic pseudo-class list of the element being matched by a worker
+__thread std::vector<std::pair<Object*, int>>* matchingDynamicList;
+
+// The scratch list for selector matching, which is reused by every element
+// matched in the current thread. Note __thread cannot hold a std::vector itself.
+__thread CSSRuleListImp::RuleSet* matchedRuleScratch;
+
+CSSRuleListImp::RuleSet& getMatchedRuleScratch()
+{
+    if (!matchedRuleScratch)
+        matchedRuleScratch = new CSSRuleListImp::RuleSet;
+    matchedRuleScratch->clear();
+    return *matchedRuleScratch;
+}
+
 Block* getCurrentBox(CSSStyleDeclarationImp* style, bool asTablePart)
 {
     Box* box = style->getBox();
@@ -70,6 +92,7 @@ ViewCSSImp::ViewCSSImp(DocumentWindowPtr window) :
     dpi(96),
     zoom(1.0f),
     mutationListener(boost::bind(&ViewCSSImp::handleMutation, this, _1, _2)),
+    mediaGeneration(0),
     overflow(CSSOverflowValueImp::Auto),
     stackingContexts(0),
     hovered(0),
@@ -78,7 +101,9 @@ ViewCSSImp::ViewCSSImp(DocumentWindowPtr window) :
     scrollHeight(0.0f),
     hoveredBox(0),
     last(0),
-    delay(0)
+    delay(0),
+    cancelRequest(0),
+    cancelled(false)
 {
     setMediumFontSize(16);
     DocumentImp* document = dynamic_cast<DocumentImp*>(getDocument().self());
@@ -122,12 +147,54 @@ bool ViewCSSImp::isHovered(Element node)
     return false;
 }
 
+void ViewCSSImp::invalidateDynamicState(Element element, unsigned bits)
+{
+    auto found = dependents.find(element.self());
+    if (found == dependents.end())
+        return;
+    for (auto i = found->second.begin(); i != found->second.end(); ++i) {
+        if (!(i->second & bits))
+            continue;
+        if (CSSStyleDeclarationImp* style = getStyle(Element(i->first))) {
+            style->requestReconstruct(style->dependsForPaintOnly(i->second & bits) ? Box::NEED_STYLE_REPAINT : Box::NEED_STYLE_RECALCULATION);
+            style->clearFlags(CSSStyleDeclarationImp::Computed);
+        }
+    }
+}
+
 void ViewCSSImp::removeComputedStyle(Element element)
 {
     if (CSSStyleDeclarationImp* style = getStyle(element)) {
         style->revert(element);
         map.erase(element);
     }
+    clearDependencies(element.self());
+    auto found = dependents.find(element.self());
+    if (found != dependents.end()) {
+        for (auto i = found->second.begin(); i != found->second.end(); ++i) {
+            std::vector<Object*>& keys(dependencies[i->first]);
+            keys.erase(std::remove(keys.begin(), keys.end(), element.self()), keys.end());
+            if (keys.empty())
+                dependencies.erase(i->first);
+        }
+        dependents.erase(found);
+    }
+}
+
+void ViewCSSImp::clearDependencies(Object* element)
+{
+    auto found = dependencies.find(element);
+    if (found == dependencies.end())
+        return;
+    for (auto i = found->second.begin(); i != found->second.end(); ++i) {
+        auto key = dependents.find(*i);
+        if (key == dependents.end())
+            continue;
+        key->second.erase(element);
+        if (key->second.empty())
+            dependents.erase(key);
+    }
+    dependencies.erase(found);
 }
 
 void ViewCSSImp::handleMutation(EventListenerImp* listener, events::Event event)
@@ -175,8 +242,17 @@ void ViewCSSImp::handleMutation(EventListenerImp* listener, events::Event event)
         Node target = interface_cast<Node>(event.getTarget());
         if (Element::hasInstance(target)) {
             if (CSSStyleDeclarationImp* style = getStyle(interface_cast<Element>(target))) {
-                style->requestReconstruct(Box::NEED_STYLE_RECALCULATION);
                 style->clearFlags(CSSStyleDeclarationImp::Computed);
+                if (mutation.getAttrName() == u"style" && html::HTMLElement::hasInstance(target)) {
+                    html::HTMLElement element(interface_cast<html::HTMLElement>(target));
+                    CSSStyleDeclarationImp* elementDecl = dynamic_cast<CSSStyleDeclarationImp*>(element.getStyle().self());
+                    if (elementDecl && elementDecl->isPaintMutated()) {
+                        // Only paint properties have been changed through CSSOM.
+                        style->requestReconstruct(Box::NEED_STYLE_REPAINT);
+                        return;
+                    }
+                }
+                style->requestReconstruct(Box::NEED_STYLE_RECALCULATION);
                 if (mutation.getAttrName() != u"style") {
                     // Request a selector re-matching for the element
                     style->setFlags(CSSStyleDeclarationImp::NeedSelectorMatching);
@@ -190,14 +266,6 @@ void ViewCSSImp::handleMutation(EventListenerImp* listener, events::Event event)
     setFlags(Box::NEED_SELECTOR_REMATCHING);
 }
 
-void ViewCSSImp::findDeclarations(CSSRuleListImp::RuleSet& set, Element element, css::CSSRuleList list, unsigned importance)
-{
-    CSSRuleListImp* ruleList = dynamic_cast<CSSRuleListImp*>(list.self());
-    if (!ruleList)
-        return;
-    ruleList->find(set, this, element, importance);
-}
-
 void ViewCSSImp::resolveXY(float left, float top)
 {
     if (boxTree)
@@ -211,9 +279,109 @@ void ViewCSSImp::addStyle(const Element& element, CSSStyleDeclarationImp* style)
     map[element] = style;
 }
 
+void ViewCSSImp::collectActiveStyleSheets(std::vector<css::CSSStyleSheet>& sheets)
+{
+    sheets.clear();
+    stylesheets::StyleSheetList styleSheetList(getDocument().getStyleSheets());
+    for (unsigned i = 0; i < styleSheetList.getLength(); ++i) {
+        CSSStyleSheetImp* sheet = dynamic_cast<CSSStyleSheetImp*>(styleSheetList.getElement(i).self());
+        MediaListImp* mediaList = dynamic_cast<MediaListImp*>(sheet->getMedia().self());
+        if (mediaList->matches(window->getWindowImp()))
+            sheets.push_back(sheet);
+    }
+}
+
+bool ViewCSSImp::hasActiveStyleSheetsChanged()
+{
+    if (!window->getWindowImp() || mediaGeneration == window->getWindowImp()->getMediaGeneration())
+        return false;
+    std::vector<css::CSSStyleSheet> sheets;
+    collectActiveStyleSheets(sheets);
+    return sheets != activeStyleSheets;
+}
+
+std::vector<std::pair<Object*, int>>& ViewCSSImp::getDynamicList()
+{
+    return matchingDynamicList ? *matchingDynamicList : dynamicList;
+}
+
+void ViewCSSImp::matchSelectors(Element element, CSSRuleListImp::RuleSet& ruleSet)
+{
+    if (baseRuleIndex)
+        baseRuleIndex->find(ruleSet, this, element);
+    if (authorRuleIndex)
+        authorRuleIndex->find(ruleSet, this, element);
+}
+
+void ViewCSSImp::collectUnmatchedElements(Node node, std::vector<Element>& elements)
+{
+    if (node.getNodeType() == Node::ELEMENT_NODE) {
+        Element element(interface_cast<Element>(node));
+        auto found = map.find(element);
+        if (found == map.end() || (found->second->getFlags() & CSSStyleDeclarationImp::NeedSelectorMatching))
+            elements.push_back(element);
+    }
+    for (Node child = node.getFirstChild(); child; child = child.getNextSibling())
+        collectUnmatchedElements(child, elements);
+}
+
+// Matches the selectors of the elements that need selector matching in
+// parallel. Matching an element depends only on the DOM tree and the rule
+// indexes, both of which are not modified until constructComputedStyle()
+// begins. The rest of the cascade, i.e., computing the specified values,
+// resolving fonts and images, and generating bindings, is done sequentially
+// by updateStyleRules().
+void ViewCSSImp::prematchSelectors()
+{
+    WorkerPool& pool(WorkerPool::getInstance());
+    if (pool.getThreadCount() < 2)
+        return;
+    std::vector<Element> elements;
+    collectUnmatchedElements(getDocument(), elements);
+    if (elements.size() < ParallelMatchingThreshold)
+        return;
+    selectorMatches.resize(elements.size());
+    for (size_t i = 0; i < elements.size(); ++i)
+        selectorMatches[i].element = elements[i];
+    pool.parallelFor((elements.size() + MatchingChunkSize - 1) / MatchingChunkSize, [&](size_t chunk) {
+        size_t end = std::min(elements.size(), (chunk + 1) * MatchingChunkSize);
+        for (size_t i = chunk * MatchingChunkSize; i < end; ++i) {
+            matchingDynamicList = &selectorMatches[i].dynamicList;
+            matchSelectors(selectorMatches[i].element, selectorMatches[i].rules);
+        }
+        matchingDynamicList = 0;
+    });
+    for (size_t i = 0; i < selectorMatches.size(); ++i)
+        prematched[selectorMatches[i].element.self()] = &selectorMatches[i];
+}
+
 void ViewCSSImp::constructComputedStyles()
 {
+    // Note if the startup has failed, the main thread is going to quit; the
+    // missing built-in style sheets are simply skipped until then.
+    getDOMImplementation()->waitForStartup();
+    if (WindowImp* imp = window->getWindowImp())
+        mediaGeneration = imp->getMediaGeneration();
+    collectActiveStyleSheets(activeStyleSheets);
+
+    baseRuleIndex = getDOMImplementation()->getRuleIndex();
+    CSSRuleIndex::StyleSheetList list;
+    unsigned importance = CSSRuleListImp::Author;
+    for (auto i = activeStyleSheets.begin(); i != activeStyleSheets.end(); ++i)
+        list.push_back({ *i, importance++ });  // TODO: Check overflow of importance
+    authorRuleIndex = CSSRuleIndex::update(authorRuleIndex, list);
+
+    prematchSelectors();
     constructComputedStyle(getDocument(), 0);
+    prematched.clear();
+    selectorMatches.clear();
+    if (isCancelled()) {
+        // Match every element again at the next cascade.
+        for (auto i = map.begin(); i != map.end(); ++i)
+            i->second->setFlags(CSSStyleDeclarationImp::NeedSelectorMatching);
+        setFlags(Box::NEED_SELECTOR_MATCHING | Box::NEED_REFLOW);
+        return;
+    }
     clearFlags(Box::NEED_SELECTOR_MATCHING | Box::NEED_SELECTOR_REMATCHING);  // TODO: Refine
 }
 
@@ -226,30 +394,23 @@ Element ViewCSSImp::updateStyleRules(Element element, CSSStyleDeclarationImp* st
         elementDecl = dynamic_cast<CSSStyleDeclarationImp*>(htmlElement.getStyle().self());
     }
 
-    if (CSSStyleSheetImp* sheet = getDOMImplementation()->getDefaultStyleSheet())
-        findDeclarations(style->ruleSet, element, sheet->getCssRules(), CSSRuleListImp::UserAgent);
-    if (CSSStyleSheetImp* sheet = getDOMImplementation()->getUserStyleSheet())
-        findDeclarations(style->ruleSet, element, sheet->getCssRules(), CSSRuleListImp::User);
+    CSSRuleListImp::RuleSet& ruleSet(getMatchedRuleScratch());
     if (elementDecl) {
         if (CSSStyleDeclarationImp* nonCSS = elementDecl->getPseudoElementStyle(CSSPseudoElementSelector::NonCSS)) {
             // TODO: emplace() seems to be not ready yet with libstdc++.
             CSSRuleListImp::PrioritizedRule rule(CSSRuleListImp::Presentational, nonCSS);
-            style->ruleSet.insert(rule);
-        }
-    }
-    if (CSSStyleSheetImp* sheet = getDOMImplementation()->getPresentationalHints())
-        findDeclarations(style->ruleSet, element, sheet->getCssRules(), CSSRuleListImp::Presentational);
-
-    unsigned importance = CSSRuleListImp::Author;
-    stylesheets::StyleSheetList styleSheetList(getDocument().getStyleSheets());
-    for (unsigned i = 0; i < styleSheetList.getLength(); ++i) {
-        CSSStyleSheetImp* sheet = dynamic_cast<CSSStyleSheetImp*>(styleSheetList.getElement(i).self());
-        MediaListImp* mediaList = dynamic_cast<MediaListImp*>(sheet->getMedia().self());
-        if (mediaList->matches(window->getWindowImp())) {
-            findDeclarations(style->ruleSet, element, sheet->getCssRules(), importance++);
-            // TODO: Check overflow of importance
+            ruleSet.push_back(rule);
         }
     }
+    auto found = prematched.find(element.self());
+    if (found != prematched.end()) {
+        SelectorMatch* match = found->second;
+        ruleSet.insert(ruleSet.end(), match->rules.begin(), match->rules.end());
+        dynamicList.swap(match->dynamicList);
+    } else
+        matchSelectors(element, ruleSet);
+    CSSRuleListImp::sort(ruleSet);
+    style->matchedRules.assign(ruleSet);
 
     style->compute(this, parentStyle, element);
     if (parentStyle && htmlElement && htmlElement.getLocalName() == u"body") {
@@ -257,18 +418,15 @@ Element ViewCSSImp::updateStyleRules(Element element, CSSStyleDeclarationImp* st
         parentStyle->clearFlags(CSSStyleDeclarationImp::Computed);
     }
 
-    // Set style->affectedBits
-    if (!hoverList.empty()) {
-        style->affectedBits |= 1u << CSSPseudoClassSelector::Hover;
-        for (auto i = hoverList.begin(); i != hoverList.end(); ++i) {
-            if (*i != element.self()) {
-                Element e(*i);
-                if (CSSStyleDeclarationImp* s = getStyle(e))
-                    s->affectedBits |= 1u << CSSPseudoClassSelector::Hover;
-            }
-        }
-        hoverList.clear();
+    // Update the invalidation sets
+    clearDependencies(element.self());
+    for (auto i = dynamicList.begin(); i != dynamicList.end(); ++i) {
+        unsigned& bits(dependents[i->first][element.self()]);
+        if (!bits)
+            dependencies[element.self()].push_back(i->first);
+        bits |= 1u << i->second;
     }
+    dynamicList.clear();
 
     // Expand binding
     html::HTMLTemplateElement shadowTree(0);
@@ -291,6 +449,8 @@ Element ViewCSSImp::updateStyleRules(Element element, CSSStyleDeclarationImp* st
 
 void ViewCSSImp::constructComputedStyle(Node node, CSSStyleDeclarationImp* parentStyle)
 {
+    if (isCancelled())
+        return;
     CSSStyleDeclarationImp* style = 0;
     Element element((node.getNodeType() == Node::ELEMENT_NODE) ? interface_cast<Element>(node) : 0);
     if (element) {
@@ -326,13 +486,18 @@ void ViewCSSImp::calculateComputedStyles()
         if (child.getNodeType() == Node::ELEMENT_NODE)
             calculateComputedStyle(interface_cast<Element>(child), 0, &counterContext, 0);
     }
-    clearFlags(Box::NEED_STYLE_RECALCULATION);  // TODO: Refine
+    if (isCancelled())
+        return;
+    clearFlags(Box::NEED_STYLE_RECALCULATION | Box::NEED_STYLE_REPAINT);  // TODO: Refine
 }
 
 void ViewCSSImp::calculateComputedStyle(Element element, CSSStyleDeclarationImp* parentStyle, CSSAutoNumberingValueImp::CounterContext* counterContext, unsigned flags)
 {
     assert(counterContext);
 
+    if (isCancelled())
+        return;
+
 #ifndef NDEBUG
     std::u16string tag(interface_cast<html::HTMLElement>(element).getTagName());
     std::u16string id(interface_cast<html::HTMLElement>(element).getId());
@@ -376,8 +541,10 @@ void ViewCSSImp::calculateComputedStyle(Element element, CSSStyleDeclarationImp*
             if (Block* block = getCurrentBox(style, true))
                 block->setFlags(Box::NEED_REPOSITION);
             // else 'position' is relative
-        } else if (Block* block = getCurrentBox(style, true))
+        } else if (Block* block = getCurrentBox(style, true)) {
             block->resolveBackground(this);
+            block->visibility = style->visibility.getValue();
+        }
         if (!parentStyle)
             overflow = style->overflow.getValue();
         flags |= CSSStyleDeclarationImp::Computed;  // The child styles have to be recomputed.
@@ -798,10 +965,18 @@ Block* ViewCSSImp::layOut()
 
     if (!constructBlocks())
         return 0;
+    if (isCancelled()) {
+        setFlags(Box::NEED_REFLOW);
+        return 0;
+    }
 
     // Expand line boxes and inline-level boxes in each block-level box
     if (!boxTree->isAbsolutelyPositioned()) {
         boxTree->layOut(this, 0);
+        if (isCancelled()) {
+            setFlags(Box::NEED_REFLOW);
+            return 0;
+        }
         boxTree->resolveXY(this, 0.0f, 0.0f, 0);
     }
 
@@ -811,6 +986,10 @@ Block* ViewCSSImp::layOut()
         stackingContexts->layOutAbsolute(this);
     }
 
+    boxTree->updateHitBounds();
+    if (stackingContexts)
+        stackingContexts->updateHitBounds(boxTree.get());
+
     if (3 <= getLogLevel()) {
         printComputedValues(getDocument(), this);
         if (stackingContexts) {
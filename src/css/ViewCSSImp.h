@@ -22,8 +22,13 @@
 #endif
 
 #include <org/w3c/dom/css/CSSStyleDeclaration.h>
+#include <org/w3c/dom/css/CSSStyleSheet.h>
 
+#include <atomic>
 #include <map>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "DocumentWindow.h"
 #include "ElementImp.h"
@@ -31,6 +36,7 @@
 
 #include "Box.h"
 #include "CounterImp.h"
+#include "CSSRuleIndex.h"
 #include "CSSRuleListImp.h"
 
 #include "font/FontManager.h"
@@ -46,6 +52,8 @@ class StackingContext;
 class ViewCSSImp
 {
     friend class CSSPseudoClassSelector;    // TODO: only for match()
+    friend class CSSRuleIndex;              // TODO: only for find()
+    friend class CSSRuleListImp;            // TODO: only for find()
 
     static const unsigned MaxFontSizes = 8;
 
@@ -61,7 +69,33 @@ class ViewCSSImp
 
     // Selector matching
     std::map<Element, CSSStyleDeclarationPtr> map;
-    std::list<Object*> hoverList;
+    // The elements whose dynamic pseudo-class states have been assumed by the
+    // current selector matching, with the pseudo-class ids
+    std::vector<std::pair<Object*, int>> dynamicList;
+    // The rules matched in parallel ahead of the cascade; cf. prematchSelectors()
+    struct SelectorMatch
+    {
+        Element element;    // keeps the key of prematched alive until the cascade consumes the match
+        CSSRuleListImp::RuleSet rules;
+        std::vector<std::pair<Object*, int>> dynamicList;
+        SelectorMatch() :
+            element(0)
+        {}
+    };
+    std::vector<SelectorMatch> selectorMatches;
+    std::unordered_map<Object*, SelectorMatch*> prematched;
+    // The invalidation sets; the elements whose matched rules depend on the
+    // dynamic pseudo-class states of the key element, with the pseudo-class
+    // bits. The elements are not owned; the edges of an element are cleared
+    // when it is rematched or its computed style is removed.
+    std::unordered_map<Object*, std::unordered_map<Object*, unsigned>> dependents;
+    // The key elements of each element in the invalidation sets
+    std::unordered_map<Object*, std::vector<Object*>> dependencies;
+    // The author style sheets whose media match the window, in the cascading order
+    std::vector<css::CSSStyleSheet> activeStyleSheets;
+    unsigned mediaGeneration;
+    CSSRuleIndexPtr baseRuleIndex;      // shared by every window
+    CSSRuleIndexPtr authorRuleIndex;
     unsigned overflow;
 
     // Style recalculation
@@ -83,10 +117,19 @@ class ViewCSSImp
     unsigned last;   // in 1/100 sec for GIF
     unsigned delay;  // in 1/100 sec for GIF
 
+    // Cancellation
+    const std::atomic_bool* cancelRequest;
+    bool cancelled;
+
     void removeComputedStyle(Element element);
+    void clearDependencies(Object* element);
 
     void handleMutation(EventListenerImp* listener, events::Event event);
-    void findDeclarations(CSSRuleListImp::RuleSet& set, Element element, css::CSSRuleList list, unsigned importance);
+    void collectActiveStyleSheets(std::vector<css::CSSStyleSheet>& sheets);
+    std::vector<std::pair<Object*, int>>& getDynamicList();
+    void matchSelectors(Element element, CSSRuleListImp::RuleSet& ruleSet);
+    void collectUnmatchedElements(Node node, std::vector<Element>& elements);
+    void prematchSelectors();
     Element updateStyleRules(Element element, CSSStyleDeclarationImp* style, CSSStyleDeclarationImp* parentStyle);
 
 public:
@@ -122,6 +165,20 @@ public:
     Block* constructBlock(Element element, Block* parentBox, CSSStyleDeclarationImp* parentStyle, CSSStyleDeclarationImp* style, Block* prevBox, bool asTablePart = false);
     Block* constructBlocks();
     Block* layOut();
+
+    // The cascade and the layout return early once cancelRequest is set,
+    // leaving the flags set so that the next cascade or layout is done from
+    // scratch.
+    void setCancelRequest(const std::atomic_bool* request) {
+        cancelRequest = request;
+        cancelled = false;
+    }
+    bool isCancelled() {
+        if (!cancelled && cancelRequest && *cancelRequest)
+            cancelled = true;
+        return cancelled;
+    }
+
     Block* dump();
     void resolveXY(float left, float top);
 
@@ -249,6 +306,14 @@ public:
     Element setHovered(Element node);
     bool isHovered(Element node);
 
+    // Returns true if a change of the media features has changed the set of
+    // the active style sheets used by the last selector matching.
+    bool hasActiveStyleSheetsChanged();
+
+    // Requests the style recalculation of the elements whose matched rules
+    // depend on the specified dynamic pseudo-class states of element.
+    void invalidateDynamicState(Element element, unsigned bits);
+
     bool canScroll() const {
         // Note the 'visible' value is interpreted as 'auto' in the viewport.
         return overflow != CSSOverflowValueImp::Hidden;
@@ -209,40 +209,55 @@ Element ViewCSSImp::setHovered(Element target)
     assert(boxTree);
     if (hovered == target)
         return hovered;
-    CSSStyleDeclarationImp* next = getStyle(target);
-    CSSStyleDeclarationImp* curr = getStyle(hovered);
-
     Element prev = hovered;
     hovered = target; // TODO: Fix synchronization issues with the background thread.
 
-    if (next) {
+    if (CSSStyleDeclarationImp* next = getStyle(target))
         glutSetCursor(cursorMap[next->cursor.getValue()]);
-        CSSStyleDeclarationImp* affected;
-        if (curr && (affected = curr->getAffectedByHover())) {
-            affected->requestReconstruct(Box::NEED_STYLE_RECALCULATION);
-            affected->clearFlags(CSSStyleDeclarationImp::Computed);
-        }
-        if (affected = next->getAffectedByHover()) {
-            affected->requestReconstruct(Box::NEED_STYLE_RECALCULATION);
-            affected->clearFlags(CSSStyleDeclarationImp::Computed);
-        }
+
+    // Only the elements that enter or leave the hover state, i.e., the ones
+    // below the common ancestor of prev and target, change their states.
+    std::vector<Element> leaving;
+    for (Element e = prev; e; e = e.getParentElement())
+        leaving.push_back(e);
+    std::vector<Element> entering;
+    for (Element e = target; e; e = e.getParentElement())
+        entering.push_back(e);
+    while (!leaving.empty() && !entering.empty() && leaving.back() == entering.back()) {
+        leaving.pop_back();
+        entering.pop_back();
     }
+    for (auto i = leaving.begin(); i != leaving.end(); ++i)
+        invalidateDynamicState(*i, 1u << CSSPseudoClassSelector::Hover);
+    for (auto i = entering.begin(); i != entering.end(); ++i)
+        invalidateDynamicState(*i, 1u << CSSPseudoClassSelector::Hover);
     return prev;
 }
 
 }}}}  // org::w3c::dom::bootstrap
 
-void initFonts(int* argc, char* argv[])
+bool removeTestFontsOption(int* argc, char* argv[])
 {
-    FontManager* manager = backend.getFontManager();
-    FontDatabase::loadBaseFonts(manager);
     for (int i = 1; i < *argc; ++i) {
         if (strcmp(argv[i], "-testfonts") == 0) {
-            FontDatabase::loadTestFonts(manager);
             for (; i < *argc; ++i)
                 argv[i] = argv[i + 1];
             --*argc;
-            break;
+            return true;
         }
     }
+    return false;
+}
+
+void loadFonts(bool testFonts)
+{
+    FontManager* manager = backend.getFontManager();
+    FontDatabase::loadBaseFonts(manager);
+    if (testFonts)
+        FontDatabase::loadTestFonts(manager);
+}
+
+void initFonts(int* argc, char* argv[])
+{
+    loadFonts(removeTestFontsOption(argc, argv));
 }
@@ -17,6 +17,13 @@
 #include "FontDatabase.h"
 #include "FontManager.h"
 
+#include <sys/stat.h>
+#include <stdio.h>
+
+#include <fstream>
+#include <map>
+#include <sstream>
+
 #ifndef TEST_FONTS
 #define TEST_FONTS "/var/www/html/Style/CSS/Test/Fonts"
 #endif  // TEST_FONTS
@@ -194,22 +201,130 @@ const char* testFontList[] =
 
 }
 
+namespace {
+
+const char* IndexSignature = "escudo-font-index 1";
+
+struct IndexEntry
+{
+    long long mtime;
+    long long size;
+    FontFaceInfo info;
+};
+
+std::string indexPath;
+std::map<std::string, IndexEntry> fontIndex;
+bool indexLoaded = false;
+bool indexModified = false;
+
+// Each line of the font index consists of the following tab-separated fields:
+//   filename mtime size generic style weight coverage familyName familyNames...
+// where coverage is in hexadecimal.
+void readIndex()
+{
+    if (indexLoaded || indexPath.empty())
+        return;
+    indexLoaded = true;
+    std::ifstream stream(indexPath.c_str());
+    std::string line;
+    if (!std::getline(stream, line) || line != IndexSignature)
+        return;
+    while (std::getline(stream, line)) {
+        std::vector<std::string> fields;
+        std::istringstream s(line);
+        std::string field;
+        while (std::getline(s, field, '\t'))
+            fields.push_back(field);
+        if (fields.size() < 9)
+            continue;
+        IndexEntry entry;
+        entry.mtime = strtoll(fields[1].c_str(), 0, 10);
+        entry.size = strtoll(fields[2].c_str(), 0, 10);
+        entry.info.generic = strtoul(fields[3].c_str(), 0, 10);
+        entry.info.style = strtoul(fields[4].c_str(), 0, 10);
+        entry.info.weight = strtoul(fields[5].c_str(), 0, 10);
+        const std::string& coverage(fields[6]);
+        for (size_t i = 0; i + 1 < coverage.length(); i += 2)
+            entry.info.coverage.push_back(strtoul(coverage.substr(i, 2).c_str(), 0, 16));
+        entry.info.familyName = fields[7];
+        for (size_t i = 8; i < fields.size(); ++i)
+            entry.info.familyNames.insert(utfconv(fields[i]));
+        fontIndex[fields[0]] = entry;
+    }
+}
+
+void writeIndex()
+{
+    if (!indexModified || indexPath.empty())
+        return;
+    indexModified = false;
+    std::string tmp = indexPath + ".tmp";
+    std::ofstream stream(tmp.c_str());
+    stream << IndexSignature << '\n';
+    for (auto i = fontIndex.begin(); i != fontIndex.end(); ++i) {
+        const FontFaceInfo& info(i->second.info);
+        stream << i->first << '\t' << i->second.mtime << '\t' << i->second.size << '\t' <<
+            info.generic << '\t' << info.style << '\t' << info.weight << '\t';
+        for (auto j = info.coverage.begin(); j != info.coverage.end(); ++j) {
+            char hex[3];
+            sprintf(hex, "%02x", *j);
+            stream << hex;
+        }
+        stream << '\t' << info.familyName;
+        for (auto j = info.familyNames.begin(); j != info.familyNames.end(); ++j)
+            stream << '\t' << utfconv(*j);
+        stream << '\n';
+    }
+    stream.close();
+    if (!stream || rename(tmp.c_str(), indexPath.c_str()) == -1)
+        remove(tmp.c_str());
+}
+
+void loadFont(FontManager* manager, const char* filename)
+{
+    struct stat st;
+    if (stat(filename, &st) == -1)
+        return;
+    auto found = fontIndex.find(filename);
+    if (found != fontIndex.end() && found->second.mtime == st.st_mtime && found->second.size == st.st_size) {
+        manager->loadFont(filename, found->second.info);
+        return;
+    }
+    if (FontFace* face = manager->loadFont(filename)) {
+        if (!indexPath.empty()) {
+            fontIndex[filename] = IndexEntry{ st.st_mtime, st.st_size, face->getInfo() };
+            indexModified = true;
+        }
+    }
+}
+
+}
+
+void FontDatabase::setIndexPath(const std::string& path)
+{
+    indexPath = path;
+}
+
 void FontDatabase::loadBaseFonts(FontManager* manager)
 {
+    readIndex();
     for (auto i = fontList; i < &fontList[sizeof fontList / sizeof fontList[0]]; ++i) {
         try {
-            manager->loadFont(*i);
+            loadFont(manager, *i);
         } catch (...) {
         }
     }
+    writeIndex();
 }
 
 void FontDatabase::loadTestFonts(FontManager* manager)
 {
+    readIndex();
     for (auto i = testFontList; i < &testFontList[sizeof testFontList / sizeof testFontList[0]]; ++i) {
         try {
-            manager->loadFont(*i);
+            loadFont(manager, *i);
         } catch (...) {
         }
     }
+    writeIndex();
 }
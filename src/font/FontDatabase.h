@@ -17,10 +17,16 @@
 #ifndef ES_FONT_DATABASE_H
 #define ES_FONT_DATABASE_H
 
+#include <string>
+
 class FontManager;
 
 struct FontDatabase
 {
+    // Sets the path of the font index file, which keeps the properties of
+    // the fonts so that font files can be opened on demand.
+    static void setIndexPath(const std::string& path);
+
     static void loadBaseFonts(FontManager* manager);
     static void loadTestFonts(FontManager* manager);
 };
@@ -97,6 +97,14 @@ FontFace* FontManager::loadFont(const char* fontFilename)
     return face;
 }
 
+FontFace* FontManager::loadFont(const char* fontFilename, const FontFaceInfo& info)
+{
+    FontFace* face = new(std::nothrow) FontFace(this, fontFilename, info);
+    if (face)
+        genericLists[face->getGeneric()].push_back(face);
+    return face;
+}
+
 void FontManager::registerFont(const std::u16string& familyName, FontFace* face)
 {
     faces.insert(std::pair<const std::u16string, FontFace*>(familyName, face));
@@ -184,21 +192,57 @@ FontFace* FontManager::getFontFace(const std::u16string& familyName, unsigned st
 FontFace::FontFace(FontManager* manager, const char* filename, long index) try :
     manager(manager),
     filename(filename),
+    index(index),
     charmap(0),
-    generic(CSSFontFamilyValueImp::None),
-    style(CSSFontStyleValueImp::Normal),
-    weight(400) // normal
+    glyphCount(0),
+    face(0)
+{
+    info.generic = CSSFontFamilyValueImp::None;
+    info.style = CSSFontStyleValueImp::Normal;
+    info.weight = 400; // normal
+    if (!open())
+        throw std::runtime_error(__func__);
+    initInfo();
+    for (auto i = info.familyNames.begin(); i != info.familyNames.end(); ++i)
+        manager->registerFont(*i, this);
+} catch (...) {
+    if (face)
+        FT_Done_Face(face);
+    throw;
+}
+
+FontFace::FontFace(FontManager* manager, const char* filename, const FontFaceInfo& info, long index) :
+    manager(manager),
+    filename(filename),
+    index(index),
+    charmap(0),
+    glyphCount(0),
+    face(0),
+    info(info)
+{
+    for (auto i = info.familyNames.begin(); i != info.familyNames.end(); ++i)
+        manager->registerFont(*i, this);
+}
+
+bool FontFace::open()
 {
+    if (face)
+        return true;
     FT_Error error = FT_New_Face(manager->library, filename, index, &face);
     if (error) {
         face = 0;
-        throw std::runtime_error(__func__);
+        return false;
     }
-
     initCharmap();
+    return true;
+}
 
-    std::set<std::u16string> familyNames;
-    familyNames.insert(toString(face->family_name));
+void FontFace::initInfo()
+{
+    info.familyName = face->family_name ? face->family_name : "";
+    info.familyNames.insert(toString(face->family_name));
+    for (auto i = charmap.begin() + 1; i != charmap.end(); ++i)
+        info.cover(*i);
     if (FT_IS_SFNT(face)) {
         // cf. http://www.microsoft.com/typography/otspec/name.htm
         unsigned count = FT_Get_Sfnt_Name_Count(face);
@@ -212,7 +256,7 @@ FontFace::FontFace(FontManager* manager, const char* filename, long index) try :
                         std::u16string name;
                         for (unsigned j = 0; j < sfntName.string_len; j+= 2)
                             name += (sfntName.string[j] << 8) | sfntName.string[j + 1];
-                        familyNames.insert(name);
+                        info.familyNames.insert(name);
                     }
                 }
             }
@@ -221,14 +265,14 @@ FontFace::FontFace(FontManager* manager, const char* filename, long index) try :
         // cf. http://www.microsoft.com/typography/otspec/os2.htm
         if (TT_OS2* os2 = static_cast<TT_OS2*>(FT_Get_Sfnt_Table(face, ft_sfnt_os2))) {
             if (os2->fsSelection & 0x001)
-                style = CSSFontStyleValueImp::Italic;
+                info.style = CSSFontStyleValueImp::Italic;
             else if (os2->fsSelection & 0x200)
-                style = CSSFontStyleValueImp::Oblique;
+                info.style = CSSFontStyleValueImp::Oblique;
             if (os2->fsSelection & 0x020)
-                weight = 700;
+                info.weight = 700;
             switch (os2->panose[3]) {    // bProportion
             case 9: // Monospaced
-                generic = CSSFontFamilyValueImp::Monospace;
+                info.generic = CSSFontFamilyValueImp::Monospace;
                 break;
             default:
                 switch (os2->panose[0]) {   // bFamilyType
@@ -238,45 +282,39 @@ FontFace::FontFace(FontManager* manager, const char* filename, long index) try :
                     case 3:  // Obtuse Cove
                     case 4:  // Square Cove
                     case 5:  // Obtuse Square Cove
-                        generic = CSSFontFamilyValueImp::Serif;
+                        info.generic = CSSFontFamilyValueImp::Serif;
                         break;
                     case 11: // Normal Sans
                     case 12: // Obtuse Sans
                     case 13: // Perpendicular Sans
-                        generic = CSSFontFamilyValueImp::SansSerif;
+                        info.generic = CSSFontFamilyValueImp::SansSerif;
                         break;
                     default:
                         break;
                     }
                     break;
                 case 3: // Latin Hand Written
-                    generic = CSSFontFamilyValueImp::Cursive;
+                    info.generic = CSSFontFamilyValueImp::Cursive;
                     break;
                 case 4: // Latin Decorative
-                    generic = CSSFontFamilyValueImp::Fantasy;
+                    info.generic = CSSFontFamilyValueImp::Fantasy;
                     break;
                 default:
                     break;
                 }
                 break;
             }
-            weight = os2->usWeightClass;
+            info.weight = os2->usWeightClass;
         }
     }
-    for (auto i = familyNames.begin(); i != familyNames.end(); ++i)
-        manager->registerFont(*i, this);
-
-} catch (...) {
-    if (face)
-        FT_Done_Face(face);
-    throw;
 }
 
 FontFace::~FontFace()
 {
     for (auto it = textures.begin(); it != textures.end(); ++it)
         delete it->second;
-    FT_Done_Face(face);
+    if (face)
+        FT_Done_Face(face);
 }
 
 unsigned FontFace::getScore(unsigned style, unsigned weight) const
@@ -306,11 +344,16 @@ unsigned FontFace::getScore(unsigned style, unsigned weight) const
     return score;
 }
 
-bool FontFace::hasGlyph(char32_t ucode) const
+bool FontFace::hasGlyph(char32_t ucode)
 {
+    if (!info.covers(ucode))
+        return false;
+    std::lock_guard<std::mutex> lock(getManager()->getMutex());
+    if (!open())
+        return false;
     std::vector<char32_t>::const_iterator result;
     result = std::lower_bound(charmap.begin(), charmap.end(), ucode);
-    return *result == ucode;
+    return result != charmap.end() && *result == ucode;
 }
 
 FontTexture* FontFace::getFontTexture(unsigned int point, bool bold, bool oblique)
@@ -322,6 +365,8 @@ FontTexture* FontFace::getFontTexture(unsigned int point, bool bold, bool obliqu
         if (font->getPoint() == point && font->getBold() == bold && font->getOblique() == oblique)
             return font;
     }
+    if (!open())
+        return 0;
     FontTexture* texture = 0;
     try {
         texture = new FontTexture(this, point, bold, oblique);
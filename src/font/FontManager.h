@@ -23,6 +23,7 @@
 #include <list>
 #include <map>
 #include <mutex>
+#include <set>
 #include <stdexcept>
 #include <string>
 #include <thread>
@@ -38,6 +39,31 @@ class FontFace;
 class FontTexture;
 struct FontGlyph;
 
+// The properties of a font face needed for font selection, which can be kept
+// in a font index so that the font file does not need to be opened at startup.
+struct FontFaceInfo
+{
+    std::string familyName;
+    std::set<std::u16string> familyNames;
+    unsigned generic;
+    unsigned style;
+    unsigned weight;
+    std::vector<uint8_t> coverage;  // a bitmap of 256-character blocks that have glyphs
+
+    static const unsigned BlockSize = 256;
+
+    bool covers(char32_t u) const {
+        size_t block = u / BlockSize;
+        return block / 8 < coverage.size() && (coverage[block / 8] & (1u << (block % 8)));
+    }
+    void cover(char32_t u) {
+        size_t block = u / BlockSize;
+        if (coverage.size() <= block / 8)
+            coverage.resize(block / 8 + 1);
+        coverage[block / 8] |= 1u << (block % 8);
+    }
+};
+
 class FontManagerBackEnd
 {
 protected:
@@ -92,6 +118,7 @@ public:
     ~FontManager();
 
     FontFace* loadFont(const char* fontFilename);
+    FontFace* loadFont(const char* fontFilename, const FontFaceInfo& info);
 
     FontFace* getFontFace(unsigned generic, unsigned style, unsigned weight, int mask = 0x3f);
     FontFace* getAltFontFace(unsigned generic, unsigned style, unsigned weight, FontTexture* current, char32_t u);
@@ -113,15 +140,14 @@ class FontFace
     FontManager* manager;
 
     const char* filename;
+    long index;
     std::vector<char32_t > charmap;
     int32_t glyphCount;
-    FT_Face face;
+    FT_Face face;   // 0 until the font file is opened
     // a map from nominal font size in pixels to FontTexture
     std::multimap<unsigned int, FontTexture*> textures;
 
-    unsigned generic;
-    unsigned style;
-    unsigned weight;
+    FontFaceInfo info;
 
     void initCharmap() throw ()
     {
@@ -136,9 +162,17 @@ class FontFace
             ucode = FT_Get_Next_Char(face, ucode, &index);
         }
     }
+    void initInfo();
+
+    // Opens the font file if it has not been opened yet. The manager's mutex
+    // must be locked.
+    bool open();
 
 public:
+    // Opens the font file and reads its properties.
     FontFace(FontManager* manager, const char* filename, long index = 0);
+    // Opens the font file when a glyph is requested first.
+    FontFace(FontManager* manager, const char* filename, const FontFaceInfo& info, long index = 0);
     ~FontFace();
 
     const char* getFilename() const {
@@ -151,22 +185,25 @@ public:
         return manager->getBackEnd();
     }
 
+    const FontFaceInfo& getInfo() const {
+        return info;
+    }
     const char* getFamilyName() const {
-        return face->family_name;
+        return info.familyName.c_str();
     }
     unsigned getGeneric() const {
-        return generic;
+        return info.generic;
     }
     unsigned getStyle() const {
-        return style;
+        return info.style;
     }
     unsigned getWeight() const {
-        return weight;
+        return info.weight;
     }
 
     unsigned getScore(unsigned style, unsigned weight) const;
 
-    bool hasGlyph(char32_t u) const;
+    bool hasGlyph(char32_t u);
 
     FontTexture* getFontTexture(unsigned int point, bool bold, bool oblique);
     FontTexture* getFontTexture(unsigned int point, unsigned style, unsigned weight);
@@ -18,11 +18,14 @@
 //       the CSS2.1 Conformance Test Suite
 // http://test.csswg.org/suites/css2.1/20110323/
 
+#include <fcntl.h>
+#include <poll.h>
 #include <unistd.h>
 #include <sys/wait.h>
 #include <signal.h>
 
 #include <cstring>
+#include <ctime>
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -64,10 +67,30 @@ struct ForkStatus {
     pid_t       pid;
     std::string url;
     int         code;
+
+    // for the persistent workers
+    std::string result;
+    std::string path;
+    std::string evaluation;
+    std::string log;
 public:
     ForkStatus() : pid(-1), code(-1) {}
 };
 
+// A browser process started with --serve that runs the tests one after another
+struct Worker {
+    pid_t       pid;
+    int         in;         // to send the test URLs
+    int         out;        // to read the test output
+    std::string pending;    // the incomplete last line read from out
+    std::string output;     // cf. processOutput()
+    int         state;      // 0: before '## complete', 1: in the dump, 2: after the dump
+    size_t      slot;       // the index to forkStates, or -1 if idle
+    time_t      deadline;
+public:
+    Worker() : pid(-1), in(-1), out(-1), state(0), slot(-1), deadline(0) {}
+};
+
 // The URL prefix for each test:
 //   If the specified report file contains a URL in a comment line,
 //   it will be used as the prefix.
@@ -82,6 +105,12 @@ std::vector<ForkStatus> forkStates(1);
 
 size_t uncertainCount = 0;
 
+bool persistent = false;
+std::vector<Worker> workers;
+std::string workerOptions;  // the user style and the test fonts option of the workers
+size_t judgedCount = 0;     // the tests judged in dispatch() without a worker
+const unsigned StopTimeout = 5;     // in seconds to wait for a worker to exit
+
 int processOutput(std::istream& stream, std::string& result)
 {
     std::string output;
@@ -272,11 +301,287 @@ std::string test(int mode, int argc, char* argv[], const std::string& url, const
     return result;
 }
 
-int reduce(std::ostream& report, int option = 0)
+// Loads the log of url, and returns true if the test needs to be run in mode.
+bool prepareTest(int mode, const std::string& url, const std::string& result, std::string& path, std::string& evaluation, std::string& log)
 {
-    size_t count;
+    path = url;
+    size_t pos = path.rfind('.');
+    if (pos != std::string::npos) {
+        path.erase(pos);
+        path += ".log";
+    }
+    loadLog(path, evaluation, log);
+    switch (mode) {
+    case GENERATE:
+        evaluation = result;
+        // FALL THROUGH
+    case UPDATE:
+        if (evaluation[0] == '?')
+            return false;
+        // FALL THROUGH
+    default:
+        return true;
+    }
+}
+
+// Evaluates the output of the test, and returns the exit status code for it.
+int judgeTest(int mode, const std::string& url, std::string result, const std::string& path, const std::string& evaluation, const std::string& log,
+              bool run, const std::string& output)
+{
+    if (run && output.empty())
+        result = "fatal";
+    else {
+        switch (mode) {
+        case HEADLESS:
+            if (evaluation != "?" && output != log)
+                result = "uncertain";
+            else
+                result = evaluation;
+            break;
+        case UPDATE:
+        case GENERATE:
+            result = evaluation;
+            if (result[0] != '?') {
+                if (!saveLog(path, url, result, output)) {
+                    std::cerr << "error: failed to open the report file\n";
+                    exit(EXIT_FAILURE);
+                }
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    if (!result.compare(0, 4, "pass"))
+        return ES_PASS;
+    if (!result.compare(0, 5, "fatal"))
+        return ES_FATAL;
+    if (!result.compare(0, 4, "fail"))
+        return ES_FAIL;
+    if (!result.compare(0, 7, "invalid"))
+        return ES_INVALID;
+    if (!result.compare(0, 4, "skip"))
+        return ES_SKIP;
+    if (!result.compare(0, 9, "uncertain"))
+        return ES_UNCERTAIN;
+    return ES_NA;
+}
+
+bool startWorker(Worker& worker, int argc, char* argv[], const std::string& userStyle, const std::string& testFonts)
+{
+    int input[2];
+    int output[2];
+    if (pipe(input) == -1)
+        return false;
+    if (pipe(output) == -1) {
+        close(input[0]);
+        close(input[1]);
+        return false;
+    }
+    // Do not let the other workers inherit the ends used by the harness.
+    fcntl(input[1], F_SETFD, FD_CLOEXEC);
+    fcntl(output[0], F_SETFD, FD_CLOEXEC);
+    char testfontsOption[] = "-testfonts";
+    char serveOption[] = "--serve";
+
+    pid_t pid = fork();
+    if (pid == -1) {
+        std::cerr << "error: no more process to create\n";
+        return false;
+    }
+    if (pid == 0) {
+        dup2(input[0], 0);
+        dup2(output[1], 1);
+        close(input[0]);
+        close(output[1]);
+        int argi = argc - 1;
+        if (!userStyle.empty())
+            argv[argi++] = strdup(userStyle.c_str());
+        if (testFonts == "on")
+            argv[argi++] = testfontsOption;
+        argv[argi++] = serveOption;
+        argv[argi] = 0;
+        execvp(argv[0], argv);
+        exit(EXIT_FAILURE);
+    }
+    close(input[0]);
+    close(output[1]);
+    worker.pid = pid;
+    worker.in = input[1];
+    worker.out = output[0];
+    worker.pending.clear();
+    worker.slot = -1;
+    return true;
+}
+
+// Stops the worker, which exits as it reads the end of its input unless force
+// is true. A worker that does not exit in StopTimeout seconds is killed.
+void stopWorker(Worker& worker, bool force)
+{
+    if (worker.pid == -1)
+        return;
+    if (force)
+        kill(worker.pid, SIGTERM);
+    close(worker.in);
+    close(worker.out);
+    int status;
+    pid_t pid;
+    for (unsigned i = 0; (pid = waitpid(worker.pid, &status, WNOHANG)) == 0 && i < StopTimeout * 10; ++i)
+        usleep(100000);
+    if (pid == 0) {
+        kill(worker.pid, SIGKILL);
+        waitpid(worker.pid, &status, 0);
+    }
+    worker.pid = -1;
+    worker.in = worker.out = -1;
+}
+
+void stopWorkers()
+{
+    for (auto i = workers.begin(); i != workers.end(); ++i)
+        stopWorker(*i, false);
+}
+
+void finishTest(Worker& worker, int mode, bool run)
+{
+    ForkStatus* s = &forkStates[worker.slot];
+    s->code = judgeTest(mode, s->url, s->result, s->path, s->evaluation, s->log, run, worker.output);
+    worker.slot = -1;
+}
+
+// Reads the output of the worker, and returns true once its test has completed.
+bool readWorker(Worker& worker)
+{
+    char buffer[4096];
+    ssize_t length = read(worker.out, buffer, sizeof buffer);
+    if (length <= 0) {
+        stopWorker(worker, true);
+        return true;
+    }
+    worker.pending.append(buffer, length);
+    for (size_t pos; (pos = worker.pending.find('\n')) != std::string::npos;) {
+        std::string line(worker.pending, 0, pos);
+        worker.pending.erase(0, pos + 1);
+        if (line == "## done")
+            return true;
+        switch (worker.state) {
+        case 0:
+            if (line == "## complete")
+                worker.state = 1;
+            break;
+        case 1:
+            if (line == "##")
+                worker.state = 2;
+            else
+                worker.output += line + '\n';
+            break;
+        default:
+            break;
+        }
+    }
+    return false;
+}
+
+// Waits for the tests run by the persistent workers like waitpid() does for the
+// forked tests, and returns the number of the tests that have completed.
+size_t waitWorkers(int mode, int option)
+{
+    size_t count = 0;
+    int op = (forkCount < forkMax) ? option : 0;
+    if (forkCount && forkStates[forkTop].code != -1)
+        op = option;
+    for (;;) {
+        std::vector<pollfd> fds;
+        std::vector<Worker*> busy;
+        time_t now = time(0);
+        int timeout = -1;
+        for (auto i = workers.begin(); i != workers.end(); ++i) {
+            if (i->slot == static_cast<size_t>(-1))
+                continue;
+            if (i->deadline && i->deadline <= now) {
+                // The test did not complete in time; start over with a new worker.
+                stopWorker(*i, true);
+                finishTest(*i, mode, true);
+                ++count;
+                continue;
+            }
+            if (i->deadline) {
+                int wait = (i->deadline - now) * 1000;
+                if (timeout < 0 || wait < timeout)
+                    timeout = wait;
+            }
+            fds.push_back(pollfd{ i->out, POLLIN, 0 });
+            busy.push_back(&*i);
+        }
+        if (busy.empty() || (op && 0 < count))
+            break;
+        if (poll(fds.data(), fds.size(), op ? 0 : timeout) <= 0) {
+            if (op)
+                break;
+            continue;
+        }
+        for (size_t i = 0; i < fds.size(); ++i) {
+            if (!fds[i].revents)
+                continue;
+            Worker& worker(*busy[i]);
+            if (readWorker(worker)) {
+                bool head = (worker.slot == forkTop);
+                finishTest(worker, mode, true);
+                ++count;
+                if (head)
+                    op = option;
+            }
+        }
+    }
+    return count;
+}
+
+void dispatch(int mode, int argc, char* argv[], const std::string& url, const std::string& userStyle, const std::string& testFonts, unsigned timeout, const std::string& result)
+{
+    size_t slot = (forkTop + forkCount) % forkMax;
+    auto s = &forkStates[slot];
+    s->url = url;
+    s->result = result;
+    s->code = -1;
+    ++forkCount;
+    if (!prepareTest(mode, url, result, s->path, s->evaluation, s->log)) {
+        s->code = judgeTest(mode, url, result, s->path, s->evaluation, s->log, false, "");
+        ++judgedCount;
+        return;
+    }
+
+    if (workerOptions != userStyle + '\t' + testFonts) {
+        stopWorkers();
+        workerOptions = userStyle + '\t' + testFonts;
+    }
+    auto worker = workers.begin();
+    while (worker->slot != static_cast<size_t>(-1))
+        ++worker;
+    if (worker->pid == -1 && !startWorker(*worker, argc, argv, userStyle, testFonts)) {
+        s->code = ES_FATAL;
+        ++judgedCount;
+        return;
+    }
+    worker->slot = slot;
+    worker->output.clear();
+    worker->state = 0;
+    worker->deadline = timeout ? time(0) + timeout : 0;
+    std::string line = prefix + url + '\n';
+    if (write(worker->in, line.c_str(), line.length()) != static_cast<ssize_t>(line.length())) {
+        stopWorker(*worker, true);
+        finishTest(*worker, mode, true);
+        ++judgedCount;
+    }
+}
+
+int reduce(std::ostream& report, int mode, int option = 0)
+{
+    size_t count = 0;
     int op = (forkCount < forkMax) ? option : 0;
-    for (count = 0; count < forkCount; ++count) {
+    if (persistent) {
+        count = waitWorkers(mode, op) + judgedCount;
+        judgedCount = 0;
+    } else for (count = 0; count < forkCount; ++count) {
         int status;
         pid_t pid = waitpid(-1, &status, op);
         if (pid == 0)
@@ -314,83 +619,34 @@ int reduce(std::ostream& report, int option = 0)
 void map(std::ostream& report, int mode, int argc, char* argv[], const std::string& url, const std::string& userStyle, const std::string& testFonts, unsigned timeout, std::string result = "")
 {
     assert(forkCount < forkMax);
+    if (persistent) {
+        dispatch(mode, argc, argv, url, userStyle, testFonts, timeout, result);
+        reduce(report, mode, WNOHANG);
+        return;
+    }
     pid_t pid = fork();
     if (pid == -1) {
         std::cerr << "error: no more process to create\n";
         exit(EXIT_FAILURE);
     }
     if (pid == 0) {
-        std::string path(url);
-        size_t pos = path.rfind('.');
-        if (pos != std::string::npos) {
-            path.erase(pos);
-            path += ".log";
-        }
+        std::string path;
         std::string evaluation;
         std::string log;
-        loadLog(path, evaluation, log);
-
         pid_t pid = -1;
         std::string output;
-        switch (mode) {
-        case GENERATE:
-            evaluation = result;
-            // FALL THROUGH
-        case UPDATE:
-            if (evaluation[0] == '?')
-                break;
-            // FALL THROUGH
-        default:
+        if (prepareTest(mode, url, result, path, evaluation, log))
             pid = runTest(argc, argv, userStyle, testFonts, url, output, timeout);
-            break;
-        }
-
-        if (0 < pid && output.empty())
-            result = "fatal";
-        else {
-            switch (mode) {
-            case HEADLESS:
-                if (evaluation != "?" && output != log)
-                    result = "uncertain";
-                else
-                    result = evaluation;
-                break;
-            case UPDATE:
-            case GENERATE:
-                result = evaluation;
-                if (result[0] != '?') {
-                    if (!saveLog(path, url, result, output)) {
-                        std::cerr << "error: failed to open the report file\n";
-                        exit(EXIT_FAILURE);
-                    }
-                }
-                break;
-            default:
-                break;
-            }
-        }
+        int status = judgeTest(mode, url, result, path, evaluation, log, 0 < pid, output);
         if (0 < pid)
             killTest(pid);
-        int status = ES_NA;
-        if (!result.compare(0, 4, "pass"))
-            status = ES_PASS;
-        else if (!result.compare(0, 5, "fatal"))
-            status = ES_FATAL;
-        else if (!result.compare(0, 4, "fail"))
-            status = ES_FAIL;
-        else if (!result.compare(0, 7, "invalid"))
-            status = ES_INVALID;
-        else if (!result.compare(0, 4, "skip"))
-            status = ES_SKIP;
-        else if (!result.compare(0, 9, "uncertain"))
-            status = ES_UNCERTAIN;
         exit(status);
     } else {
         auto s = &forkStates[(forkTop + forkCount) % forkMax];
         s->url = url;
         s->pid = pid;
         ++forkCount;
-        reduce(report, WNOHANG);
+        reduce(report, mode, WNOHANG);
     }
 }
 
@@ -399,6 +655,7 @@ int main(int argc, char* argv[])
     int mode = HEADLESS;
     unsigned timeout = 10;
     bool useLocalhost = true;
+    bool jobs = false;
 
     int argi = 1;
     while (*argv[argi] == '-') {
@@ -424,6 +681,10 @@ int main(int argc, char* argv[])
             if (forkMax == 0)
                 forkMax = 1;
             forkStates.resize(forkMax);
+            jobs = true;
+            break;
+        case 'p':
+            persistent = true;
             break;
         default:
             break;
@@ -431,6 +692,21 @@ int main(int argc, char* argv[])
         ++argi;
     }
 
+    if (persistent) {
+        if (mode != HEADLESS && mode != UPDATE && mode != GENERATE)
+            persistent = false;
+        else {
+            // Shard the tests over the cores unless -j is specified.
+            if (!jobs) {
+                long cores = sysconf(_SC_NPROCESSORS_ONLN);
+                forkMax = (0 < cores) ? cores : 1;
+                forkStates.resize(forkMax);
+            }
+            workers.resize(forkMax);
+            signal(SIGPIPE, SIG_IGN);
+        }
+    }
+
     if (argc < argi + 2) {
         std::cout << "usage: " << argv[0] << " [options] report.data command [argument ...]\n";
         return EXIT_FAILURE;
@@ -500,7 +776,7 @@ int main(int argc, char* argv[])
                     } else
                         testFonts.clear();
                 }
-                reduce(report);
+                reduce(report, mode);
                 report << line << '\n';
                 continue;
             }
@@ -530,7 +806,8 @@ int main(int argc, char* argv[])
         }
     }
     if (mode == HEADLESS || mode == UPDATE)
-        reduce(report);
+        reduce(report, mode);
+    stopWorkers();
     report.close();
 
     return (0 < uncertainCount) ? EXIT_FAILURE : EXIT_SUCCESS;
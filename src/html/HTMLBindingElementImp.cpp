@@ -27,14 +27,6 @@ namespace dom
 namespace bootstrap
 {
 
-html::HTMLTemplateElement HTMLBindingElementImp::cloneTemplate()
-{
-    html::HTMLTemplateElement t = getTemplate();
-    if (!t)
-        return 0;
-    return interface_cast<html::HTMLTemplateElement>(t.cloneNode(true));
-}
-
 // HTMLBindingElement
 
 html::HTMLTemplateElement HTMLBindingElementImp::getTemplate()
@@ -47,7 +47,6 @@ public:
         ObjectMixin(org, deep) {
     }
 
-    html::HTMLTemplateElement cloneTemplate();
     Object getImplementation() {
         return implementation;
     }
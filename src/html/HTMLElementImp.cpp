@@ -381,31 +381,39 @@ void HTMLElementImp::generateShadowContent(CSSStyleDeclarationImp* style)
         return;
     if (getShadowTree())  // already attached?
         return;
-    DocumentImp* document = getOwnerDocumentImp();
-    assert(document);
-    URL base(document->getDocumentURI());
+    DocumentImp* ownerDocument = getOwnerDocumentImp();
+    assert(ownerDocument);
+    URL base(ownerDocument->getDocumentURI());
     URL url(base, style->binding.getURL());
-    if (!base.isSameExceptFragments(url)) {
-        document = dynamic_cast<DocumentImp*>(document->loadBindingDocument(url).self());
-        if (!document || document->getReadyState() != u"complete")
+
+    // Resolve the binding only once per binding URL as the same binding is
+    // typically attached to many elements.
+    const BindingPrototype* prototype = ownerDocument->findBindingPrototype(url);
+    if (!prototype) {
+        DocumentImp* document = ownerDocument;
+        if (!base.isSameExceptFragments(url)) {
+            // Load the binding document once for all the bindings in it.
+            std::u16string documentURI(url);
+            documentURI.erase(documentURI.length() - url.getHash().length());
+            document = dynamic_cast<DocumentImp*>(ownerDocument->loadBindingDocument(documentURI).self());
+            if (!document || document->getReadyState() != u"complete")
+                return;
+        }
+        std::u16string hash = url.getHash();
+        if (!hash.empty() && hash[0] == '#')
+            hash.erase(0, 1);
+        auto binding = dynamic_cast<HTMLBindingElementImp*>(document->getElementById(hash).self());
+        if (!binding || !binding->getImplementation())
             return;
+        prototype = ownerDocument->addBindingPrototype(url, BindingPrototype{ binding->getTemplate(), binding->getImplementation() });
     }
-
-    std::u16string hash = url.getHash();
-    if (hash[0] == '#')
-        hash.erase(0, 1);
-    Element element = document->getElementById(hash);
-    if (!element)
-        return;
-    auto binding = dynamic_cast<HTMLBindingElementImp*>(element.self());
-    if (!binding)
+    bindingImplementation = prototype->implementation;
+    if (!prototype->shadowTree)
         return;
-    bindingImplementation = binding->getImplementation();
-    if (!bindingImplementation)
-        return;
-    if (html::HTMLTemplateElement shadowTree = binding->cloneTemplate()) {
+    if (html::HTMLTemplateElement shadowTree = interface_cast<html::HTMLTemplateElement>(prototype->shadowTree.cloneNode(true))) {
         setShadowTree(shadowTree);
         shadowTarget = new(std::nothrow) EventTargetImp;
+        ownerDocument->addBoundElement(this);
         // TODO: if (not called from the background thread) {
 #if 0
             ECMAScriptContext* context = document->getContext();
@@ -416,22 +424,19 @@ void HTMLElementImp::generateShadowContent(CSSStyleDeclarationImp* style)
     }
 }
 
-void HTMLElementImp::xblEnteredDocument(Node node)
+void HTMLElementImp::xblEnteredDocument(DocumentImp* boundDocument)
 {
-    while (node) {
-        if (auto element = dynamic_cast<HTMLElementImp*>(node.self())) {
-            if (element->shadowTarget && !element->shadowImplementation) {
-                DocumentImp* document = dynamic_cast<HTMLTemplateElementImp*>(element->shadowTree.self())->getOwnerDocumentImp();
-                assert(document);
-                document->enter();
-                element->shadowImplementation = document->getContext()->xblCreateImplementation(element->shadowTarget, element->bindingImplementation, element, element->shadowTree);
-                element->shadowImplementation.xblEnteredDocument();
-                document->exit();
-            }
-        }
-        if (node.hasChildNodes())
-            xblEnteredDocument(node.getFirstChild());
-        node = node.getNextSibling();
+    std::deque<html::HTMLElement> elements = boundDocument->takeBoundElements();
+    for (auto i = elements.begin(); i != elements.end(); ++i) {
+        auto element = dynamic_cast<HTMLElementImp*>(i->self());
+        if (!element || !element->shadowTarget || element->shadowImplementation)
+            continue;
+        DocumentImp* document = dynamic_cast<HTMLTemplateElementImp*>(element->shadowTree.self())->getOwnerDocumentImp();
+        assert(document);
+        document->enter();
+        element->shadowImplementation = document->getContext()->xblCreateImplementation(element->shadowTarget, element->bindingImplementation, element, element->shadowTree);
+        element->shadowImplementation.xblEnteredDocument();
+        document->exit();
     }
 }
 
@@ -301,7 +301,9 @@ public:
     void setAttributeAsUnsigned(const std::u16string& name, unsigned int value);
 
     // xblEnteredDocument() should be called after view->constructComputedStyles().
-    static void xblEnteredDocument(Node node);
+    // It creates the implementations of the elements that have been bound to
+    // bindings in boundDocument since the last call.
+    static void xblEnteredDocument(DocumentImp* boundDocument);
 };
 
 }}}}  // org::w3c::dom::bootstrap
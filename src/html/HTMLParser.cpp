@@ -1171,9 +1171,9 @@ bool HTMLParser::InBody::processStartTag(HTMLParser* parser, Token& token)
             processEndTag(parser, endTagP);
         parser->insertHtmlElement(token);
         parser->framesetOkFlag = false;
-        Token token = parser->tokenizer->getToken();
-        if (token.getType() != Token::Type::Character || token.getChar() != '\n')
-            parser->processToken(token);
+        Token nextToken = parser->tokenizer->peekToken();
+        if (nextToken.getType() == Token::Type::Character && nextToken.getChar() == '\n')
+            parser->tokenizer->discardChar();
         return true;
     }
     if (token.getName() == u"form") {
@@ -1338,7 +1338,7 @@ bool HTMLParser::InBody::processStartTag(HTMLParser* parser, Token& token)
         parser->tokenizer->setState(&HTMLTokenizer::rcdataState);
         Token nextToken = parser->tokenizer->peekToken();
         if (nextToken.getType() == Token::Type::Character && nextToken.getChar() == '\n')
-            parser->tokenizer->getToken();
+            parser->tokenizer->discardChar();
         parser->originalInsertionMode = parser->insertionMode;
         parser->framesetOkFlag = false;
         parser->setInsertionMode(&parser->text);
@@ -2908,7 +2908,17 @@ HTMLParser::HTMLParser(Document document, HTMLTokenizer* tokenizer, bool enableX
 
 bool HTMLParser::processToken(Token& token)
 {
-    return insertionMode->processToken(this, token);
+    if (!token.isRun())
+        return insertionMode->processToken(this, token);
+    // Process a run of characters one by one reusing a single token.
+    const std::u16string& run(token.getName());
+    Token character(run[0]);
+    bool result = true;
+    for (auto i = run.begin(); i != run.end(); ++i) {
+        character.setChar(*i);
+        result = insertionMode->processToken(this, character);
+    }
+    return result;
 }
 
 void HTMLParser::mainLoop()
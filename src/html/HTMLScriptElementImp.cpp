@@ -28,6 +28,7 @@
 #include "utf.h"
 #include "DocumentImp.h"
 #include "DocumentWindow.h"
+#include "Trace.h"
 #include "U16InputStream.h"
 
 #include "HTMLBindingElementImp.h"
@@ -166,11 +167,13 @@ void HTMLScriptElementImp::notify()
 bool HTMLScriptElementImp::execute()
 {
     std::u16string script;
+    std::u16string url;
     if (request) {
         assert(request->getStatus() == 200);
         boost::iostreams::stream<boost::iostreams::file_descriptor_source> stream(request->getContentDescriptor(), boost::iostreams::close_handle);
         U16ConverterInputStream u16stream(stream, "utf-8");  // TODO detect encode
         script = u16stream;
+        url = static_cast<std::u16string>(request->getRequestMessage().getURL());
     } else {
         Nullable<std::u16string> content = getTextContent();
         if (!content.hasValue())
@@ -183,7 +186,10 @@ bool HTMLScriptElementImp::execute()
             script.erase(script.length() - 3);
     }
     if (ECMAScriptContext* context = getOwnerDocumentImp()->getContext()) {
-        Any result = context->evaluate(script);
+        if (url.empty())
+            url = getOwnerDocumentImp()->getURL();
+        TraceScope scope("script evaluation", "url", url);
+        Any result = context->evaluate(script, url);
         if (auto binding = dynamic_cast<HTMLBindingElementImp*>(getParentElement().self())) {
             if (result.isObject() && !binding->getImplementation())
                 binding->setImplementation(result.toObject());
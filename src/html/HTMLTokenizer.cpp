@@ -21,7 +21,6 @@
 
 #include "utf.h"
 
-#include "AttrImp.h"
 #include "css/CSSSerialize.h"
 #include "html/HTMLUtil.h"
 
@@ -2361,7 +2360,7 @@ Token::Token(Token::Type type, int ch) :
 Token::Token(Token::Type type, const std::u16string& name) :
     type(type),
     flags(0),
-    ucode(0),
+    ucode((type == Type::Character && !name.empty()) ? name[0] : 0),
     name(name)
 {
 }
@@ -2378,11 +2377,8 @@ bool Token::append(Attribute& attribute)
     if (attribute.getName().length() == 0)
         return true;
     if (attrNames.find(attribute.getName()) == attrNames.end()) {
-        Attr attr = new(std::nothrow) org::w3c::dom::bootstrap::AttrImp(Nullable<std::u16string>(), Nullable<std::u16string>(), attribute.getName(), attribute.getValue());
-        if (attr) {
-            attrNames.insert(attribute.getName());
-            attrList.push_back(attr);
-        }
+        attrNames.insert(attribute.getName());
+        attrList.push_back(attribute);
         attribute.clear();
         return true;
     }
@@ -2394,9 +2390,8 @@ Nullable<std::u16string> Token::getAttribute(const std::u16string& name) const
 {
     if (attrNames.find(name) != attrNames.end()) {
         for (auto i = attrList.begin(); i != attrList.end(); ++i) {
-            Attr attr = *i;
-            if (attr.getName() == name)
-                return attr.getValue();
+            if (i->getName() == name)
+                return i->getValue();
         }
     }
     return Nullable<std::u16string>();
@@ -2493,6 +2488,13 @@ bool HTMLTokenizer::DataState::consume(HTMLTokenizer* tokenizer, int ch)
     return emitted;
 }
 
+bool HTMLTokenizer::DataState::scan(HTMLTokenizer* tokenizer)
+{
+    if (!tokenizer->scanRun('<', '&'))
+        return false;
+    return tokenizer->emit(tokenizer->run);
+}
+
 bool HTMLTokenizer::RcdataState::consume(HTMLTokenizer* tokenizer, int ch)
 {
     bool emitted = false;
@@ -2534,6 +2536,13 @@ bool HTMLTokenizer::RawtextState::consume(HTMLTokenizer* tokenizer, int ch)
     return emitted;
 }
 
+bool HTMLTokenizer::RawtextState::scan(HTMLTokenizer* tokenizer)
+{
+    if (!tokenizer->scanRun('<', '<'))
+        return false;
+    return tokenizer->emit(tokenizer->run);
+}
+
 bool HTMLTokenizer::ScriptDataState::consume(HTMLTokenizer* tokenizer, int ch)
 {
     bool emitted = false;
@@ -3357,6 +3366,13 @@ bool HTMLTokenizer::AttributeValueDoubleQuotedState::consume(HTMLTokenizer* toke
     return emitted;
 }
 
+bool HTMLTokenizer::AttributeValueDoubleQuotedState::scan(HTMLTokenizer* tokenizer)
+{
+    if (tokenizer->scanRun('"', '&'))
+        tokenizer->currentAttribute.appendValue(tokenizer->run);
+    return false;
+}
+
 bool HTMLTokenizer::AttributeValueSingleQuotedState::consume(HTMLTokenizer* tokenizer, int ch)
 {
     bool emitted = false;
@@ -3382,6 +3398,13 @@ bool HTMLTokenizer::AttributeValueSingleQuotedState::consume(HTMLTokenizer* toke
     return emitted;
 }
 
+bool HTMLTokenizer::AttributeValueSingleQuotedState::scan(HTMLTokenizer* tokenizer)
+{
+    if (tokenizer->scanRun('\'', '&'))
+        tokenizer->currentAttribute.appendValue(tokenizer->run);
+    return false;
+}
+
 bool HTMLTokenizer::AttributeValueUnquotedState::consume(HTMLTokenizer* tokenizer, int ch)
 {
     bool emitted = false;
@@ -4406,9 +4429,10 @@ bool HTMLTokenizer::emit(int c)
 
 bool HTMLTokenizer::emit(const std::u16string& s)
 {
-    std::u16string::const_iterator i;
-    for (i = s.begin(); i < s.end(); ++i)
-        tokenQueue.push(Token(*i));
+    if (s.length() == 1)
+        tokenQueue.push(Token(s[0]));
+    else if (!s.empty())
+        tokenQueue.push(Token(Token::Type::Character, s));
     return true;
 }
 
@@ -4431,10 +4455,10 @@ Token HTMLTokenizer::peekToken()
     for (;;) {
         if (!tokenQueue.empty())
             return tokenQueue.front();
-        int c;
-        do {
-            c = getChar();
-        } while (!state->consume(this, c));
+        // Let the current state consume ordinary characters in bulk, and
+        // fall back to the per-character state machine at delimiters.
+        while (!state->scan(this) && !state->consume(this, getChar()))
+            ;
     }
 }
 
@@ -4445,6 +4469,16 @@ Token HTMLTokenizer::getToken()
     return token;
 }
 
+void HTMLTokenizer::discardChar()
+{
+    Token& token = tokenQueue.front();
+    assert(token.getType() == Token::Type::Character);
+    if (token.isRun() && 1 < token.getName().length())
+        token = Token(Token::Type::Character, token.getName().substr(1));
+    else
+        tokenQueue.pop();
+}
+
 void HTMLTokenizer::insertString(const std::u16string& s)
 {
     for (auto i = s.rbegin(); i < s.rend(); ++i)
@@ -18,7 +18,6 @@
 #define ES_HTMLTOKENIZER_H
 
 #include <Object.h>
-#include <org/w3c/dom/Attr.h>
 #include <org/w3c/dom/Element.h>
 
 #include <deque>
@@ -44,6 +43,10 @@ public:
 
     void append(int ch);
     void appendValue(int ch);
+    void appendValue(const std::u16string& s)
+    {
+        value += s;
+    }
 
     const std::u16string& getName() const
     {
@@ -64,8 +67,6 @@ public:
 
 class Token
 {
-    typedef org::w3c::dom::Attr Attr;
-
 public:
     enum class Type
     {
@@ -99,7 +100,7 @@ private:
 
     // StartTag/EndTag field
     std::set<std::u16string> attrNames;
-    std::deque<Attr> attrList;
+    std::deque<Attribute> attrList;
 
     // Doctype fields
     std::u16string publicId;
@@ -130,7 +131,7 @@ public:
         this->name = name;
     }
 
-    const std::deque<Attr>& getAttributes() const
+    const std::deque<Attribute>& getAttributes() const
     {
         return attrList;
     }
@@ -204,6 +205,18 @@ public:
         return ucode;
     }
 
+    void setChar(int ucode)
+    {
+        this->ucode = ucode;
+    }
+
+    // A Character token for a run of characters keeps them in name, and
+    // getChar() returns the first one of them.
+    bool isRun() const
+    {
+        return type == Type::Character && !name.empty();
+    }
+
     void acknowledge()
     {
         if (flags & Flag::SelfClosing)
@@ -221,12 +234,19 @@ class HTMLTokenizer
         {
             return false;
         }
+        // Consume a run of characters that need no processing in bulk.
+        // Return true if a new token is emitted.
+        virtual bool scan(HTMLTokenizer* tokenizer)
+        {
+            return false;
+        }
     };
 
     class DataState : public State
     {
     public:
         bool consume(HTMLTokenizer* tokenizer, int ch);
+        bool scan(HTMLTokenizer* tokenizer);
     };
 
     class RcdataState : public State
@@ -239,6 +259,7 @@ class HTMLTokenizer
     {
     public:
         bool consume(HTMLTokenizer* tokenizer, int ch);
+        bool scan(HTMLTokenizer* tokenizer);
     };
 
     class ScriptDataState : public State
@@ -437,12 +458,14 @@ class HTMLTokenizer
     {
     public:
         bool consume(HTMLTokenizer* tokenizer, int ch);
+        bool scan(HTMLTokenizer* tokenizer);
     };
 
     class AttributeValueSingleQuotedState : public State
     {
     public:
         bool consume(HTMLTokenizer* tokenizer, int ch);
+        bool scan(HTMLTokenizer* tokenizer);
     };
 
     class AttributeValueUnquotedState : public State
@@ -690,6 +713,7 @@ class HTMLTokenizer
     Attribute currentAttribute;
     std::u16string temporaryBuffer;
     std::u16string appropriateTagName;
+    std::u16string run;     // for State::scan()
 
     U16InputStream* stream;
     bool fromAttribute;
@@ -723,6 +747,13 @@ class HTMLTokenizer
         return stream->get();
     }
 
+    // Read a run of characters up to either delimiter into run.
+    bool scanRun(char16_t delimiter1, char16_t delimiter2)
+    {
+        run.clear();
+        return charStack.empty() && stream->scan(run, delimiter1, delimiter2);
+    }
+
     int peekChar()
     {
         if (!charStack.empty())
@@ -764,6 +795,9 @@ public:
 
     Token peekToken();
     Token getToken();
+    // Discards the first character of the next token, which must be a
+    // Character token returned by peekToken().
+    void discardChar();
 
     void insertString(const std::u16string& s);
 
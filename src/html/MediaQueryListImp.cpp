@@ -33,6 +33,7 @@ namespace bootstrap
 
 MediaQueryListImp::MediaQueryListImp(DocumentWindowPtr window, std::u16string query) :
     state(Unknown),
+    generation(0),
     window(window)
 {
     mediaList.setMediaText(query);
@@ -45,15 +46,19 @@ MediaQueryListImp::~MediaQueryListImp()
 
 bool MediaQueryListImp::evaluate()
 {
+    WindowImp* imp = window->getWindowImp();
+    if (!imp || generation == imp->getMediaGeneration())
+        return state == Match;
+    generation = imp->getMediaGeneration();
     int old = state;
-    state = getMatches() ? Match : NotMatch;
+    state = mediaList.matches(imp) ? Match : NotMatch;
     if (old == state || old == Unknown)
-        return state;
+        return state == Match;
     for (auto i = listeners.begin(); i != listeners.end(); ++i) {
         Task task(*i, boost::bind<void>(*i, html::MediaQueryList(this)));
         window->putTask(task);
     }
-    return state;
+    return state == Match;
 }
 
 
@@ -66,6 +71,9 @@ std::u16string MediaQueryListImp::getMedia()
 
 bool MediaQueryListImp::getMatches()
 {
+    // Note the listeners are notified by DocumentWindow::evaluateMedia().
+    if (state == Unknown)
+        return evaluate();
     return mediaList.matches(window->getWindowImp());
 }
 
@@ -49,6 +49,7 @@ class MediaQueryListImp : public ObjectMixin<MediaQueryListImp>
         NotMatch
     };
     int state;
+    unsigned generation;    // cf. WindowImp::getMediaGeneration()
     DocumentWindowPtr window;
     Retained<MediaListImp> mediaList;
     std::list<html::MediaQueryListListener> listeners;
@@ -20,10 +20,18 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <iostream>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 
 #include "utf.h"
+#include "Trace.h"
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
 
 #include "url/URI.h"
 #include "http/HTTPCache.h"
@@ -46,6 +54,14 @@ std::string HttpRequest::cachePath("/tmp");
 
 int HttpRequest::getContentDescriptor()
 {
+    if (filePath.empty() && body) {
+        // Write out the in-memory content for the readers that need a file.
+        std::fstream& stream = getContent();
+        if (!stream.is_open())
+            return -1;
+        stream.write(body->data(), body->length());
+        stream.flush();
+    }
     if (filePath.empty())
         return -1;
     return ::open(filePath.c_str(), O_RDONLY, 0);
@@ -53,6 +69,12 @@ int HttpRequest::getContentDescriptor()
 
 std::FILE* HttpRequest::openFile()
 {
+    if (filePath.empty() && body) {
+        // Note fmemopen() does not accept an empty buffer.
+        if (body->empty())
+            return fopen("/dev/null", "rb");
+        return fmemopen(const_cast<char*>(body->data()), body->length(), "rb");
+    }
     if (filePath.empty())
         return 0;
     return fopen(filePath.c_str(), "rb");
@@ -139,6 +161,7 @@ bool HttpRequest::redirect(const HttpResponseMessage& res)
 // Return true to put this request in the completed list.
 bool HttpRequest::complete(bool error)
 {
+    Trace::asyncEnd("http request", this);
     errorFlag = error;
     if (!error)
         response.getLastModifiedValue(lastModified);
@@ -194,6 +217,7 @@ void HttpRequest::setRequestHeader(const std::u16string& header, const std::u16s
 bool HttpRequest::constructResponseFromCache(bool sync)
 {
     assert(cache);
+    Trace::asyncEnd("http request", this);
     readyState = COMPLETE;
     errorFlag = false;
 
@@ -217,37 +241,222 @@ bool HttpRequest::constructResponseFromCache(bool sync)
 
 namespace {
 
-bool decodeBase64(std::fstream& content, const std::string& data)
+// The values of the base64 digits, or -1 for the other characters.
+struct Base64Table
+{
+    signed char value[256];
+
+    Base64Table() {
+        static const char* const digits = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        memset(value, -1, sizeof value);
+        for (int i = 0; i < 64; ++i)
+            value[static_cast<unsigned char>(digits[i])] = i;
+    }
+};
+
+const Base64Table base64Table;
+
+#if defined(__AVX2__) || defined(__SSE2__)
+
+// Decodes the base64 digits in each 32-bit lane of v into the low three bytes
+// of the lane, or returns false if v contains any character other than the
+// digits.
+#if defined(__AVX2__)
+inline bool decodeBase64Lanes(__m256i& v)
+{
+    // Map the digits to their values by adding the offset of each range.
+    __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('A' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), v));
+    __m256i lower = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('a' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), v));
+    __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('0' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), v));
+    __m256i plus = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('+'));
+    __m256i slash = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('/'));
+    __m256i valid = _mm256_or_si256(_mm256_or_si256(upper, lower), _mm256_or_si256(_mm256_or_si256(digit, plus), slash));
+    if (_mm256_movemask_epi8(valid) != -1)
+        return false;
+    __m256i offset = _mm256_or_si256(_mm256_or_si256(_mm256_and_si256(upper, _mm256_set1_epi8(-'A')),
+                                                     _mm256_and_si256(lower, _mm256_set1_epi8(26 - 'a'))),
+                                     _mm256_or_si256(_mm256_and_si256(digit, _mm256_set1_epi8(52 - '0')),
+                                                     _mm256_or_si256(_mm256_and_si256(plus, _mm256_set1_epi8(62 - '+')),
+                                                                     _mm256_and_si256(slash, _mm256_set1_epi8(63 - '/')))));
+    __m256i x = _mm256_add_epi8(v, offset);
+    // x = a | b << 8 | c << 16 | d << 24 in each lane, where a is the first
+    // digit. Reorder the 24 bits into the three output bytes.
+    v = _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi32(_mm256_and_si256(x, _mm256_set1_epi32(0x3f)), 2),
+                                        _mm256_and_si256(_mm256_srli_epi32(x, 12), _mm256_set1_epi32(0x03))),
+                        _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi32(_mm256_and_si256(x, _mm256_set1_epi32(0x0f00)), 4),
+                                                        _mm256_and_si256(_mm256_srli_epi32(x, 10), _mm256_set1_epi32(0x0f00))),
+                                        _mm256_or_si256(_mm256_slli_epi32(_mm256_and_si256(x, _mm256_set1_epi32(0x030000)), 6),
+                                                        _mm256_and_si256(_mm256_srli_epi32(x, 8), _mm256_set1_epi32(0x3f0000)))));
+    // Pack the two lanes of each 64-bit element into its low six bytes.
+    v = _mm256_or_si256(_mm256_and_si256(v, _mm256_set1_epi64x(0xffffff)), _mm256_slli_epi64(_mm256_srli_epi64(v, 32), 24));
+    return true;
+}
+#endif
+
+inline bool decodeBase64Lanes(__m128i& v)
+{
+    __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('A' - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8('Z' + 1)));
+    __m128i lower = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8('z' + 1)));
+    __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+    __m128i plus = _mm_cmpeq_epi8(v, _mm_set1_epi8('+'));
+    __m128i slash = _mm_cmpeq_epi8(v, _mm_set1_epi8('/'));
+    __m128i valid = _mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(_mm_or_si128(digit, plus), slash));
+    if (_mm_movemask_epi8(valid) != 0xffff)
+        return false;
+    __m128i offset = _mm_or_si128(_mm_or_si128(_mm_and_si128(upper, _mm_set1_epi8(-'A')),
+                                               _mm_and_si128(lower, _mm_set1_epi8(26 - 'a'))),
+                                  _mm_or_si128(_mm_and_si128(digit, _mm_set1_epi8(52 - '0')),
+                                               _mm_or_si128(_mm_and_si128(plus, _mm_set1_epi8(62 - '+')),
+                                                            _mm_and_si128(slash, _mm_set1_epi8(63 - '/')))));
+    __m128i x = _mm_add_epi8(v, offset);
+    v = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(_mm_and_si128(x, _mm_set1_epi32(0x3f)), 2),
+                                  _mm_and_si128(_mm_srli_epi32(x, 12), _mm_set1_epi32(0x03))),
+                     _mm_or_si128(_mm_or_si128(_mm_slli_epi32(_mm_and_si128(x, _mm_set1_epi32(0x0f00)), 4),
+                                               _mm_and_si128(_mm_srli_epi32(x, 10), _mm_set1_epi32(0x0f00))),
+                                  _mm_or_si128(_mm_slli_epi32(_mm_and_si128(x, _mm_set1_epi32(0x030000)), 6),
+                                               _mm_and_si128(_mm_srli_epi32(x, 8), _mm_set1_epi32(0x3f0000)))));
+    v = _mm_or_si128(_mm_and_si128(v, _mm_set_epi32(0, 0xffffff, 0, 0xffffff)), _mm_slli_epi64(_mm_srli_epi64(v, 32), 24));
+    return true;
+}
+
+// Decodes 16 digits (32 with AVX2) at a time into out while there is no white
+// space, padding, or invalid character. Each step writes two bytes past the
+// 12 (24) bytes it decodes, which decodeBase64() leaves room for.
+const char* decodeBase64Blocks(const char* p, const char* end, char*& out)
+{
+#if defined(__AVX2__)
+    for (; p + 32 <= end; p += 32, out += 24) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        if (!decodeBase64Lanes(v))
+            break;
+        __m128i low = _mm256_castsi256_si128(v);
+        __m128i high = _mm256_extracti128_si256(v, 1);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out), low);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out + 6), _mm_unpackhi_epi64(low, low));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out + 12), high);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out + 18), _mm_unpackhi_epi64(high, high));
+    }
+#endif
+    for (; p + 16 <= end; p += 16, out += 12) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        if (!decodeBase64Lanes(v))
+            break;
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out), v);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out + 6), _mm_unpackhi_epi64(v, v));
+    }
+    return p;
+}
+
+#endif
+
+bool decodeBase64(std::string& decoded, const std::string& data)
 {
-    static const char* const table = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
-    char buf[4];
-    char out[3];
+    const signed char* table = base64Table.value;
+    decoded.resize(data.length() / 4 * 3 + 3);
+    char* out = &decoded[0];
     const char* p = data.c_str();
+    const char* end = p + data.length();
+    int buf[4];
     int i = 0;
     int count = 3;
-    while (char c = *p++) {
+    while (p < end) {
+        if (i == 0) {
+#if defined(__AVX2__) || defined(__SSE2__)
+            p = decodeBase64Blocks(p, end, out);
+#endif
+            // Decode four digits at a time until white space or padding is found.
+            for (; p + 4 <= end; p += 4) {
+                int a = table[static_cast<unsigned char>(p[0])];
+                int b = table[static_cast<unsigned char>(p[1])];
+                int c = table[static_cast<unsigned char>(p[2])];
+                int d = table[static_cast<unsigned char>(p[3])];
+                if ((a | b | c | d) < 0)
+                    break;
+                uint32_t bits = (a << 18) | (b << 12) | (c << 6) | d;
+                out[0] = bits >> 16;
+                out[1] = bits >> 8;
+                out[2] = bits;
+                out += 3;
+            }
+            if (end <= p)
+                break;
+        }
+        char c = *p++;
         if (c == '=') {
             buf[i++] = 0;
             if (--count <= 0)
                 return false;
-        } else if (const char* found = strchr(table, c))
-            buf[i++] = found - table;
+        } else if (0 <= table[static_cast<unsigned char>(c)])
+            buf[i++] = table[static_cast<unsigned char>(c)];
         else if (isspace(c))
             continue;
         else
             return false;
         if (i == 4) {
-            out[0] = ((buf[0] << 2) & 0xfc) | ((buf[1] >> 4) & 0x03);
-            out[1] = ((buf[1] << 4) & 0xf0) | ((buf[2] >> 2) & 0x0f);
-            out[2] = ((buf[2] << 6) & 0xc0) | (buf[3] & 0x3f);
-            content.write(out, count);
+            uint32_t bits = (buf[0] << 18) | (buf[1] << 12) | (buf[2] << 6) | buf[3];
+            out[0] = bits >> 16;
+            out[1] = bits >> 8;
+            out[2] = bits;
+            out += count;
             i = 0;
             count = 3;
         }
     }
+    decoded.resize(out - &decoded[0]);
     return i == 0;
 }
 
+// The decoded data: URLs shared by the requests for the same URL. An entry is
+// keyed by the hash of the URL, which is compared on a hit, and it expires
+// once no request refers to its content.
+struct DataEntry
+{
+    std::string url;
+    std::string content;
+};
+
+std::mutex dataCacheMutex;
+std::unordered_map<uint64_t, std::weak_ptr<const DataEntry>> dataCache;
+size_t dataCachePruneSize = 64;
+
+// FNV-1a
+uint64_t hashData(const std::string& url)
+{
+    uint64_t h = 14695981039346656037ull;
+    for (auto i = url.begin(); i != url.end(); ++i) {
+        h ^= static_cast<unsigned char>(*i);
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+std::shared_ptr<const std::string> findData(const std::string& url, uint64_t hash)
+{
+    std::lock_guard<std::mutex> lock(dataCacheMutex);
+    auto found = dataCache.find(hash);
+    if (found == dataCache.end())
+        return std::shared_ptr<const std::string>();
+    std::shared_ptr<const DataEntry> entry = found->second.lock();
+    if (!entry || entry->url != url)
+        return std::shared_ptr<const std::string>();
+    return std::shared_ptr<const std::string>(entry, &entry->content);
+}
+
+void addData(uint64_t hash, const std::shared_ptr<const DataEntry>& entry)
+{
+    std::lock_guard<std::mutex> lock(dataCacheMutex);
+    if (dataCachePruneSize <= dataCache.size()) {
+        for (auto i = dataCache.begin(); i != dataCache.end();) {
+            if (i->second.expired())
+                i = dataCache.erase(i);
+            else
+                ++i;
+        }
+        dataCachePruneSize = std::max<size_t>(64, dataCache.size() * 2);
+    }
+    dataCache[hash] = entry;
+}
+
 }  // namespace
 
 bool HttpRequest::constructResponseFromData()
@@ -265,22 +474,24 @@ bool HttpRequest::constructResponseFromData()
         base64 = true;
     }
     response.parseMediaType(data.c_str() + 5, data.c_str() + end);
-    std::fstream& content = getContent();
-    if (!content.is_open()) {
-        notify(true);
-        return errorFlag;
-    }
     flags &= ~DONT_REMOVE;
-    if (!base64) {
-        end += 1;
-        std::string decoded(URI::percentDecode(URI::percentDecode(data, end, data.length() - end)));
-        content << decoded;
-    } else {
-        end += 8;
-        std::string decoded(URI::percentDecode(URI::percentDecode(data, end, data.length() - end)));
-        errorFlag = !decodeBase64(content, decoded);
+    uint64_t hash = hashData(data);
+    body = findData(data, hash);
+    if (!body) {
+        std::shared_ptr<DataEntry> entry = std::make_shared<DataEntry>();
+        entry->url = data;
+        // Note URI keeps the percent-encoded characters of the original URL.
+        end += base64 ? 8 : 1;
+        std::string decoded(URI::percentDecode(data, end, data.length() - end));
+        if (base64)
+            errorFlag = !decodeBase64(entry->content, decoded);
+        else
+            entry->content.swap(decoded);
+        if (!errorFlag) {
+            addData(hash, entry);
+            body = std::shared_ptr<const std::string>(entry, &entry->content);
+        }
     }
-    content.flush();
     notify(errorFlag);
     return errorFlag;
 }
@@ -293,6 +504,8 @@ bool HttpRequest::send()
     if (request.getURL().isEmpty())
         return notify(false);
 
+    if (Trace::isEnabled())
+        Trace::asyncBegin("http request", this, "url", static_cast<std::u16string>(request.getURL()));
     flags |= DONT_REMOVE;
 
     if (request.getURL().testProtocol(u"file")) {
@@ -351,6 +564,7 @@ void HttpRequest::abort()
     if (content.is_open())
         content.close();
     filePath.clear();   // TODO: Check if we should remove file now
+    body.reset();
     cache = 0;
 }
 
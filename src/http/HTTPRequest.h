@@ -20,6 +20,7 @@
 #include <fstream>
 #include <cstdio>
 #include <deque>
+#include <memory>
 #include <boost/function.hpp>
 
 #include "http/HTTPRequestMessage.h"
@@ -63,6 +64,7 @@ private:
 
     std::string filePath;
     std::fstream content;
+    std::shared_ptr<const std::string> body;    // the decoded data: URL, if any
 
     HttpCache* cache;
     boost::function<void (void)> handler;
@@ -659,9 +659,9 @@ void ECMAScriptContext::exit(ObjectImp* window)
 {
 }
 
-Any ECMAScriptContext::evaluate(const std::u16string& script)
+Any ECMAScriptContext::evaluate(const std::u16string& script, const std::u16string& url)
 {
-    return pimpl->evaluate(script);
+    return pimpl->evaluate(script, url);
 }
 
 Object* ECMAScriptContext::compileFunction(const std::u16string& body)
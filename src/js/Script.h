@@ -41,7 +41,7 @@ public:
 
     void activate(ObjectImp* window);
 
-    Any evaluate(const std::u16string& script);
+    Any evaluate(const std::u16string& script, const std::u16string& url);
     Object* compileFunction(const std::u16string& body);
     Any callFunction(Object thisObject, Object functionObject, int argc, Any* argv);
     Object* xblCreateImplementation(Object object, Object prototype, Object boundElement, Object shadowTree);
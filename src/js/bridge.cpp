@@ -16,12 +16,17 @@
 
 #include "Script.h"
 
+#include <js/jsxdrapi.h>
+
 #include <assert.h>
 
 #include <alloca.h>
 
 #include <iostream>
 #include <memory>
+#include <vector>
+
+#include "ScriptCache.h"
 
 namespace {
 
@@ -86,6 +91,83 @@ inline uint32_t uc_one_at_a_time(const char16_t* key, size_t len)
     return hash;
 }
 
+JSString* newString(JSContext* cx, const std::u16string& s)
+{
+    return JS_NewUCStringCopyN(cx, reinterpret_cast<const jschar*>(s.c_str()), s.length());
+}
+
+typedef JSBool (*XDRFunction)(JSXDRState* xdr, JSObject** objp);
+
+// Decodes a script object or a function object cached by encode().
+JSObject* decode(JSContext* cx, XDRFunction xdrObject, std::vector<char>& data)
+{
+    JSXDRState* xdr = JS_XDRNewMem(cx, JSXDR_DECODE);
+    if (!xdr)
+        return 0;
+    JSObject* object = 0;
+    JS_XDRMemSetData(xdr, &data[0], data.size());
+    if (!xdrObject(xdr, &object))
+        object = 0;
+    JS_XDRMemSetData(xdr, 0, 0);  // data is not owned by xdr.
+    JS_XDRDestroy(xdr);
+    return object;
+}
+
+void encode(JSContext* cx, XDRFunction xdrObject, JSObject* object, const std::string& engine, const std::u16string& url, const std::u16string& source)
+{
+    JSXDRState* xdr = JS_XDRNewMem(cx, JSXDR_ENCODE);
+    if (!xdr)
+        return;
+    if (xdrObject(xdr, &object)) {
+        uint32 length;
+        if (void* data = JS_XDRMemGetData(xdr, &length))
+            ScriptCache::write(engine, url, source, data, length);
+    }
+    JS_XDRDestroy(xdr);
+}
+
+// Compiles source, or reads the compiled script from the script cache.
+JSObject* compileScript(JSContext* cx, JSObject* global, const std::u16string& source, const std::u16string& url)
+{
+    bool cacheable = ScriptCache::isCacheable(source);
+    if (cacheable) {
+        std::vector<char> data;
+        if (ScriptCache::read(JS_GetImplementationVersion(), url, source, data)) {
+            if (JSObject* scriptObject = decode(cx, JS_XDRScriptObject, data))
+                return scriptObject;
+        }
+    }
+    JSObject* scriptObject = JS_CompileUCScript(cx, global, reinterpret_cast<const jschar*>(source.c_str()), source.length(), "", 0);
+    if (scriptObject && cacheable)
+        encode(cx, JS_XDRScriptObject, scriptObject, JS_GetImplementationVersion(), url, source);
+    return scriptObject;
+}
+
+// Compiles body as an event handler, or reads the compiled function from the
+// script cache. The same body compiles to the same function in any document,
+// so it is keyed by the body only; the engine tag keeps the entry apart from
+// a script of the same text.
+JSObject* compileEventHandler(JSContext* cx, const std::u16string& body)
+{
+    static const char* argname = "event";
+    bool cacheable = ScriptCache::isCacheable(body);
+    std::string engine = std::string(JS_GetImplementationVersion()) + " function(event)";
+    if (cacheable) {
+        std::vector<char> data;
+        if (ScriptCache::read(engine, u"", body, data)) {
+            if (JSObject* functionObject = decode(cx, JS_XDRFunctionObject, data))
+                return functionObject;
+        }
+    }
+    JSFunction* fun = JS_CompileUCFunction(cx, 0, 0, 1, &argname, reinterpret_cast<const jschar*>(body.c_str()), body.length(), 0, 0);
+    if (!fun)
+        return 0;
+    JSObject* functionObject = JS_GetFunctionObject(fun);
+    if (cacheable)
+        encode(cx, JS_XDRFunctionObject, functionObject, engine, u"", body);
+    return functionObject;
+}
+
 Object* convert(JSContext* cx, JSObject* obj)
 {
     JSClass* cls = JS_GET_CLASS(cx, obj);
@@ -151,11 +233,8 @@ jsval convert(JSContext* cx, Any& v)
     default:
         break;
     }
-    if (v.isString()) {
-        std::u16string s = v.toString();
-        JSString* j = JS_NewUCStringCopyN(cx, reinterpret_cast<const jschar*>(s.c_str()), s.length());
-        return STRING_TO_JSVAL(j);
-    }
+    if (const std::u16string* s = v.getString())
+        return STRING_TO_JSVAL(newString(cx, *s));
     if (v.isObject())
         return OBJECT_TO_JSVAL(convert(cx, v.toObject()));
     return JSVAL_VOID;
@@ -191,14 +270,23 @@ JSBool operation(JSContext* cx, uintN argc, jsval* vp)
     return JS_FALSE;
 }
 
-bool hasProperty(ObjectImp* native, const std::u16string& name)
+// Hashes the characters of s in place without copying them into a std::u16string.
+uint32_t hashString(JSContext* cx, JSString* s)
+{
+    size_t length;
+    const jschar* chars = JS_GetStringCharsAndLength(cx, s, &length);
+    if (!chars)
+        return 0;
+    return uc_one_at_a_time(reinterpret_cast<const char16_t*>(chars), length);
+}
+
+bool hasProperty(JSContext* cx, ObjectImp* native, jsid id)
 {
-    uint32_t hash = uc_one_at_a_time(name.c_str(), name.length());
+    uint32_t hash = hashString(cx, JSID_TO_STRING(id));
     if (!hash)
         return false;
     // It seems specialGetter, etc. are not called for predefined properties; so just check operatons.
-    Any result = native->message_(hash, 0, Object::HAS_OPERATION_, 0);
-    return result.toBoolean();
+    return static_cast<NativeClass*>(native->getStaticPrivate())->hasOperation(native, hash);
 }
 
 std::u16string toString(JSContext* cx, jsid id)
@@ -218,10 +306,9 @@ JSBool specialOp(JSContext* cx, JSObject* obj, jsid id, jsval* vp, int argc)
     if (JSID_IS_INT(id))
         argument = JSID_TO_INT(id);
     else if (JSID_IS_STRING(id)) {
-        std::u16string name = toString(cx, id);
-        if (hasProperty(native, name))
+        if (hasProperty(cx, native, id))
             return JS_PropertyStub(cx, obj, id, vp);
-        argument = name;
+        argument = toString(cx, id);
     } else
         return JS_PropertyStub(cx, obj, id, vp);
     Any result = native->message_(0, 0, argc, &argument);
@@ -245,10 +332,9 @@ JSBool specialResolver(JSContext* cx, JSObject* obj, jsid id)
     if (JSID_IS_INT(id))
         argument = JSID_TO_INT(id);
     else if (JSID_IS_STRING(id)) {
-        std::u16string name = toString(cx, id);
-        if (hasProperty(native, name))
+        if (hasProperty(cx, native, id))
             return JS_ResolveStub(cx, obj, id);
-        argument = name;
+        argument = toString(cx, id);
     } else
         return JS_ResolveStub(cx, obj, id);
     Any result = native->message_(0, 0, Object::SPECIAL_GETTER_, &argument);
@@ -280,10 +366,9 @@ JSBool specialSetter(JSContext* cx, JSObject* obj, jsid id, JSBool strict, jsval
     if (JSID_IS_INT(id))
         arguments[0] = JSID_TO_INT(id);
     else if (JSID_IS_STRING(id)) {
-        std::u16string name = toString(cx, id);
-        if (hasProperty(native, name))
+        if (hasProperty(cx, native, id))
             return JS_StrictPropertyStub(cx, obj, id, strict, vp);
-        arguments[0] = name;
+        arguments[0] = toString(cx, id);
     } else
         return JS_StrictPropertyStub(cx, obj, id, strict, vp);
     arguments[1] = convert(cx, *vp);
@@ -324,11 +409,8 @@ JSBool NativeClass::staticOperation(JSContext* cx, uintN argc, jsval* vp)
         uint32_t hash = 0;
         jsval val = JS_CALLEE(cx, vp);
         if (JSFunction* f = JS_ValueToFunction(cx, val)) {
-            JSString* s = JS_GetFunctionId(f);
-            size_t l;
-            const jschar* b = JS_GetStringCharsAndLength(cx, s, &l);
-            std::u16string name(reinterpret_cast<const char16_t*>(b), l);
-            hash = uc_one_at_a_time(name.c_str(), name.length());
+            if (JSString* s = JS_GetFunctionId(f))
+                hash = hashString(cx, s);
         }
         if (!hash)
             return JS_FALSE;
@@ -417,6 +499,23 @@ bool NativeClass::isNativeClass(JSClass* jsclass)
     return jsclass->finalize == finalize;
 }
 
+bool NativeClass::hasOperation(ObjectImp* native, uint32_t hash)
+{
+    if (operationCache.count(hash))
+        return true;
+    if (nonOperationCache.count(hash))
+        return false;
+    bool result = native->message_(hash, 0, Object::HAS_OPERATION_, 0).toBoolean();
+    if (result)
+        operationCache.insert(hash);
+    else {
+        if (MaxNonOperationCacheSize <= nonOperationCache.size())
+            nonOperationCache.clear();
+        nonOperationCache.insert(hash);
+    }
+    return result;
+}
+
 std::list<NativeClass*> NativeClass::nativeClassList;
 
 JSNative NativeClass::operations[MAX_METHOD_COUNT] =
@@ -804,24 +903,22 @@ void ECMAScriptContext::Impl::activate(ObjectImp* window)
     window->setPrivate(global);
 }
 
-Any ECMAScriptContext::Impl::evaluate(const std::u16string& script)
+Any ECMAScriptContext::Impl::evaluate(const std::u16string& script, const std::u16string& url)
 {
+    JSObject* global = JS_GetGlobalObject(getContext());
+    JSObject* scriptObject = compileScript(getContext(), global, script, url);
     jsval rval;
-    const char* filename = "";
-    int lineno = 0;
-    JS_EvaluateUCScript(getContext(), JS_GetGlobalObject(getContext()),
-                        reinterpret_cast<const jschar*>(script.c_str()), script.length(),
-                        filename, lineno, &rval);
+    if (!scriptObject || !JS_ExecuteScript(getContext(), global, scriptObject, &rval))
+        return Any();
     return convert(getContext(), rval);
 }
 
 Object* ECMAScriptContext::Impl::compileFunction(const std::u16string& body)
 {
-    static const char* argname = "event";
-    JSFunction* fun = JS_CompileUCFunction(getContext(), 0, 0, 1, &argname, reinterpret_cast<const jschar*>(body.c_str()), body.length(), 0, 0);
-    if (!fun)
+    JSObject* functionObject = compileEventHandler(getContext(), body);
+    if (!functionObject)
         return 0;
-    return convert(getContext(), JS_GetFunctionObject(fun));
+    return convert(getContext(), functionObject);
 }
 
 Any ECMAScriptContext::Impl::callFunction(Object thisObject, Object functionObject, int argc, Any* argv)
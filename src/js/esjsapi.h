@@ -21,6 +21,7 @@
 
 #include <list>
 #include <memory>
+#include <unordered_set>
 
 #include "Object.h"
 #include "Reflect.h"
@@ -49,6 +50,11 @@ class NativeClass
     char name[48];
     JSClass jsclass;
     std::unique_ptr<uint32_t[]> hashTable;
+    // The HAS_OPERATION_ results by hash. The operations of an interface are
+    // finite, but any name can be looked up as a named property; the misses
+    // are kept up to MaxNonOperationCacheSize.
+    std::unordered_set<uint32_t> operationCache;
+    std::unordered_set<uint32_t> nonOperationCache;
 
     std::unique_ptr<JSPropertySpec[]> ps;
     std::unique_ptr<JSFunctionSpec[]> fs;
@@ -83,6 +89,13 @@ public:
 
     static bool isNativeClass(JSClass* jsclass);
 
+    // Returns true if the interface of native has the operation of the
+    // specified hash; the result is cached per interface since it does not
+    // depend on the instance.
+    bool hasOperation(ObjectImp* native, uint32_t hash);
+
+    static const size_t MaxNonOperationCacheSize = 256;
+
     template <int N>
     static JSBool staticOperation(JSContext* cx, uintN argc, jsval* vp);
 
@@ -28,6 +28,10 @@
 #include <stdint.h>
 #include <stdlib.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 //
 // UTF-8 <==> UTF-32
 //
@@ -248,6 +252,144 @@ char16_t* utf32to16(char32_t utf32, char16_t* utf16)
     return utf16;
 }
 
+//
+// UTF-8 ==> UTF-16 in bulk
+//
+
+// Decodes a UTF-8 sequence at p following the WHATWG Encoding Standard.
+// Returns the number of bytes consumed, or 0 if the sequence is truncated
+// at end. An ill-formed sequence is decoded as U+FFFD.
+static size_t decodeUtf8(const uint8_t* p, const uint8_t* end, char32_t* utf32)
+{
+    uint8_t c = *p;
+    char32_t u;
+    unsigned len;
+    uint8_t lower = 0x80;
+    uint8_t upper = 0xbf;
+
+    if (0xc2 <= c && c <= 0xdf)
+    {
+        u = c & 0x1fu;
+        len = 1;
+    }
+    else if (0xe0 <= c && c <= 0xef)
+    {
+        if (c == 0xe0)
+        {
+            lower = 0xa0;
+        }
+        else if (c == 0xed)
+        {
+            upper = 0x9f;
+        }
+        u = c & 0x0fu;
+        len = 2;
+    }
+    else if (0xf0 <= c && c <= 0xf4)
+    {
+        if (c == 0xf0)
+        {
+            lower = 0x90;
+        }
+        else if (c == 0xf4)
+        {
+            upper = 0x8f;
+        }
+        u = c & 0x07u;
+        len = 3;
+    }
+    else
+    {
+        *utf32 = 0xfffd;
+        return 1;
+    }
+    for (unsigned i = 1; i <= len; ++i)
+    {
+        if (p + i == end)
+        {
+            return 0;
+        }
+        c = p[i];
+        if (c < lower || upper < c)
+        {
+            *utf32 = 0xfffd;
+            return i;
+        }
+        lower = 0x80;
+        upper = 0xbf;
+        u = (u << 6) | (c & 0x3fu);
+    }
+    *utf32 = u;
+    return len + 1;
+}
+
+// Decodes UTF-8 in [*source, sourceLimit) into [*target, targetLimit), and
+// advances *source and *target. A truncated sequence at the end of the
+// source is left unconsumed unless flush is true.
+void utf8to16(const char** source, const char* sourceLimit, char16_t** target, char16_t* targetLimit, bool flush)
+{
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(*source);
+    const uint8_t* end = reinterpret_cast<const uint8_t*>(sourceLimit);
+    char16_t* t = *target;
+
+    while (p < end && t < targetLimit)
+    {
+#ifdef __SSE2__
+        // ASCII fast path: widen 16 bytes at a time.
+        while (16 <= end - p && 16 <= targetLimit - t)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            if (_mm_movemask_epi8(v))
+            {
+                break;
+            }
+            __m128i zero = _mm_setzero_si128();
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(t), _mm_unpacklo_epi8(v, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(t + 8), _mm_unpackhi_epi8(v, zero));
+            p += 16;
+            t += 16;
+        }
+        if (p == end || t == targetLimit)
+        {
+            break;
+        }
+#endif
+        if (*p < 0x80)
+        {
+            *t++ = *p++;
+            continue;
+        }
+        char32_t u;
+        size_t len = decodeUtf8(p, end, &u);
+        if (len == 0)
+        {
+            if (!flush)
+            {
+                break;
+            }
+            // A truncated sequence at the end of the input.
+            u = 0xfffd;
+            len = end - p;
+        }
+        if (u < 0x10000)
+        {
+            *t++ = u;
+        }
+        else
+        {
+            if (targetLimit - t < 2)
+            {
+                break;
+            }
+            utf32to16(u, t);
+            t += 2;
+        }
+        p += len;
+    }
+    *source = reinterpret_cast<const char*>(p);
+    *target = t;
+}
+
 int utf16cmp(const char16_t* a, const char16_t* b)
 {
     for (; *a == *b; ++a, ++b)
@@ -28,6 +28,7 @@ char* utf32to8(char32_t utf32, char* utf8);
 size_t utf32to8len(char32_t utf32);
 char16_t* utf16to32(const char16_t* utf16, char32_t* utf32);
 char16_t* utf32to16(char32_t utf32, char16_t* utf16);
+void utf8to16(const char** source, const char* sourceLimit, char16_t** target, char16_t* targetLimit, bool flush);
 int utf16cmp(const char16_t* a, const char16_t* b);
 int utf16ncmp(const char16_t* a, const char16_t* b, size_t len);
 char16_t* utf16cpy(char16_t* a, const char16_t* b);
@@ -22,10 +22,14 @@
 
 #include <iostream>
 #include <memory>
+#include <vector>
 
 #include "DocumentWindow.h"
+#include "ScriptCache.h"
 #include "ScriptV8.h"
 #include "WindowImp.h"
+#include "WorkerPool.h"
+#include "utf.h"
 
 std::map<std::string, v8::Persistent<v8::FunctionTemplate>> NativeClass::interfaceMap;
 std::map<ObjectImp*, v8::Persistent<v8::Object>> NativeClass::wrapperMap;
@@ -104,6 +108,67 @@ Object* convertObject(v8::Handle<v8::Object> obj)
     return new(std::nothrow) ProxyObject(obj);
 }
 
+v8::Handle<v8::String> newString(const std::u16string& s)
+{
+    return v8::String::New(reinterpret_cast<const uint16_t*>(s.c_str()), s.length());
+}
+
+// Writes the characters of s straight into the result rather than through
+// v8::String::Value.
+std::u16string toString(v8::Handle<v8::String> s)
+{
+    std::u16string result(s->Length(), u'\0');
+    if (!result.empty())
+        s->Write(reinterpret_cast<uint16_t*>(&result[0]), 0, result.length());
+    return result;
+}
+
+std::string getEngineVersion()
+{
+    return std::string("V8 ") + v8::V8::GetVersion();
+}
+
+// Preparses source in a separate isolate on a worker thread, and stores the
+// preparse data in the script cache.
+void precompileScript(const std::u16string& source, const std::u16string& url)
+{
+    WorkerPool::getInstance().post([source, url] {
+        std::string utf8 = utfconv(source);
+        v8::Isolate* isolate = v8::Isolate::New();
+        {
+            v8::Isolate::Scope isolateScope(isolate);
+            v8::HandleScope handleScope;
+            std::unique_ptr<v8::ScriptData> preData(v8::ScriptData::PreCompile(utf8.c_str(), utf8.length()));
+            if (preData && !preData->HasError())
+                ScriptCache::write(getEngineVersion(), url, source, preData->Data(), preData->Length());
+        }
+        isolate->Dispose();
+    }, WorkerPool::Low);
+}
+
+// Compiles source using the preparse data kept in the script cache. Note V8
+// does not serialize the generated code itself. On a miss, the source is
+// compiled without the preparse data, which is produced off the main thread
+// for the next time rather than by parsing the source twice here.
+v8::Handle<v8::Script> compileScript(const std::u16string& source, const std::u16string& url)
+{
+    v8::Handle<v8::String> string = newString(source);
+    if (!ScriptCache::isCacheable(source))
+        return v8::Script::Compile(string);
+    std::unique_ptr<v8::ScriptData> preData;
+    std::vector<char> data;
+    if (ScriptCache::read(getEngineVersion(), url, source, data)) {
+        preData.reset(v8::ScriptData::New(&data[0], data.size()));
+        if (preData && preData->HasError())
+            preData.reset();
+    }
+    if (!preData) {
+        precompileScript(source, url);
+        return v8::Script::Compile(string);
+    }
+    return v8::Script::Compile(string, 0, preData.get());
+}
+
 Any convert(v8::Handle<v8::Value> v)
 {
     if (v.IsEmpty() || v->IsUndefined())
@@ -118,10 +183,8 @@ Any convert(v8::Handle<v8::Value> v)
         return v->NumberValue();
     if (v->IsBoolean())
         return v->BooleanValue();
-    if (v->IsString()) {
-        v8::String::Value value(v);
-        return std::u16string(*value ? reinterpret_cast<const char16_t*>(*value) : u"");
-    }
+    if (v->IsString())
+        return toString(v8::Handle<v8::String>::Cast(v));
 #if 0
     if (v->IsDate()) {
         return; // TODO: Convert to long long
@@ -135,8 +198,7 @@ Any convert(v8::Handle<v8::Value> v)
 
 Any convert(v8::Handle<v8::String> property)
 {
-    v8::String::Value value(property);
-    return std::u16string(*value ? reinterpret_cast<const char16_t*>(*value) : u"");
+    return toString(property);
 }
 
 v8::Handle<v8::Object> convertObject(Object* obj)
@@ -171,10 +233,8 @@ v8::Handle<v8::Value> convert(Any& v)
     default:
         break;
     }
-    if (v.isString()) {
-        std::u16string s = v.toString();
-        return v8::String::New(reinterpret_cast<const uint16_t*>(s.c_str()), s.length());
-    }
+    if (const std::u16string* s = v.getString())
+        return newString(*s);
     if (v.isObject())
         return convertObject(v.toObject());
     return v8::Undefined();
@@ -227,11 +287,18 @@ v8::Handle<v8::Integer> indexedPropertyQuery(uint32_t index, const v8::AccessorI
     return v8::Handle<v8::Integer>();  // return an empty handle
 }
 
+// Hashes the characters of value in place without copying them into a std::u16string.
+uint32_t hashString(const v8::String::Value& value)
+{
+    if (!*value)
+        return 0;
+    return uc_one_at_a_time(reinterpret_cast<const char16_t*>(*value), value.length());
+}
+
 v8::Handle<v8::Integer> namedPropertyQuery(v8::Local<v8::String> property, const v8::AccessorInfo& info)
 {
     v8::String::Value value(property);
-    std::u16string name(*value ? reinterpret_cast<const char16_t*>(*value) : u"");
-    uint32_t hash = uc_one_at_a_time(name.c_str(), name.length());
+    uint32_t hash = hashString(value);
     if (!hash)
         return v8::Handle<v8::Integer>();
     v8::Local<v8::Object> self = info.This();
@@ -239,8 +306,7 @@ v8::Handle<v8::Integer> namedPropertyQuery(v8::Local<v8::String> property, const
         self = self->GetPrototype().As<v8::Object>();
     auto wrap = v8::Local<v8::External>::Cast(self->GetInternalField(0));
     ObjectImp* imp = static_cast<ObjectImp*>(wrap->Value());
-    Any result = imp->message_(hash, 0, Object::HAS_OPERATION_, 0);
-    if (!static_cast<bool>(result))
+    if (!static_cast<NativeClass*>(imp->getStaticPrivate())->hasOperation(imp, hash))
         return v8::Handle<v8::Integer>();
     return v8::Integer::New(v8::None);  // TODO:
 }
@@ -248,9 +314,7 @@ v8::Handle<v8::Integer> namedPropertyQuery(v8::Local<v8::String> property, const
 v8::Handle<v8::Value> namedPropertyGetter(v8::Local<v8::String> property, const v8::AccessorInfo& info)
 {
     v8::String::Value value(property);
-    std::u16string name(*value ? reinterpret_cast<const char16_t*>(*value) : u"");
-    uint32_t hash = uc_one_at_a_time(name.c_str(), name.length());
-    if (!hash)
+    if (!hashString(value))
         return v8::Handle<v8::Value>();
     v8::Local<v8::Object> self = info.This();
     if (self == v8::Context::GetCurrent()->Global())
@@ -351,8 +415,7 @@ v8::Handle<v8::Value> NativeClass::staticOperation(const v8::Arguments& args)
     v8::String::Value value(val);
     if (!*value)
         return v8::Null();
-    std::u16string name(reinterpret_cast<const char16_t*>(*value));
-    uint32_t hash = uc_one_at_a_time(name.c_str(), name.length());
+    uint32_t hash = hashString(value);
 
     TemporaryBuffer<Any> arguments(alloca(sizeof(Any) * argc), argc);
     for (int i = 0; i < argc; ++i)
@@ -364,6 +427,23 @@ v8::Handle<v8::Value> NativeClass::staticOperation(const v8::Arguments& args)
     return v8::Null();
 }
 
+bool NativeClass::hasOperation(ObjectImp* imp, uint32_t hash)
+{
+    if (operationCache.count(hash))
+        return true;
+    if (nonOperationCache.count(hash))
+        return false;
+    bool result = imp->message_(hash, 0, Object::HAS_OPERATION_, 0).toBoolean();
+    if (result)
+        operationCache.insert(hash);
+    else {
+        if (MaxNonOperationCacheSize <= nonOperationCache.size())
+            nonOperationCache.clear();
+        nonOperationCache.insert(hash);
+    }
+    return result;
+}
+
 void NativeClass::finalize(v8::Persistent<v8::Value> object, void* parameter)
 {
     assert(parameter);
@@ -662,14 +742,15 @@ Any ECMAScriptContext::callFunction(Object thisObject, Object functionObject, in
     return call(self, func, argc, argv);
 }
 
-Any ECMAScriptContext::evaluate(const std::u16string& source)
+Any ECMAScriptContext::evaluate(const std::u16string& source, const std::u16string& url)
 {
     assert(getCurrentContext() == this);
 
     v8::HandleScope handleScope;
 
-    v8::Handle<v8::String> string = v8::String::New(reinterpret_cast<const uint16_t*>(source.c_str()), source.length());
-    v8::Handle<v8::Script> script = v8::Script::Compile(string);
+    v8::Handle<v8::Script> script = compileScript(source, url);
+    if (script.IsEmpty())
+        return Any();
     return convert(script->Run());
 }
 
@@ -677,9 +758,14 @@ Object* ECMAScriptContext::Impl::compileFunction(const std::u16string& body)
 {
     v8::HandleScope handleScope;
 
-    v8::Handle<v8::Value> source = v8::String::New(reinterpret_cast<const uint16_t*>(body.c_str()), body.length());
+    // Note the Function constructor does not take the preparse data, so the
+    // event handlers are not kept in the script cache.
+    v8::Handle<v8::Value> arguments[2] = {
+        v8::String::New("event"),
+        v8::String::New(reinterpret_cast<const uint16_t*>(body.c_str()), body.length())
+    };
     v8::Handle<v8::Function> function = v8::Handle<v8::Function>::Cast(context->Global()->Get(v8::String::New("Function")));
-    return convertObject(function->NewInstance(1, &source));
+    return convertObject(function->NewInstance(2, arguments));
 }
 
 Object* ECMAScriptContext::Impl::xblCreateImplementation(Object object, Object prototype, Object boundElement, Object shadowTree)
@@ -20,6 +20,7 @@
 #include <v8.h>
 
 #include <map>
+#include <unordered_set>
 
 #include "Object.h"
 #include "Reflect.h"
@@ -31,12 +32,24 @@ class NativeClass
     const char* metaData;
     Object (*getConstructor)();
     v8::Persistent<v8::FunctionTemplate> classTemplate;
+    // The HAS_OPERATION_ results by hash. The operations of an interface are
+    // finite, but any name can be looked up as a named property; the misses
+    // are kept up to MaxNonOperationCacheSize.
+    std::unordered_set<uint32_t> operationCache;
+    std::unordered_set<uint32_t> nonOperationCache;
 public:
     NativeClass(v8::Handle<v8::ObjectTemplate> global, const char* metadata, Object (*getConstructor)() = 0);
     ~NativeClass();
 
     v8::Handle<v8::Object> createJSObject(ObjectImp* self);
 
+    // Returns true if the interface of imp has the operation of the specified
+    // hash; the result is cached per interface since it does not depend on
+    // the instance.
+    bool hasOperation(ObjectImp* imp, uint32_t hash);
+
+    static const size_t MaxNonOperationCacheSize = 256;
+
     static v8::Handle<v8::Value> staticOperation(const v8::Arguments& args);
     static v8::Handle<v8::Value> constructor(const v8::Arguments& args);
     static void finalize(v8::Persistent<v8::Value> object, void* parameter);